@@ -74,7 +74,9 @@ const std::unordered_map<std::string, std::unordered_set<std::string>>
         {{"quit"}, {}},
         {{"xyzzy"}, {}},
         {{"fen"}, {}},
-        {{"wait"}, {}}
+        {{"wait"}, {}},
+        {{"savetree"}, {"file"}},
+        {{"loadtree"}, {"file"}}
 };
 
 std::pair<std::string, std::unordered_map<std::string, std::string>>
@@ -212,6 +214,14 @@ bool UciLoop::DispatchCommand(
     engine_->Go(go_params);
   } else if (command == "wait") {
     engine_->Wait();
+  } else if (command == "savetree" || command == "loadtree") {
+    const std::string filename = GetOrEmpty(params, "file");
+    if (filename.empty()) throw Exception(command + " requires a file.");
+    if (command == "savetree") {
+      engine_->SaveTree(filename);
+    } else {
+      engine_->LoadTree(filename);
+    }
   } else if (command == "stop") {
     engine_->Stop();
   } else if (command == "ponderhit") {
@@ -95,6 +95,11 @@ class EngineControllerBase {
   // Must not block.
   virtual void Stop() = 0;
 
+  // Stop the search and save its tree to a file / restore it for the current
+  // position. Block.
+  virtual void SaveTree(const std::string& filename) = 0;
+  virtual void LoadTree(const std::string& filename) = 0;
+
   // Register and unregister the UCI responder using observer pattern.
   virtual void RegisterUciResponder(UciResponder*) = 0;
   virtual void UnregisterUciResponder(UciResponder*) = 0;
@@ -154,6 +154,16 @@ Engine::Engine(const SearchFactory& factory, const OptionsDict& opts)
   }
 }
 
+Engine::Engine(const SearchFactory& factory, const OptionsDict& opts,
+               CachingBackend* shared_backend)
+    : uci_forwarder_(std::make_unique<UciPonderForwarder>(this)),
+      options_(opts),
+      search_(factory.CreateSearch(uci_forwarder_.get(), &options_)),
+      shared_backend_(shared_backend) {
+  search_->SetBackend(shared_backend_);
+  if (options_.Get<bool>(kPreload)) EnsureSyzygyTablebasesLoaded();
+}
+
 Engine::~Engine() { EnsureSearchStopped(); }
 
 void Engine::EnsureSearchStopped() {
@@ -162,6 +172,8 @@ void Engine::EnsureSearchStopped() {
 }
 
 void Engine::UpdateBackendConfig() {
+  // The owner of a shared backend configures it.
+  if (shared_backend_) return;
   const std::string backend_name =
       options_.Get<std::string>(SharedBackendParams::kBackendId);
   const size_t cache_size =
@@ -246,6 +258,20 @@ void Engine::Wait() { search_->WaitSearch(); }
 
 void Engine::Stop() { search_->StopSearch(); }
 
+void Engine::SaveTree(const std::string& filename) {
+  // Unlike for other commands, the search gets to report its bestmove.
+  search_->StopSearch();
+  search_->WaitSearch();
+  search_->SaveTree(filename);
+}
+
+void Engine::LoadTree(const std::string& filename) {
+  EnsureSearchStopped();
+  if (!last_position_) NewGame();
+  InitializeSearchPosition(/*for_ponder=*/false);
+  search_->LoadTree(filename);
+}
+
 void Engine::PonderHit() {
   if (!last_go_params_ || !last_go_params_->ponder) {
     throw Exception("ponderhit while not pondering");
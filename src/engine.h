@@ -40,6 +40,10 @@ namespace lczero {
 class Engine : public EngineControllerBase {
  public:
   Engine(const SearchFactory&, const OptionsDict&);
+  // Uses @shared_backend instead of creating a backend from the options. It
+  // must outlive the engine.
+  Engine(const SearchFactory&, const OptionsDict&,
+         CachingBackend* shared_backend);
   ~Engine() override;
 
   static void PopulateOptions(OptionsParser*);
@@ -52,6 +56,8 @@ class Engine : public EngineControllerBase {
   void PonderHit() override;
   void Wait() override;
   void Stop() override;
+  void SaveTree(const std::string& filename) override;
+  void LoadTree(const std::string& filename) override;
 
   void RegisterUciResponder(UciResponder*) override;
   void UnregisterUciResponder(UciResponder*) override;
@@ -68,6 +74,7 @@ class Engine : public EngineControllerBase {
   std::unique_ptr<SearchBase> search_;  // absl_notnull
   std::string backend_name_;  // Remember the backend name to track changes.
   std::unique_ptr<CachingBackend> backend_;  // absl_nullable
+  CachingBackend* const shared_backend_ = nullptr;  // absl_nullable
 
   // Remember previous tablebase paths to detect when to reload them.
   std::string previous_tb_paths_;
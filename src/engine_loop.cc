@@ -28,8 +28,11 @@
 #include "engine_loop.h"
 
 #include <iostream>
+#include <map>
 
 #include "engine.h"
+#include "neural/memcache.h"
+#include "neural/register.h"
 #include "neural/shared_params.h"
 #include "utils/configfile.h"
 
@@ -42,6 +45,68 @@ const OptionId kLogFileId{
                   "output the log to the console.",
      .short_flag = 'l',
      .visibility = OptionId::kAlwaysVisible}};
+
+// Populates options from various sources.
+void PopulateOptions(SearchFactory* factory, StringUciResponder* uci_responder,
+                     OptionsParser* options_parser) {
+  options_parser->Add<StringOption>(kLogFileId);
+  ConfigFile::PopulateOptions(options_parser);
+  Engine::PopulateOptions(options_parser);
+  if (factory) factory->PopulateParams(options_parser);  // Search params.
+  uci_responder->PopulateParams(options_parser);         // UCI params.
+  SharedBackendParams::Populate(options_parser);
+}
+
+// Sends the responses of one server session, prefixed with its name.
+class SessionUciResponder : public StringUciResponder {
+ public:
+  SessionUciResponder(const std::string& name) : prefix_(name + " ") {}
+
+  void SendRawResponses(const std::vector<std::string>& responses) override {
+    std::vector<std::string> prefixed;
+    prefixed.reserve(responses.size());
+    for (const auto& response : responses) {
+      prefixed.push_back(prefix_ + response);
+    }
+    stdout_responder_.SendRawResponses(prefixed);
+  }
+
+ private:
+  const std::string prefix_;
+  StdoutUciResponder stdout_responder_;
+};
+
+// One engine of the server, with its own options and UCI state.
+class ServerSession {
+ public:
+  ServerSession(const std::string& name, SearchFactory* factory,
+                CachingBackend* backend)
+      : uci_responder_(name) {
+    PopulateOptions(factory, &uci_responder_, &options_parser_);
+    // The flags were validated when the server started.
+    options_parser_.ProcessAllFlags();
+    engine_ = std::make_unique<Engine>(
+        *factory, options_parser_.GetOptionsDict(), backend);
+    loop_ = std::make_unique<UciLoop>(&uci_responder_, &options_parser_,
+                                      engine_.get());
+  }
+
+  // Returns false if the session has ended.
+  bool ProcessLine(const std::string& line) {
+    try {
+      return loop_->ProcessLine(line);
+    } catch (Exception& ex) {
+      uci_responder_.SendRawResponse(std::string("error ") + ex.what());
+    }
+    return true;
+  }
+
+ private:
+  SessionUciResponder uci_responder_;
+  OptionsParser options_parser_;
+  std::unique_ptr<Engine> engine_;
+  std::unique_ptr<UciLoop> loop_;
+};
 }  // namespace
 
 void RunEngine(SearchFactory* factory) {
@@ -50,12 +115,7 @@ void RunEngine(SearchFactory* factory) {
 
   // Populate options from various sources.
   OptionsParser options_parser;
-  options_parser.Add<StringOption>(kLogFileId);
-  ConfigFile::PopulateOptions(&options_parser);
-  Engine::PopulateOptions(&options_parser);
-  if (factory) factory->PopulateParams(&options_parser);  // Search params.
-  uci_responder.PopulateParams(&options_parser);          // UCI params.
-  SharedBackendParams::Populate(&options_parser);
+  PopulateOptions(factory, &uci_responder, &options_parser);
 
   // Parse flags, show help, initialize logging, read config etc.
   if (!ConfigFile::Init() || !options_parser.ProcessAllFlags()) return;
@@ -81,4 +141,51 @@ void RunEngine(SearchFactory* factory) {
   }
 }
 
+void RunEngineServer(SearchFactory* factory) {
+  CERR << "Search algorithm: " << factory->GetName();
+  StdoutUciResponder uci_responder;
+
+  // The options given on the command line are the defaults of every session.
+  // Backend and cache options are only taken from here.
+  OptionsParser options_parser;
+  PopulateOptions(factory, &uci_responder, &options_parser);
+  if (!ConfigFile::Init() || !options_parser.ProcessAllFlags()) return;
+  const auto options = options_parser.GetOptionsDict();
+  Logging::Get().SetFilename(options.Get<std::string>(kLogFileId));
+
+  auto backend = CreateMemCache(
+      BackendManager::Get()->CreateFromParams(options),
+      options.Get<int>(SharedBackendParams::kNNCacheSizeId));
+  std::map<std::string, std::unique_ptr<ServerSession>> sessions;
+
+  std::cout.setf(std::ios::unitbuf);
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    LOGFILE << ">> " << line;
+    const auto name_start = line.find_first_not_of(" \t");
+    if (name_start == std::string::npos) continue;
+    const auto name_end = line.find_first_of(" \t", name_start);
+    const std::string name = line.substr(name_start, name_end - name_start);
+    const auto command_start = line.find_first_not_of(" \t", name_end);
+    if (command_start == std::string::npos) {
+      if (name == "quit") break;
+      uci_responder.SendRawResponse(
+          "error Expected \"<session> <command>\", got: " + line);
+      continue;
+    }
+    auto iter = sessions.find(name);
+    if (iter == sessions.end()) {
+      iter = sessions
+                 .emplace(name, std::make_unique<ServerSession>(
+                                    name, factory, backend.get()))
+                 .first;
+    }
+    if (!iter->second->ProcessLine(line.substr(command_start))) {
+      sessions.erase(iter);
+    }
+  }
+  // Engines stop their searches before the backend goes away.
+  sessions.clear();
+}
+
 }  // namespace lczero
@@ -39,4 +39,12 @@ namespace lczero {
 // Runs the stdin/stdout UCI loop for the engine.
 void RunEngine(SearchFactory* factory);
 
+// Runs many independent engines in one process, all of them using one backend
+// and NN cache. Every stdin line is "<session> <uci command>", and responses
+// are prefixed with the session name the same way. A session starts with its
+// first command and ends with its "quit"; a line with just "quit" ends all of
+// them. With the multiplexing backend, NN evaluations of all sessions are
+// batched together.
+void RunEngineServer(SearchFactory* factory);
+
 }  // namespace lczero
\ No newline at end of file
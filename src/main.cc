@@ -29,11 +29,13 @@
 #include "engine.h"
 #include "search/register.h"
 #include "selfplay/loop.h"
+#include "tools/autotune.h"
 #include "tools/backendbench.h"
 #include "tools/benchmark.h"
 #include "tools/describenet.h"
 #include "tools/leela2onnx.h"
 #include "tools/onnx2leela.h"
+#include "tools/prebuildcache.h"
 #include "utils/commandline.h"
 #include "utils/esc_codes.h"
 #include "utils/logging.h"
@@ -98,11 +100,18 @@ int main(int argc, const char** argv) {
       CommandLine::RegisterMode("bench", "Very quick benchmark");
       CommandLine::RegisterMode("backendbench",
                                 "Quick benchmark of backend only");
+      CommandLine::RegisterMode(
+          "autotune", "Pick the backend, threads and batch size by measuring");
       CommandLine::RegisterMode("leela2onnx", "Convert Leela network to ONNX.");
       CommandLine::RegisterMode("onnx2leela",
                                 "Convert ONNX network to Leela net.");
       CommandLine::RegisterMode("describenet",
                                 "Shows details about the Leela network.");
+      CommandLine::RegisterMode(
+          "prebuildcache",
+          "Converts the network for a backend into the weights cache.");
+      CommandLine::RegisterMode(
+          "server", "Run many UCI sessions sharing one backend and cache");
     }
     for (const std::string_view search_name :
          SearchManager::Get()->GetSearchNames()) {
@@ -128,12 +137,19 @@ int main(int argc, const char** argv) {
       // Backend Benchmark mode.
       BackendBenchmark benchmark;
       benchmark.Run();
+    } else if (CommandLine::ConsumeCommand("autotune")) {
+      lczero::RunAutotune();
     } else if (CommandLine::ConsumeCommand("leela2onnx")) {
       lczero::ConvertLeelaToOnnx();
     } else if (CommandLine::ConsumeCommand("onnx2leela")) {
       lczero::ConvertOnnxToLeela();
     } else if (CommandLine::ConsumeCommand("describenet")) {
       lczero::DescribeNetworkCmd();
+    } else if (CommandLine::ConsumeCommand("prebuildcache")) {
+      lczero::PrebuildWeightsCacheCmd();
+    } else if (CommandLine::ConsumeCommand("server")) {
+      lczero::RunEngineServer(
+          SearchManager::Get()->GetFactoryByName("classic"));
     } else {
       lczero::ChooseAndRunEngine();
     }
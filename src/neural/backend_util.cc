@@ -0,0 +1,67 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "neural/backend_util.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+#include "utils/fastmath.h"
+
+namespace lczero {
+
+FillEmptyHistory EncodeHistoryFill(const std::string& history_fill) {
+  if (history_fill == "fen_only") return FillEmptyHistory::FEN_ONLY;
+  if (history_fill == "always") return FillEmptyHistory::ALWAYS;
+  assert(history_fill == "no");
+  return FillEmptyHistory::NO;
+}
+
+void SoftmaxPolicy(std::span<float> dst, const NetworkComputation& computation,
+                   int idx, std::span<const Move> legal_moves, int transform,
+                   float inverse_temperature) {
+  // Copy the values to the destination array and compute the maximum.
+  const float max_p = std::accumulate(
+      legal_moves.begin(), legal_moves.end(),
+      -std::numeric_limits<float>::infinity(),
+      [&, counter = 0](float max_p, const Move& move) mutable {
+        return std::max(max_p, dst[counter++] = computation.GetPVal(
+                                   idx, MoveToNNIndex(move, transform)));
+      });
+  // Compute the softmax and compute the total.
+  float total = std::accumulate(
+      dst.begin(), dst.end(), 0.0f, [&](float total, float& val) {
+        return total + (val = FastExp((val - max_p) * inverse_temperature));
+      });
+  const float scale = total > 0.0f ? 1.0f / total : 1.0f;
+  // Scale the values to sum to 1.0.
+  std::for_each(dst.begin(), dst.end(), [&](float& val) { val *= scale; });
+}
+
+}  // namespace lczero
@@ -0,0 +1,352 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "neural/backends/child_backends.h"
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/exception.h"
+#include "utils/logging.h"
+
+namespace lczero {
+namespace {
+
+class BalancingComputation;
+
+// Demultiplexes every batch over several child backends, giving each one a
+// share proportional to its measured throughput.
+class BalancingBackend : public Backend {
+ public:
+  BalancingBackend(const OptionsDict& options);
+  ~BalancingBackend();
+
+  BackendAttributes GetAttributes() const override { return attrs_; }
+  std::unique_ptr<BackendComputation> CreateComputation() override;
+  UpdateConfigurationResult UpdateConfiguration(
+      const OptionsDict& options) override;
+
+ private:
+  struct Child {
+    ChildSpec spec;
+    std::unique_ptr<Backend> backend;
+    size_t maximum_batch_size;
+    // Positions per second, exponentially weighted moving average. Zero until
+    // the first batch is measured.
+    std::atomic<double> throughput{0.0};
+    std::atomic<uint64_t> positions{0};
+    std::atomic<uint64_t> batches{0};
+    // Runs the child computations, so that children compute in parallel.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> jobs;
+    bool stop = false;
+    std::vector<std::thread> workers;
+  };
+
+  // Returns the child that would finish first with one more position, given
+  // the positions already assigned to each child.
+  size_t PickChild(const std::atomic<size_t>* counts) const;
+  void Enqueue(size_t child, std::function<void()> job);
+  void Worker(Child* child);
+  // Updates the throughput estimate of a child after it computed a batch.
+  void Measure(size_t child, size_t positions, double seconds);
+  std::string GetStats() const;
+
+  std::vector<std::unique_ptr<Child>> children_;
+  BackendAttributes attrs_;
+  std::string backend_opts_;
+  // Weight of the latest measurement in the throughput averages.
+  float alpha_;
+  // Computations between two logs of the statistics, 0 to disable.
+  int stats_interval_;
+  std::atomic<uint64_t> computations_{0};
+
+  friend class BalancingComputation;
+};
+
+class BalancingComputation : public BackendComputation {
+ public:
+  BalancingComputation(BalancingBackend* backend)
+      : backend_(backend),
+        counts_(std::make_unique<std::atomic<size_t>[]>(
+            backend->children_.size())) {
+    for (const auto& child : backend_->children_) {
+      computations_.push_back(child->backend->CreateComputation());
+    }
+  }
+
+  size_t UsedBatchSize() const override {
+    size_t total = 0;
+    for (size_t i = 0; i < computations_.size(); i++) total += counts_[i];
+    return total;
+  }
+
+  AddInputResult AddInput(const EvalPosition& pos,
+                          EvalResultPtr result) override {
+    const size_t child = backend_->PickChild(counts_.get());
+    ++counts_[child];
+    const auto status = computations_[child]->AddInput(pos, result);
+    if (status == FETCHED_IMMEDIATELY) --counts_[child];
+    return status;
+  }
+
+  void ComputeBlocking() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < computations_.size(); i++) {
+      const size_t count = counts_[i];
+      if (count == 0) continue;
+      pending_++;
+      backend_->Enqueue(i, [this, i, count]() {
+        std::exception_ptr exception;
+        try {
+          const auto start = std::chrono::steady_clock::now();
+          computations_[i]->ComputeBlocking();
+          const std::chrono::duration<double> elapsed =
+              std::chrono::steady_clock::now() - start;
+          backend_->Measure(i, count, elapsed.count());
+        } catch (...) {
+          exception = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (exception && !exception_) exception_ = exception;
+        if (--pending_ == 0) done_cv_.notify_one();
+      });
+    }
+    done_cv_.wait(lock, [this]() { return pending_ == 0; });
+    // A child's exception is rethrown here, after all children finished.
+    if (exception_) std::rethrow_exception(std::exchange(exception_, nullptr));
+    const auto computations = ++backend_->computations_;
+    if (backend_->stats_interval_ > 0 &&
+        computations % backend_->stats_interval_ == 0) {
+      LOGFILE << "Balance backend: " << backend_->GetStats();
+    }
+  }
+
+ private:
+  BalancingBackend* backend_;
+  std::vector<std::unique_ptr<BackendComputation>> computations_;
+  // Positions added to every child computation.
+  std::unique_ptr<std::atomic<size_t>[]> counts_;
+  std::mutex mutex_;
+  std::condition_variable done_cv_;
+  int pending_ = 0;
+  // The first exception thrown by a child computation.
+  std::exception_ptr exception_;
+};
+
+BalancingBackend::BalancingBackend(const OptionsDict& options)
+    : backend_opts_(
+          options.Get<std::string>(SharedBackendParams::kBackendOptionsId)) {
+  std::string own_opts;
+  const auto specs = ParseChildren(backend_opts_, "balance", &own_opts);
+  OptionsDict own_options;
+  own_options.AddSubdictFromString(own_opts);
+  alpha_ = own_options.GetOrDefault<float>("alpha", 0.1f);
+  stats_interval_ = own_options.GetOrDefault<int>("stats_interval", 1000);
+  const int workers = own_options.GetOrDefault<int>("workers", 0);
+
+  for (const auto& spec : specs) {
+    auto child = std::make_unique<Child>();
+    child->spec = spec;
+    OptionsDict child_options(&options);
+    SetChildOptions(spec, &child_options);
+    child->backend =
+        BackendManager::Get()->CreateFromName(spec.backend, child_options);
+    const auto attrs = child->backend->GetAttributes();
+    child->maximum_batch_size = attrs.maximum_batch_size;
+    if (children_.empty()) {
+      attrs_ = attrs;
+    } else {
+      attrs_.has_mlh &= attrs.has_mlh;
+      attrs_.has_wdl &= attrs.has_wdl;
+      attrs_.runs_on_cpu &= attrs.runs_on_cpu;
+      attrs_.suggested_num_search_threads +=
+          attrs.suggested_num_search_threads;
+      attrs_.recommended_batch_size += attrs.recommended_batch_size;
+      attrs_.maximum_batch_size += attrs.maximum_batch_size;
+    }
+    children_.push_back(std::move(child));
+  }
+  if (children_.empty()) {
+    throw Exception(
+        "The balance backend needs child backends, e.g. "
+        "--backend-opts=onednn,eigen(threads=2)");
+  }
+  // Started only once nothing can throw, as the destructor which joins them
+  // doesn't run when the constructor throws.
+  for (auto& child : children_) {
+    const int child_workers =
+        workers > 0
+            ? workers
+            : std::max(1, child->backend->GetAttributes()
+                              .suggested_num_search_threads);
+    for (int i = 0; i < child_workers; i++) {
+      child->workers.emplace_back(
+          [this, child = child.get()]() { Worker(child); });
+    }
+  }
+}
+
+BalancingBackend::~BalancingBackend() {
+  if (computations_ > 0) CERR << "Balance backend: " << GetStats();
+  for (auto& child : children_) {
+    {
+      std::lock_guard<std::mutex> lock(child->mutex);
+      child->stop = true;
+    }
+    child->cv.notify_all();
+    for (auto& worker : child->workers) worker.join();
+  }
+}
+
+std::unique_ptr<BackendComputation> BalancingBackend::CreateComputation() {
+  return std::make_unique<BalancingComputation>(this);
+}
+
+Backend::UpdateConfigurationResult BalancingBackend::UpdateConfiguration(
+    const OptionsDict& options) {
+  if (backend_opts_ !=
+      options.Get<std::string>(SharedBackendParams::kBackendOptionsId)) {
+    return NEED_RESTART;
+  }
+  UpdateConfigurationResult result = UPDATE_OK;
+  for (auto& child : children_) {
+    OptionsDict child_options(&options);
+    SetChildOptions(child->spec, &child_options);
+    if (child->backend->UpdateConfiguration(child_options) == NEED_RESTART) {
+      result = NEED_RESTART;
+    }
+  }
+  return result;
+}
+
+size_t BalancingBackend::PickChild(const std::atomic<size_t>* counts) const {
+  // Children not measured yet are assumed to be as fast as the fastest one, so
+  // that they get work and a measurement.
+  double fastest = 0.0;
+  for (const auto& child : children_) {
+    fastest = std::max(fastest, child->throughput.load());
+  }
+  if (fastest == 0.0) fastest = 1.0;
+  size_t best = 0;
+  double best_time = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < children_.size(); i++) {
+    if (counts[i] >= children_[i]->maximum_batch_size) continue;
+    double throughput = children_[i]->throughput;
+    if (throughput == 0.0) throughput = fastest;
+    const double time = (counts[i] + 1) / throughput;
+    if (time < best_time) {
+      best_time = time;
+      best = i;
+    }
+  }
+  return best;
+}
+
+void BalancingBackend::Enqueue(size_t child, std::function<void()> job) {
+  Child* c = children_[child].get();
+  {
+    std::lock_guard<std::mutex> lock(c->mutex);
+    c->jobs.push(std::move(job));
+  }
+  c->cv.notify_one();
+}
+
+void BalancingBackend::Worker(Child* child) {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(child->mutex);
+      child->cv.wait(lock,
+                     [child]() { return child->stop || !child->jobs.empty(); });
+      if (child->jobs.empty()) return;
+      job = std::move(child->jobs.front());
+      child->jobs.pop();
+    }
+    job();
+  }
+}
+
+void BalancingBackend::Measure(size_t child, size_t positions,
+                               double seconds) {
+  Child* c = children_[child].get();
+  c->positions += positions;
+  c->batches++;
+  if (seconds <= 0.0) return;
+  const double sample = positions / seconds;
+  double throughput = c->throughput;
+  // Concurrent updates may lose one of the samples, which is fine for an
+  // average.
+  c->throughput = throughput == 0.0
+                      ? sample
+                      : alpha_ * sample + (1.0 - alpha_) * throughput;
+}
+
+std::string BalancingBackend::GetStats() const {
+  double total = 0.0;
+  for (const auto& child : children_) total += child->throughput;
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i < children_.size(); i++) {
+    const auto& child = children_[i];
+    if (i > 0) oss << ", ";
+    oss << child->spec.name << ": "
+        << (total > 0.0 ? 100.0 * child->throughput / total : 0.0)
+        << "% share, " << child->throughput.load() << " pos/s, "
+        << child->positions.load() << " positions in "
+        << child->batches.load() << " batches";
+  }
+  return oss.str();
+}
+
+class BalancingBackendFactory : public BackendFactory {
+ public:
+  int GetPriority() const override { return -1002; }
+  std::string_view GetName() const override { return "balance"; }
+  std::unique_ptr<Backend> Create(const OptionsDict& options) override {
+    return std::make_unique<BalancingBackend>(options);
+  }
+};
+
+}  // namespace
+
+REGISTER_BACKEND(BalancingBackendFactory)
+
+}  // namespace lczero
@@ -0,0 +1,368 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "neural/backend_util.h"
+#include "neural/backends/child_backends.h"
+#include "neural/encoder.h"
+#include "neural/factory.h"
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/atomic_vector.h"
+#include "utils/exception.h"
+#include "utils/logging.h"
+
+namespace lczero {
+namespace {
+
+class EnsembleComputation;
+
+// Evaluates every batch on several networks (possibly with different weights
+// files and backends) and returns a weighted average of their outputs. The
+// positions are encoded once per input format and the planes are shared by the
+// members using that format. Every member except the first one has its own
+// thread, so that the members compute concurrently.
+//
+// Example: --backend=ensemble --backend-opts=
+//     big(backend=blas,weights="big.pb.gz",weight=2),
+//     small(backend=eigen,weights="small.pb.gz")
+class EnsembleBackend : public Backend {
+ public:
+  EnsembleBackend(const OptionsDict& options);
+  ~EnsembleBackend();
+
+  BackendAttributes GetAttributes() const override { return attrs_; }
+  std::unique_ptr<BackendComputation> CreateComputation() override;
+  UpdateConfigurationResult UpdateConfiguration(
+      const OptionsDict& options) override;
+
+ private:
+  struct Member {
+    ChildSpec spec;
+    std::unique_ptr<Network> network;
+    // Index into formats_.
+    size_t format;
+    // Normalized so that the weights of all members add up to 1.
+    float value_weight;
+    float policy_weight;
+    bool has_mlh;
+    // Runs the computations of this member, in the order they were queued.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::function<void()>> jobs;
+    bool stop = false;
+    std::thread worker;
+  };
+
+  void Worker(Member* member);
+  // Runs @job for every member concurrently and waits for all of them. An
+  // exception thrown by any of the jobs is rethrown once all of them finished.
+  void RunOnMembers(const std::function<void(size_t)>& job);
+
+  std::vector<std::unique_ptr<Member>> members_;
+  std::vector<pblczero::NetworkFormat::InputFormat> formats_;
+  BackendAttributes attrs_;
+  float softmax_policy_temperature_;
+  FillEmptyHistory fill_empty_history_;
+  const std::string backend_opts_;
+  const std::string weights_path_;
+
+  friend class EnsembleComputation;
+};
+
+class EnsembleComputation : public BackendComputation {
+ public:
+  EnsembleComputation(EnsembleBackend* backend)
+      : backend_(backend), entries_(backend_->attrs_.maximum_batch_size) {
+    for (const auto& member : backend_->members_) {
+      computations_.push_back(member->network->NewComputation());
+    }
+  }
+
+  size_t UsedBatchSize() const override { return entries_.size(); }
+
+  AddInputResult AddInput(const EvalPosition& pos,
+                          EvalResultPtr result) override {
+    const size_t idx = entries_.emplace_back();
+    Entry& entry = entries_[idx];
+    for (const auto format : backend_->formats_) {
+      int transform;
+      entry.inputs.push_back(EncodePositionForNN(
+          format, pos.pos, 8, backend_->fill_empty_history_, &transform));
+      entry.transforms.push_back(transform);
+    }
+    entry.legal_moves.assign(pos.legal_moves.begin(), pos.legal_moves.end());
+    entry.result = result;
+    return ENQUEUED_FOR_EVAL;
+  }
+
+  void ComputeBlocking() override {
+    const auto& members = backend_->members_;
+    // The last member of every input format takes the planes, the others copy.
+    std::vector<size_t> last_user(backend_->formats_.size());
+    for (size_t i = 0; i < members.size(); i++) {
+      last_user[members[i]->format] = i;
+    }
+    for (size_t i = 0; i < members.size(); i++) {
+      const size_t format = members[i]->format;
+      for (auto& entry : entries_) {
+        if (last_user[format] == i) {
+          computations_[i]->AddInput(std::move(entry.inputs[format]));
+        } else {
+          computations_[i]->AddInput(InputPlanes(entry.inputs[format]));
+        }
+      }
+    }
+    backend_->RunOnMembers(
+        [this](size_t member) { computations_[member]->ComputeBlocking(); });
+
+    std::vector<float> policy;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const Entry& entry = entries_[i];
+      const EvalResultPtr& result = entry.result;
+      float q = 0.0f, d = 0.0f, m = 0.0f, m_weight = 0.0f;
+      if (!result.p.empty()) {
+        std::fill(result.p.begin(), result.p.end(), 0.0f);
+        policy.resize(result.p.size());
+      }
+      for (size_t j = 0; j < members.size(); j++) {
+        const auto& member = *members[j];
+        const NetworkComputation* computation = computations_[j].get();
+        q += member.value_weight * computation->GetQVal(i);
+        d += member.value_weight * computation->GetDVal(i);
+        if (member.has_mlh) {
+          m += member.value_weight * computation->GetMVal(i);
+          m_weight += member.value_weight;
+        }
+        if (result.p.empty()) continue;
+        SoftmaxPolicy(policy, *computation, i, entry.legal_moves,
+                      entry.transforms[member.format],
+                      backend_->softmax_policy_temperature_);
+        for (size_t k = 0; k < policy.size(); k++) {
+          result.p[k] += member.policy_weight * policy[k];
+        }
+      }
+      if (result.q) *result.q = q;
+      if (result.d) *result.d = d;
+      if (result.m) *result.m = m_weight > 0.0f ? m / m_weight : 0.0f;
+    }
+  }
+
+ private:
+
+  struct Entry {
+    // Encoded position and its transform, one per input format.
+    std::vector<InputPlanes> inputs;
+    std::vector<int> transforms;
+    std::vector<Move> legal_moves;
+    EvalResultPtr result;
+  };
+
+  EnsembleBackend* backend_;
+  std::vector<std::unique_ptr<NetworkComputation>> computations_;
+  AtomicVector<Entry> entries_;
+};
+
+EnsembleBackend::EnsembleBackend(const OptionsDict& options)
+    : backend_opts_(
+          options.Get<std::string>(SharedBackendParams::kBackendOptionsId)),
+      weights_path_(options.Get<std::string>(SharedBackendParams::kWeightsId)) {
+  UpdateConfiguration(options);
+  const auto specs = ParseChildren(backend_opts_, "ensemble");
+  if (specs.size() < 2) {
+    throw Exception(
+        "The ensemble backend needs at least two members, e.g. "
+        "--backend-opts=a(backend=blas,weights=\"a.pb.gz\",weight=2),"
+        "b(backend=eigen,weights=\"b.pb.gz\")");
+  }
+  float total_value_weight = 0.0f;
+  float total_policy_weight = 0.0f;
+  for (const auto& spec : specs) {
+    auto member = std::make_unique<Member>();
+    member->spec = spec;
+    OptionsDict network_options;
+    network_options.AddSubdictFromString(spec.backend_opts);
+    const std::string path =
+        network_options.GetOrDefault<std::string>("weights", weights_path_);
+    member->value_weight = GetNumber(network_options, "weight", 1.0f);
+    member->policy_weight =
+        GetNumber(network_options, "policy_weight", member->value_weight);
+    if (member->value_weight < 0.0f || member->policy_weight < 0.0f) {
+      throw Exception("Ensemble member weights cannot be negative.");
+    }
+    total_value_weight += member->value_weight;
+    total_policy_weight += member->policy_weight;
+
+    CERR << "Ensemble member " << spec.name << ": " << spec.backend << " with "
+         << path << ", weight " << member->value_weight << ".";
+    member->network = NetworkFactory::Get()->Create(
+        spec.backend, LoadWeights(path), network_options);
+    network_options.CheckAllOptionsRead(spec.name);
+
+    const NetworkCapabilities& caps = member->network->GetCapabilities();
+    member->has_mlh = caps.has_mlh();
+    auto format =
+        std::find(formats_.begin(), formats_.end(), caps.input_format);
+    if (format == formats_.end()) {
+      format = formats_.insert(formats_.end(), caps.input_format);
+    }
+    member->format = format - formats_.begin();
+
+    if (members_.empty()) {
+      attrs_.has_mlh = caps.has_mlh();
+      attrs_.has_wdl = caps.has_wdl();
+      attrs_.runs_on_cpu = member->network->IsCpu();
+      attrs_.suggested_num_search_threads = member->network->GetThreads();
+      attrs_.recommended_batch_size = member->network->GetMiniBatchSize();
+      attrs_.maximum_batch_size = 1024;
+    } else {
+      attrs_.has_mlh |= caps.has_mlh();
+      attrs_.has_wdl &= caps.has_wdl();
+      attrs_.runs_on_cpu &= member->network->IsCpu();
+      attrs_.suggested_num_search_threads =
+          std::max(attrs_.suggested_num_search_threads,
+                   member->network->GetThreads());
+      attrs_.recommended_batch_size = std::min(
+          attrs_.recommended_batch_size, member->network->GetMiniBatchSize());
+    }
+    members_.push_back(std::move(member));
+  }
+  if (total_value_weight <= 0.0f || total_policy_weight <= 0.0f) {
+    throw Exception("Ensemble member weights cannot all be zero.");
+  }
+  for (auto& member : members_) {
+    member->value_weight /= total_value_weight;
+    member->policy_weight /= total_policy_weight;
+  }
+  // Started only once nothing can throw, as the destructor which joins them
+  // doesn't run when the constructor throws.
+  for (size_t i = 1; i < members_.size(); i++) {
+    members_[i]->worker =
+        std::thread([this, member = members_[i].get()]() { Worker(member); });
+  }
+}
+
+EnsembleBackend::~EnsembleBackend() {
+  for (auto& member : members_) {
+    if (!member->worker.joinable()) continue;
+    {
+      std::lock_guard<std::mutex> lock(member->mutex);
+      member->stop = true;
+    }
+    member->cv.notify_all();
+    member->worker.join();
+  }
+}
+
+std::unique_ptr<BackendComputation> EnsembleBackend::CreateComputation() {
+  return std::make_unique<EnsembleComputation>(this);
+}
+
+Backend::UpdateConfigurationResult EnsembleBackend::UpdateConfiguration(
+    const OptionsDict& options) {
+  if (backend_opts_ !=
+          options.Get<std::string>(SharedBackendParams::kBackendOptionsId) ||
+      weights_path_ !=
+          options.Get<std::string>(SharedBackendParams::kWeightsId)) {
+    return NEED_RESTART;
+  }
+  softmax_policy_temperature_ =
+      1.0f / options.Get<float>(SharedBackendParams::kPolicySoftmaxTemp);
+  fill_empty_history_ = EncodeHistoryFill(
+      options.Get<std::string>(SharedBackendParams::kHistoryFill));
+  return UPDATE_OK;
+}
+
+void EnsembleBackend::Worker(Member* member) {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(member->mutex);
+      member->cv.wait(
+          lock, [member]() { return member->stop || !member->jobs.empty(); });
+      if (member->jobs.empty()) return;
+      job = std::move(member->jobs.front());
+      member->jobs.pop();
+    }
+    job();
+  }
+}
+
+void EnsembleBackend::RunOnMembers(const std::function<void(size_t)>& job) {
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  size_t pending = members_.size() - 1;
+  std::exception_ptr exception;
+  const auto run = [&](size_t i) {
+    try {
+      job(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!exception) exception = std::current_exception();
+    }
+  };
+  for (size_t i = 1; i < members_.size(); i++) {
+    Member* member = members_[i].get();
+    {
+      std::lock_guard<std::mutex> lock(member->mutex);
+      member->jobs.push([&, i]() {
+        run(i);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) done_cv.notify_one();
+      });
+    }
+    member->cv.notify_one();
+  }
+  // The first member runs on the calling thread. Even if it fails, the workers
+  // still use the locals above, so they have to finish before returning.
+  run(0);
+  std::unique_lock<std::mutex> lock(mutex);
+  done_cv.wait(lock, [&]() { return pending == 0; });
+  if (exception) std::rethrow_exception(exception);
+}
+
+class EnsembleBackendFactory : public BackendFactory {
+ public:
+  int GetPriority() const override { return -1005; }
+  std::string_view GetName() const override { return "ensemble"; }
+  std::unique_ptr<Backend> Create(const OptionsDict& options) override {
+    return std::make_unique<EnsembleBackend>(options);
+  }
+};
+
+}  // namespace
+
+REGISTER_BACKEND(EnsembleBackendFactory)
+
+}  // namespace lczero
@@ -0,0 +1,421 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "neural/backends/child_backends.h"
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/exception.h"
+#include "utils/logging.h"
+
+namespace lczero {
+namespace {
+
+// A position evaluated by the working backend, waiting to be evaluated by the
+// reference backend.
+struct ShadowSample {
+  std::vector<Position> history;
+  std::vector<Move> legal_moves;
+  EvalResult work;
+};
+
+// Running comparison of the working backend against the reference one.
+struct ShadowStats {
+  uint64_t samples = 0;
+  double q_abs_error = 0.0;
+  double q_max_error = 0.0;
+  double d_abs_error = 0.0;
+  double m_abs_error = 0.0;
+  double policy_kld = 0.0;
+  uint64_t top1_agreements = 0;
+
+  void Add(const EvalResult& work, const EvalResult& reference) {
+    samples++;
+    const double q_error = std::abs(work.q - reference.q);
+    q_abs_error += q_error;
+    q_max_error = std::max(q_max_error, q_error);
+    d_abs_error += std::abs(work.d - reference.d);
+    m_abs_error += std::abs(work.m - reference.m);
+    // KL(reference || work), both are probabilities over the legal moves.
+    double kld = 0.0;
+    for (size_t i = 0; i < reference.p.size(); i++) {
+      const double p = reference.p[i];
+      if (p <= 0.0) continue;
+      kld += p * std::log(p / std::max<double>(work.p[i], 1e-9));
+    }
+    policy_kld += kld;
+    const auto work_top = std::max_element(work.p.begin(), work.p.end());
+    const auto reference_top =
+        std::max_element(reference.p.begin(), reference.p.end());
+    if (work_top - work.p.begin() == reference_top - reference.p.begin()) {
+      top1_agreements++;
+    }
+  }
+};
+
+class ShadowComputation;
+
+// Evaluates everything on the working backend, and additionally a random
+// sample of positions on the reference backend in a background thread, keeping
+// statistics of the differences. Unlike the check backend, the search never
+// waits for the reference backend: when the reference backend falls behind,
+// positions are not sampled.
+class ShadowBackend : public Backend {
+ public:
+  ShadowBackend(const OptionsDict& options);
+  ~ShadowBackend();
+
+  BackendAttributes GetAttributes() const override {
+    return work_->GetAttributes();
+  }
+  std::unique_ptr<BackendComputation> CreateComputation() override;
+  std::optional<EvalResult> GetCachedEvaluation(
+      const EvalPosition& pos) override {
+    return work_->GetCachedEvaluation(pos);
+  }
+  UpdateConfigurationResult UpdateConfiguration(
+      const OptionsDict& options) override;
+
+ private:
+  // Returns whether the next position should be sampled, reserving a place in
+  // the queue if so.
+  bool ReserveSample();
+  void CancelSamples(size_t count) { in_flight_ -= count; }
+  void Enqueue(std::deque<ShadowSample>&& samples);
+  void Worker();
+  std::string GetStats() const;
+  void DumpStats() const;
+
+  std::vector<ChildSpec> specs_;
+  std::unique_ptr<Backend> work_;
+  std::unique_ptr<Backend> reference_;
+  std::string backend_opts_;
+  // Fraction of the positions evaluated by the reference backend.
+  double rate_;
+  // Maximum number of sampled positions not yet evaluated by the reference.
+  size_t max_in_flight_;
+  size_t batch_size_;
+  // Samples between two dumps of the statistics, 0 to disable.
+  uint64_t stats_interval_;
+  std::string stats_file_;
+
+  std::atomic<size_t> in_flight_{0};
+  std::atomic<uint64_t> considered_{0};
+  std::atomic<uint64_t> dropped_{0};
+  // Samples lost because the reference backend failed to evaluate them.
+  std::atomic<uint64_t> failed_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<ShadowSample> queue_;
+  bool stop_ = false;
+  std::thread worker_;
+
+  mutable std::mutex stats_mutex_;
+  ShadowStats stats_;
+
+  friend class ShadowComputation;
+};
+
+class ShadowComputation : public BackendComputation {
+ public:
+  ShadowComputation(ShadowBackend* backend)
+      : backend_(backend), work_(backend->work_->CreateComputation()) {}
+  // Releases the samples which were never handed to the backend, when the
+  // computation is dropped before ComputeBlocking() or that failed.
+  ~ShadowComputation() { backend_->CancelSamples(samples_.size()); }
+
+  size_t UsedBatchSize() const override { return work_->UsedBatchSize(); }
+
+  AddInputResult AddInput(const EvalPosition& pos,
+                          EvalResultPtr result) override {
+    if (!backend_->ReserveSample()) return work_->AddInput(pos, result);
+    // The working backend writes into the sample, and the result is copied
+    // to the caller after the computation.
+    ShadowSample sample;
+    sample.history.assign(pos.pos.begin(), pos.pos.end());
+    sample.legal_moves.assign(pos.legal_moves.begin(), pos.legal_moves.end());
+    sample.work.p.resize(pos.legal_moves.size());
+    std::unique_lock<std::mutex> lock(mutex_);
+    samples_.push_back(std::move(sample));
+    destinations_.push_back(result);
+    const auto status = work_->AddInput(pos, samples_.back().work.AsPtr());
+    if (status == FETCHED_IMMEDIATELY) {
+      // Cache hits are not worth comparing.
+      CopyResult(samples_.back().work, result);
+      samples_.pop_back();
+      destinations_.pop_back();
+      backend_->CancelSamples(1);
+    }
+    return status;
+  }
+
+  void ComputeBlocking() override {
+    work_->ComputeBlocking();
+    for (size_t i = 0; i < samples_.size(); i++) {
+      CopyResult(samples_[i].work, destinations_[i]);
+    }
+    if (!samples_.empty()) backend_->Enqueue(std::move(samples_));
+    samples_.clear();
+  }
+
+ private:
+  static void CopyResult(const EvalResult& from, const EvalResultPtr& to) {
+    if (to.q) *to.q = from.q;
+    if (to.d) *to.d = from.d;
+    if (to.m) *to.m = from.m;
+    std::copy(from.p.begin(), from.p.begin() + to.p.size(), to.p.begin());
+  }
+
+  ShadowBackend* backend_;
+  std::unique_ptr<BackendComputation> work_;
+  // AddInput() may be called concurrently. Samples are kept in a deque so
+  // that the result pointers given to the working backend stay valid.
+  std::mutex mutex_;
+  std::deque<ShadowSample> samples_;
+  std::deque<EvalResultPtr> destinations_;
+};
+
+ShadowBackend::ShadowBackend(const OptionsDict& options)
+    : backend_opts_(
+          options.Get<std::string>(SharedBackendParams::kBackendOptionsId)) {
+  std::string own_opts;
+  specs_ = ParseChildren(backend_opts_, "shadow", &own_opts);
+  OptionsDict own_options;
+  own_options.AddSubdictFromString(own_opts);
+  rate_ = own_options.GetOrDefault<float>("rate", 0.01f);
+  max_in_flight_ = own_options.GetOrDefault<int>("queue", 1024);
+  batch_size_ = own_options.GetOrDefault<int>("batch", 0);
+  stats_interval_ = own_options.GetOrDefault<int>("stats_interval", 10000);
+  stats_file_ = own_options.GetOrDefault<std::string>("stats_file", "");
+
+  if (specs_.size() != 2) {
+    throw Exception(
+        "The shadow backend needs a working and a reference backend, e.g. "
+        "--backend-opts=work(backend=onnx-cpu),ref(backend=eigen),rate=0.05");
+  }
+  OptionsDict work_options(&options);
+  SetChildOptions(specs_[0], &work_options);
+  work_ = BackendManager::Get()->CreateFromName(specs_[0].backend,
+                                                work_options);
+  OptionsDict reference_options(&options);
+  SetChildOptions(specs_[1], &reference_options);
+  reference_ = BackendManager::Get()->CreateFromName(specs_[1].backend,
+                                                     reference_options);
+  if (batch_size_ == 0) {
+    batch_size_ =
+        std::max(1, reference_->GetAttributes().recommended_batch_size);
+  }
+  batch_size_ = std::min<size_t>(
+      batch_size_, reference_->GetAttributes().maximum_batch_size);
+
+  CERR << "Shadow backend: working backend " << specs_[0].backend
+       << ", reference backend " << specs_[1].backend << ", sampling "
+       << 100 * rate_ << "% of the positions.";
+  worker_ = std::thread([this]() { Worker(); });
+}
+
+ShadowBackend::~ShadowBackend() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  worker_.join();
+  if (stats_.samples > 0) {
+    CERR << "Shadow backend: " << GetStats();
+    DumpStats();
+  }
+}
+
+std::unique_ptr<BackendComputation> ShadowBackend::CreateComputation() {
+  return std::make_unique<ShadowComputation>(this);
+}
+
+Backend::UpdateConfigurationResult ShadowBackend::UpdateConfiguration(
+    const OptionsDict& options) {
+  if (backend_opts_ !=
+      options.Get<std::string>(SharedBackendParams::kBackendOptionsId)) {
+    return NEED_RESTART;
+  }
+  OptionsDict work_options(&options);
+  SetChildOptions(specs_[0], &work_options);
+  OptionsDict reference_options(&options);
+  SetChildOptions(specs_[1], &reference_options);
+  if (work_->UpdateConfiguration(work_options) == NEED_RESTART ||
+      reference_->UpdateConfiguration(reference_options) == NEED_RESTART) {
+    return NEED_RESTART;
+  }
+  return UPDATE_OK;
+}
+
+bool ShadowBackend::ReserveSample() {
+  thread_local std::minstd_rand generator(std::random_device{}());
+  thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  if (distribution(generator) >= rate_) return false;
+  ++considered_;
+  if (in_flight_++ >= max_in_flight_) {
+    --in_flight_;
+    ++dropped_;
+    return false;
+  }
+  return true;
+}
+
+void ShadowBackend::Enqueue(std::deque<ShadowSample>&& samples) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& sample : samples) queue_.push_back(std::move(sample));
+  }
+  cv_.notify_one();
+}
+
+void ShadowBackend::Worker() {
+  while (true) {
+    std::vector<ShadowSample> samples;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) return;
+      while (!queue_.empty() && samples.size() < batch_size_) {
+        samples.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+
+    std::vector<EvalResult> results(samples.size());
+    auto computation = reference_->CreateComputation();
+    for (size_t i = 0; i < samples.size(); i++) {
+      results[i].p.resize(samples[i].legal_moves.size());
+      computation->AddInput(
+          EvalPosition{samples[i].history, samples[i].legal_moves},
+          results[i].AsPtr());
+    }
+    try {
+      computation->ComputeBlocking();
+    } catch (const std::exception& e) {
+      // The search doesn't depend on the reference backend, keep going.
+      in_flight_ -= samples.size();
+      failed_ += samples.size();
+      LOGFILE << "Shadow backend: reference backend failed: " << e.what();
+      continue;
+    }
+    in_flight_ -= samples.size();
+
+    bool dump = false;
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      for (size_t i = 0; i < samples.size(); i++) {
+        stats_.Add(samples[i].work, results[i]);
+        if (stats_interval_ > 0 && stats_.samples % stats_interval_ == 0) {
+          dump = true;
+        }
+      }
+    }
+    if (dump) {
+      LOGFILE << "Shadow backend: " << GetStats();
+      DumpStats();
+    }
+  }
+}
+
+std::string ShadowBackend::GetStats() const {
+  ShadowStats stats;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats = stats_;
+  }
+  const double n = std::max<uint64_t>(stats.samples, 1);
+  std::ostringstream oss;
+  oss << stats.samples << " positions compared, " << dropped_.load() << " of "
+      << considered_.load() << " sampled positions dropped";
+  if (const uint64_t failed = failed_.load()) {
+    oss << ", " << failed << " failed on the reference backend";
+  }
+  oss << std::scientific << std::setprecision(2)
+      << "; Q MAE " << stats.q_abs_error / n << " (max " << stats.q_max_error
+      << "), D MAE " << stats.d_abs_error / n << ", M MAE "
+      << stats.m_abs_error / n << ", policy KLD " << stats.policy_kld / n;
+  oss << std::fixed << std::setprecision(2) << ", top-1 agreement "
+      << 100.0 * stats.top1_agreements / n << "%.";
+  return oss.str();
+}
+
+void ShadowBackend::DumpStats() const {
+  if (stats_file_.empty()) return;
+  ShadowStats stats;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats = stats_;
+  }
+  const double n = std::max<uint64_t>(stats.samples, 1);
+  std::ofstream file(stats_file_);
+  if (!file) {
+    LOGFILE << "Shadow backend: cannot write " << stats_file_;
+    return;
+  }
+  file << std::setprecision(9);
+  file << "work_backend " << specs_[0].backend << "\n"
+       << "reference_backend " << specs_[1].backend << "\n"
+       << "samples " << stats.samples << "\n"
+       << "sampled " << considered_.load() << "\n"
+       << "dropped " << dropped_.load() << "\n"
+       << "q_mae " << stats.q_abs_error / n << "\n"
+       << "q_max_error " << stats.q_max_error << "\n"
+       << "d_mae " << stats.d_abs_error / n << "\n"
+       << "m_mae " << stats.m_abs_error / n << "\n"
+       << "policy_kld " << stats.policy_kld / n << "\n"
+       << "top1_agreement " << static_cast<double>(stats.top1_agreements) / n
+       << "\n";
+}
+
+class ShadowBackendFactory : public BackendFactory {
+ public:
+  int GetPriority() const override { return -1003; }
+  std::string_view GetName() const override { return "shadow"; }
+  std::unique_ptr<Backend> Create(const OptionsDict& options) override {
+    return std::make_unique<ShadowBackend>(options);
+  }
+};
+
+}  // namespace
+
+REGISTER_BACKEND(ShadowBackendFactory)
+
+}  // namespace lczero
@@ -0,0 +1,244 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "neural/backends/child_backends.h"
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/exception.h"
+#include "utils/logging.h"
+
+namespace lczero {
+namespace {
+
+// Wraps a fast backend (trivial or random by default) and makes every batch
+// take as long as it would on a real accelerator: a fixed cost per batch plus
+// a cost per sample, randomized by a jitter factor. At most `concurrency`
+// batches are "on the device" at a time, the others queue in FIFO order. This
+// allows to benchmark the search batching and pipelining without a GPU.
+//
+// Example: --backend=simulated
+//     --backend-opts=trivial,fixed_ms=1,per_sample_us=8,jitter=0.1
+class SimulatedBackend : public Backend {
+ public:
+  SimulatedBackend(const OptionsDict& options);
+  ~SimulatedBackend();
+
+  BackendAttributes GetAttributes() const override { return attrs_; }
+  std::unique_ptr<BackendComputation> CreateComputation() override;
+  std::optional<EvalResult> GetCachedEvaluation(
+      const EvalPosition& pos) override {
+    return child_->GetCachedEvaluation(pos);
+  }
+  UpdateConfigurationResult UpdateConfiguration(
+      const OptionsDict& options) override;
+
+  // Computes the batch on the child backend and waits until the simulated
+  // latency of the batch is over.
+  void Compute(BackendComputation* computation, size_t batch_size);
+
+ private:
+  std::chrono::steady_clock::duration GetLatency(size_t batch_size);
+
+  ChildSpec spec_;
+  std::unique_ptr<Backend> child_;
+  BackendAttributes attrs_;
+  std::string backend_opts_;
+  std::chrono::duration<double, std::micro> fixed_cost_;
+  std::chrono::duration<double, std::micro> per_sample_cost_;
+  // Relative standard deviation of the latency.
+  double jitter_;
+  uint64_t concurrency_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::mt19937 generator_;
+  // Batches are admitted in the order of their tickets.
+  uint64_t next_ticket_ = 0;
+  uint64_t finished_ = 0;
+  uint64_t positions_ = 0;
+  std::chrono::duration<double> queue_time_{0};
+  std::chrono::duration<double> device_time_{0};
+};
+
+class SimulatedComputation : public BackendComputation {
+ public:
+  SimulatedComputation(SimulatedBackend* backend,
+                       std::unique_ptr<BackendComputation> computation)
+      : backend_(backend), computation_(std::move(computation)) {}
+
+  size_t UsedBatchSize() const override {
+    return computation_->UsedBatchSize();
+  }
+
+  AddInputResult AddInput(const EvalPosition& pos,
+                          EvalResultPtr result) override {
+    return computation_->AddInput(pos, result);
+  }
+
+  void ComputeBlocking() override {
+    backend_->Compute(computation_.get(), computation_->UsedBatchSize());
+  }
+
+ private:
+  SimulatedBackend* backend_;
+  std::unique_ptr<BackendComputation> computation_;
+};
+
+SimulatedBackend::SimulatedBackend(const OptionsDict& options)
+    : backend_opts_(
+          options.Get<std::string>(SharedBackendParams::kBackendOptionsId)),
+      generator_(std::random_device{}()) {
+  std::string own_opts;
+  const auto children = ParseChildren(backend_opts_, "simulated", &own_opts);
+  OptionsDict own_options;
+  own_options.AddSubdictFromString(own_opts);
+  fixed_cost_ = std::chrono::duration<double, std::milli>(
+      GetNumber(own_options, "fixed_ms", 1.0f));
+  per_sample_cost_ = std::chrono::duration<double, std::micro>(
+      GetNumber(own_options, "per_sample_us", 8.0f));
+  jitter_ = GetNumber(own_options, "jitter", 0.05f);
+  concurrency_ = std::max(1, own_options.GetOrDefault<int>("concurrency", 1));
+  const int seed = own_options.GetOrDefault<int>("seed", 0);
+  if (seed != 0) generator_.seed(seed);
+
+  if (children.size() > 1) {
+    throw Exception("The simulated backend takes at most one child backend.");
+  }
+  spec_ = children.empty() ? ChildSpec{"trivial", "trivial", ""} : children[0];
+  OptionsDict child_options(&options);
+  SetChildOptions(spec_, &child_options);
+  child_ = BackendManager::Get()->CreateFromName(spec_.backend, child_options);
+
+  // By default pretend to be a GPU.
+  attrs_ = child_->GetAttributes();
+  attrs_.runs_on_cpu = own_options.GetOrDefault<bool>("cpu", false);
+  attrs_.suggested_num_search_threads =
+      own_options.GetOrDefault<int>("threads", 2);
+  attrs_.recommended_batch_size = own_options.GetOrDefault<int>("batch", 256);
+  attrs_.maximum_batch_size =
+      own_options.GetOrDefault<int>("max_batch", 1024);
+
+  CERR << std::fixed << std::setprecision(1)
+       << "Simulated backend over " << spec_.backend << ": "
+       << fixed_cost_.count() << "us + " << per_sample_cost_.count()
+       << "us per sample, jitter " << 100 * jitter_ << "%, concurrency "
+       << concurrency_ << ".";
+}
+
+SimulatedBackend::~SimulatedBackend() {
+  if (finished_ == 0) return;
+  CERR << std::fixed << std::setprecision(1) << "Simulated backend: "
+       << finished_ << " batches, average size "
+       << static_cast<double>(positions_) / finished_ << ", average queue "
+       << 1e3 * queue_time_.count() / finished_ << "ms, device busy "
+       << 1e3 * device_time_.count() / finished_ << "ms per batch.";
+}
+
+std::unique_ptr<BackendComputation> SimulatedBackend::CreateComputation() {
+  return std::make_unique<SimulatedComputation>(this,
+                                                child_->CreateComputation());
+}
+
+Backend::UpdateConfigurationResult SimulatedBackend::UpdateConfiguration(
+    const OptionsDict& options) {
+  if (backend_opts_ !=
+      options.Get<std::string>(SharedBackendParams::kBackendOptionsId)) {
+    return NEED_RESTART;
+  }
+  OptionsDict child_options(&options);
+  SetChildOptions(spec_, &child_options);
+  return child_->UpdateConfiguration(child_options);
+}
+
+std::chrono::steady_clock::duration SimulatedBackend::GetLatency(
+    size_t batch_size) {
+  double factor = 1.0;
+  if (jitter_ > 0) {
+    std::normal_distribution<double> distribution(1.0, jitter_);
+    factor = std::max(0.0, distribution(generator_));
+  }
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      factor * (fixed_cost_ + per_sample_cost_ * batch_size));
+}
+
+void SimulatedBackend::Compute(BackendComputation* computation,
+                               size_t batch_size) {
+  const auto queued = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::duration latency;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t ticket = next_ticket_++;
+    cv_.wait(lock, [&]() { return ticket < finished_ + concurrency_; });
+    latency = GetLatency(batch_size);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  // The real evaluation is part of the simulated time.
+  try {
+    computation->ComputeBlocking();
+  } catch (...) {
+    // Free the device slot, or all later batches would wait for it forever.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_++;
+    }
+    cv_.notify_all();
+    throw;
+  }
+  std::this_thread::sleep_until(start + latency);
+  const auto end = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_++;
+    positions_ += batch_size;
+    queue_time_ += start - queued;
+    device_time_ += end - start;
+  }
+  cv_.notify_all();
+}
+
+class SimulatedBackendFactory : public BackendFactory {
+ public:
+  int GetPriority() const override { return -1004; }
+  std::string_view GetName() const override { return "simulated"; }
+  std::unique_ptr<Backend> Create(const OptionsDict& options) override {
+    return std::make_unique<SimulatedBackend>(options);
+  }
+};
+
+}  // namespace
+
+REGISTER_BACKEND(SimulatedBackendFactory)
+
+}  // namespace lczero
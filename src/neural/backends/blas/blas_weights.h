@@ -0,0 +1,299 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace lczero {
+
+// The weights the BLAS and Eigen backends compute with, after conversion
+// (Winograd transform) and with the selected policy and value heads only. The
+// tensors are views, either into the weights owned by the network or into a
+// memory mapped WeightsStore. Field names follow MultiHeadWeights, so that
+// VisitBlasWeights() below can walk both.
+struct BlasWeights {
+  using Vec = std::span<const float>;
+
+  struct ConvBlock {
+    Vec weights;
+    Vec biases;
+    Vec bn_gammas;
+    Vec bn_betas;
+    Vec bn_means;
+    Vec bn_stddivs;
+  };
+
+  struct SEunit {
+    Vec w1;
+    Vec b1;
+    Vec w2;
+    Vec b2;
+  };
+
+  struct Residual {
+    ConvBlock conv1;
+    ConvBlock conv2;
+    SEunit se;
+    bool has_se;
+  };
+
+  struct Smolgen {
+    Vec compress;
+    Vec dense1_w;
+    Vec dense1_b;
+    Vec ln1_gammas;
+    Vec ln1_betas;
+    Vec dense2_w;
+    Vec dense2_b;
+    Vec ln2_gammas;
+    Vec ln2_betas;
+  };
+
+  struct MHA {
+    Vec q_w;
+    Vec q_b;
+    Vec k_w;
+    Vec k_b;
+    Vec v_w;
+    Vec v_b;
+    Vec dense_w;
+    Vec dense_b;
+    Smolgen smolgen;
+    bool has_smolgen;
+  };
+
+  struct FFN {
+    Vec dense1_w;
+    Vec dense1_b;
+    Vec dense2_w;
+    Vec dense2_b;
+  };
+
+  struct EncoderLayer {
+    MHA mha;
+    Vec ln1_gammas;
+    Vec ln1_betas;
+    FFN ffn;
+    Vec ln2_gammas;
+    Vec ln2_betas;
+  };
+
+  struct PolicyHead {
+    Vec ip_pol_w;
+    Vec ip_pol_b;
+    ConvBlock policy1;
+    ConvBlock policy;
+    Vec ip2_pol_w;
+    Vec ip2_pol_b;
+    Vec ip3_pol_w;
+    Vec ip3_pol_b;
+    Vec ip4_pol_w;
+    int pol_encoder_head_count;
+    std::vector<EncoderLayer> pol_encoder;
+  };
+
+  struct ValueHead {
+    ConvBlock value;
+    Vec ip_val_w;
+    Vec ip_val_b;
+    Vec ip1_val_w;
+    Vec ip1_val_b;
+    Vec ip2_val_w;
+    Vec ip2_val_b;
+    Vec ip_val_err_w;
+    Vec ip_val_err_b;
+  };
+
+  // Convolution weights in the original layout for DirectConvolution3. Only
+  // kept when some batches skip Winograd.
+  struct DirectConvWeights {
+    Vec input;
+    std::vector<Vec> residual_conv1;
+    std::vector<Vec> residual_conv2;
+    Vec policy1;
+    Vec policy;
+  };
+
+  ConvBlock input;
+  Vec ip_emb_preproc_w;
+  Vec ip_emb_preproc_b;
+  Vec ip_emb_w;
+  Vec ip_emb_b;
+  Vec ip_emb_ln_gammas;
+  Vec ip_emb_ln_betas;
+  Vec ip_mult_gate;
+  Vec ip_add_gate;
+  FFN ip_emb_ffn;
+  Vec ip_emb_ffn_ln_gammas;
+  Vec ip_emb_ffn_ln_betas;
+  std::vector<EncoderLayer> encoder;
+  int encoder_head_count;
+  std::vector<Residual> residual;
+  ConvBlock moves_left;
+  Vec ip_mov_w;
+  Vec ip_mov_b;
+  Vec ip1_mov_w;
+  Vec ip1_mov_b;
+  Vec ip2_mov_w;
+  Vec ip2_mov_b;
+  Vec smolgen_w;
+  bool has_smolgen;
+
+  PolicyHead policy_head;
+  ValueHead value_head;
+  DirectConvWeights direct;
+};
+
+// Walks all tensors, layer counts and flags of the weights in a fixed order.
+// The visitor has Tensor(vec), Int(int_or_bool) and Count(vector_of_layers),
+// the latter is called before the layers of a vector are visited. With a
+// visitor which writes on MultiHeadWeights and a visitor which reads on
+// BlasWeights, this converts between the two.
+template <typename ConvBlock, typename Visitor>
+void VisitConvBlock(ConvBlock& block, Visitor& visitor) {
+  visitor.Tensor(block.weights);
+  visitor.Tensor(block.biases);
+  visitor.Tensor(block.bn_gammas);
+  visitor.Tensor(block.bn_betas);
+  visitor.Tensor(block.bn_means);
+  visitor.Tensor(block.bn_stddivs);
+}
+
+template <typename FFN, typename Visitor>
+void VisitFFN(FFN& ffn, Visitor& visitor) {
+  visitor.Tensor(ffn.dense1_w);
+  visitor.Tensor(ffn.dense1_b);
+  visitor.Tensor(ffn.dense2_w);
+  visitor.Tensor(ffn.dense2_b);
+}
+
+template <typename EncoderLayer, typename Visitor>
+void VisitEncoderLayers(std::vector<EncoderLayer>& layers, Visitor& visitor) {
+  visitor.Count(layers);
+  for (auto& layer : layers) {
+    auto& mha = layer.mha;
+    visitor.Tensor(mha.q_w);
+    visitor.Tensor(mha.q_b);
+    visitor.Tensor(mha.k_w);
+    visitor.Tensor(mha.k_b);
+    visitor.Tensor(mha.v_w);
+    visitor.Tensor(mha.v_b);
+    visitor.Tensor(mha.dense_w);
+    visitor.Tensor(mha.dense_b);
+    visitor.Int(mha.has_smolgen);
+    auto& smolgen = mha.smolgen;
+    visitor.Tensor(smolgen.compress);
+    visitor.Tensor(smolgen.dense1_w);
+    visitor.Tensor(smolgen.dense1_b);
+    visitor.Tensor(smolgen.ln1_gammas);
+    visitor.Tensor(smolgen.ln1_betas);
+    visitor.Tensor(smolgen.dense2_w);
+    visitor.Tensor(smolgen.dense2_b);
+    visitor.Tensor(smolgen.ln2_gammas);
+    visitor.Tensor(smolgen.ln2_betas);
+    visitor.Tensor(layer.ln1_gammas);
+    visitor.Tensor(layer.ln1_betas);
+    VisitFFN(layer.ffn, visitor);
+    visitor.Tensor(layer.ln2_gammas);
+    visitor.Tensor(layer.ln2_betas);
+  }
+}
+
+template <typename Weights, typename PolicyHead, typename ValueHead,
+          typename DirectConvWeights, typename Visitor>
+void VisitBlasWeights(Weights& weights, PolicyHead& policy_head,
+                      ValueHead& value_head, DirectConvWeights& direct,
+                      Visitor& visitor) {
+  VisitConvBlock(weights.input, visitor);
+  visitor.Tensor(weights.ip_emb_preproc_w);
+  visitor.Tensor(weights.ip_emb_preproc_b);
+  visitor.Tensor(weights.ip_emb_w);
+  visitor.Tensor(weights.ip_emb_b);
+  visitor.Tensor(weights.ip_emb_ln_gammas);
+  visitor.Tensor(weights.ip_emb_ln_betas);
+  visitor.Tensor(weights.ip_mult_gate);
+  visitor.Tensor(weights.ip_add_gate);
+  VisitFFN(weights.ip_emb_ffn, visitor);
+  visitor.Tensor(weights.ip_emb_ffn_ln_gammas);
+  visitor.Tensor(weights.ip_emb_ffn_ln_betas);
+  VisitEncoderLayers(weights.encoder, visitor);
+  visitor.Int(weights.encoder_head_count);
+  visitor.Count(weights.residual);
+  for (auto& residual : weights.residual) {
+    VisitConvBlock(residual.conv1, visitor);
+    VisitConvBlock(residual.conv2, visitor);
+    visitor.Int(residual.has_se);
+    visitor.Tensor(residual.se.w1);
+    visitor.Tensor(residual.se.b1);
+    visitor.Tensor(residual.se.w2);
+    visitor.Tensor(residual.se.b2);
+  }
+  VisitConvBlock(weights.moves_left, visitor);
+  visitor.Tensor(weights.ip_mov_w);
+  visitor.Tensor(weights.ip_mov_b);
+  visitor.Tensor(weights.ip1_mov_w);
+  visitor.Tensor(weights.ip1_mov_b);
+  visitor.Tensor(weights.ip2_mov_w);
+  visitor.Tensor(weights.ip2_mov_b);
+  visitor.Tensor(weights.smolgen_w);
+  visitor.Int(weights.has_smolgen);
+
+  visitor.Tensor(policy_head.ip_pol_w);
+  visitor.Tensor(policy_head.ip_pol_b);
+  VisitConvBlock(policy_head.policy1, visitor);
+  VisitConvBlock(policy_head.policy, visitor);
+  visitor.Tensor(policy_head.ip2_pol_w);
+  visitor.Tensor(policy_head.ip2_pol_b);
+  visitor.Tensor(policy_head.ip3_pol_w);
+  visitor.Tensor(policy_head.ip3_pol_b);
+  visitor.Tensor(policy_head.ip4_pol_w);
+  visitor.Int(policy_head.pol_encoder_head_count);
+  VisitEncoderLayers(policy_head.pol_encoder, visitor);
+
+  VisitConvBlock(value_head.value, visitor);
+  visitor.Tensor(value_head.ip_val_w);
+  visitor.Tensor(value_head.ip_val_b);
+  visitor.Tensor(value_head.ip1_val_w);
+  visitor.Tensor(value_head.ip1_val_b);
+  visitor.Tensor(value_head.ip2_val_w);
+  visitor.Tensor(value_head.ip2_val_b);
+  visitor.Tensor(value_head.ip_val_err_w);
+  visitor.Tensor(value_head.ip_val_err_b);
+
+  visitor.Tensor(direct.input);
+  visitor.Count(direct.residual_conv1);
+  for (auto& tensor : direct.residual_conv1) visitor.Tensor(tensor);
+  visitor.Count(direct.residual_conv2);
+  for (auto& tensor : direct.residual_conv2) visitor.Tensor(tensor);
+  visitor.Tensor(direct.policy1);
+  visitor.Tensor(direct.policy);
+}
+
+}  // namespace lczero
@@ -21,6 +21,8 @@
 #include <cstddef>
 #include <vector>
 
+#include "neural/backends/blas/output_channel_pool.h"
+
 namespace lczero {
 
 // Convolution 1x1
@@ -29,10 +31,12 @@ class Convolution1 {
  public:
   Convolution1() = delete;
 
-  // Batched forward inference.
+  // Batched forward inference. With a @pool the output channels are split
+  // between its threads.
   static void Forward(const size_t batch_size, const size_t input_channels,
                       const size_t output_channels, const float* input,
-                      const float* weights, float* output);
+                      const float* weights, float* output,
+                      OutputChannelPool* pool = nullptr);
 
  private:
   static constexpr auto kWidth = 8;
@@ -0,0 +1,127 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2026 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "neural/backends/blas/direct_convolution3.h"
+
+#include <Eigen/Dense>
+
+#include "neural/backends/blas/blas.h"
+
+namespace lczero {
+template <typename T>
+using EigenMatrixMap =
+    Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
+template <typename T>
+using ConstEigenMatrixMap =
+    Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
+
+template <bool use_eigen>
+DirectConvolution3<use_eigen>::DirectConvolution3(
+    const size_t max_batch_size, const size_t max_input_layers)
+    : columns_(max_batch_size * max_input_layers * kFilterSize * kSquares) {}
+
+template <bool use_eigen>
+void DirectConvolution3<use_eigen>::Im2Col(const size_t batch_size,
+                                           const size_t channels,
+                                           const float* input) {
+  // columns_[batch][channel][ky][kx][square] holds the input value under
+  // filter tap (ky, kx) for the output square, or zero outside the board.
+  float* col = columns_.data();
+  for (size_t i = 0; i < batch_size * channels; i++) {
+    const float* plane = input + i * kSquares;
+    for (int ky = -1; ky <= 1; ky++) {
+      for (int kx = -1; kx <= 1; kx++) {
+        for (int y = 0; y < kHeight; y++) {
+          const int iy = y + ky;
+          for (int x = 0; x < kWidth; x++) {
+            const int ix = x + kx;
+            *(col++) = (iy >= 0 && iy < kHeight && ix >= 0 && ix < kWidth)
+                           ? plane[iy * kWidth + ix]
+                           : 0.0f;
+          }
+        }
+      }
+    }
+  }
+}
+
+#ifdef USE_BLAS
+template <>
+void DirectConvolution3<false>::Forward(const size_t batch_size,
+                                        const size_t input_channels,
+                                        const size_t output_channels,
+                                        const float* input,
+                                        const float* weights, float* output,
+                                        OutputChannelPool* pool) {
+  Im2Col(batch_size, input_channels, input);
+  const size_t k = input_channels * kFilterSize;
+  SplitOutputChannels(pool, output_channels, [&](size_t begin, size_t end) {
+    for (size_t i = 0; i < batch_size; i++) {
+      //             C                          A                     B
+      //
+      //           outputs       :=          weights        x      columns
+      //
+      //   cols:  kSquares (N)         input_channels*9 (K)     kSquares(N)
+      //
+      //   rows:  output_channels (M)   output_channels (M)  input_channels*9(K)
+      cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                  (int)(end - begin),                    // M
+                  kSquares,                              // N
+                  (int)k,                                // K
+                  1.0f,                                  // Alpha
+                  weights + begin * k,                   // A
+                  (int)k,                                // lda
+                  &columns_[i * k * kSquares],           // B
+                  kSquares,                              // ldb
+                  0.0f,                                  // beta
+                  output + (i * output_channels + begin) * kSquares,  // C
+                  kSquares);                             // ldc
+    }
+  });
+}
+#endif
+
+template <>
+void DirectConvolution3<true>::Forward(const size_t batch_size,
+                                       const size_t input_channels,
+                                       const size_t output_channels,
+                                       const float* input,
+                                       const float* weights, float* output,
+                                       OutputChannelPool* pool) {
+  Im2Col(batch_size, input_channels, input);
+  const size_t k = input_channels * kFilterSize;
+  SplitOutputChannels(pool, output_channels, [&](size_t begin, size_t end) {
+    for (size_t i = 0; i < batch_size; i++) {
+      auto C_mat =
+          EigenMatrixMap<float>(output + (i * output_channels + begin) *
+                                             kSquares,
+                                kSquares, end - begin);
+      C_mat.noalias() =
+          ConstEigenMatrixMap<float>(&columns_[i * k * kSquares], kSquares,
+                                     k) *
+          ConstEigenMatrixMap<float>(weights + begin * k, k, end - begin);
+    }
+  });
+}
+
+template class DirectConvolution3<true>;
+#ifdef USE_BLAS
+template class DirectConvolution3<false>;
+#endif
+
+}  // namespace lczero
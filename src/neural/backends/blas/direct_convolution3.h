@@ -0,0 +1,56 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2026 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "neural/backends/blas/output_channel_pool.h"
+
+namespace lczero {
+
+// Convolution 3x3 on a 8x8 board as a single matrix multiplication over an
+// im2col copy of the input. Can replace WinogradConvolution3 for small
+// batches, trading 2.25x the multiplications for no transforms, which only
+// pays off with small filter counts or fast GEMM kernels. Weights are in the
+// original [output][input][3][3] layout, which is row major for the
+// multiplication, and output channels can be split over an OutputChannelPool.
+template <bool use_eigen>
+class DirectConvolution3 {
+ public:
+  DirectConvolution3(const size_t max_batch_size,
+                     const size_t max_input_layers);
+
+  // Forward inference, batched.
+  void Forward(const size_t batch_size, const size_t input_channels,
+               const size_t output_channels, const float* input,
+               const float* weights, float* output, OutputChannelPool* pool);
+
+ private:
+  void Im2Col(const size_t batch_size, const size_t channels,
+              const float* input);
+
+  static constexpr auto kWidth = 8;
+  static constexpr auto kHeight = 8;
+  static constexpr auto kSquares = kWidth * kHeight;
+  static constexpr auto kFilterSize = 9;
+
+  std::vector<float> columns_;
+};
+}  // namespace lczero
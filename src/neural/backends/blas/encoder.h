@@ -20,12 +20,15 @@
 
 #include <cmath>
 
+#include "utils/cpu_features.h"
+
 #ifdef USE_ISPC
 #include "layer_norm_ispc.h"
 #endif
 
 namespace lczero {
 
+LCZERO_CPU_DISPATCH
 void LayerNorm2DWithSkipConnection(const size_t batch_size,
                                    const size_t channels, float* data,
                                    const float alpha, const float* skip,
@@ -28,10 +28,12 @@
 namespace lczero {
 namespace {
 void ApplyBias(size_t batch_size, const size_t output_size, const float* biases,
-               const ActivationFunction activation, float* outputs) {
+               const ActivationFunction activation, float* outputs,
+               const size_t begin, const size_t end) {
   for (size_t i = 0; i < batch_size; i++) {
-    float* batch_outputs = outputs + i * output_size;
-    Activate(output_size, batch_outputs, biases, batch_outputs, activation);
+    float* batch_outputs = outputs + i * output_size + begin;
+    Activate(end - begin, batch_outputs, biases + begin, batch_outputs,
+             activation);
   }
 }
 }  // namespace
@@ -47,64 +49,73 @@ using EigenMatrixMap =
 template <typename T>
 using ConstEigenMatrixMap =
     Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
+template <typename T>
+using EigenStridedMatrixMap =
+    Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>, 0,
+               Eigen::OuterStride<>>;
 
 #ifdef USE_BLAS
 template <>
 void FullyConnectedLayer<false>::Forward1D(
     size_t batch_size, const size_t input_size, const size_t output_size,
     const float* inputs, const float* weights, const float* biases,
-    const ActivationFunction activation, float* outputs) {
-  if (batch_size == 1) {
-    // Just a matrix-vector multiplication
-    //
-    //             C                A                     B
-    //
-    //         outputs    :=     weights      x       inputs
-    //
-    //   cols:   1               input_size            1
-    //
-    //   rows  output_size      output_size          input_size
-    //
-    cblas_sgemv(CblasRowMajor, CblasNoTrans,
-                // M     K
-                (int)output_size, (int)input_size, 1.0f, weights,
-                (int)input_size, inputs, 1, 0.0f, outputs, 1);
-  } else {
-    // more columns, matrix-matrix multiplication
-    //
-    //             C                     A                         B
-    //
-    //            outputs      :=       weights        x         inputs
-    //
-    //   cols:   batch_size (N)       input_size  (K)          batch_size (N)
-    //
-    //   rows  output_size (M)        output_size (M)         input_size (K)
-    //
+    const ActivationFunction activation, float* outputs,
+    OutputChannelPool* pool) {
+  SplitOutputChannels(pool, output_size, [&](size_t begin, size_t end) {
+    if (batch_size == 1) {
+      // Just a matrix-vector multiplication
+      //
+      //             C                A                     B
+      //
+      //         outputs    :=     weights      x       inputs
+      //
+      //   cols:   1               input_size            1
+      //
+      //   rows  output_size      output_size          input_size
+      //
+      cblas_sgemv(CblasRowMajor, CblasNoTrans,
+                  // M     K
+                  (int)(end - begin), (int)input_size, 1.0f,
+                  weights + begin * input_size, (int)input_size, inputs, 1,
+                  0.0f, outputs + begin, 1);
+    } else {
+      // more columns, matrix-matrix multiplication
+      //
+      //             C                     A                         B
+      //
+      //            outputs      :=       weights        x         inputs
+      //
+      //   cols:   batch_size (N)       input_size  (K)          batch_size (N)
+      //
+      //   rows  output_size (M)        output_size (M)         input_size (K)
+      //
 
-    // C←αAB + βC
-    // M Number of rows in matrices A and C.
-    // N Number of columns in matrices B and C.
-    // K Number of columns in matrix A; number of rows in matrix B.
-    // lda The size of the first dimension of matrix A; if you are
-    // passing a matrix A[m][n], the value should be m.
-    //    cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
-    //                ldb, beta, C, N);
-    cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
-                (int)output_size,   // M
-                (int)batch_size,    // N
-                (int)input_size,    // K
-                1.0f,               // alpha
-                weights,            // A
-                (int)input_size,    // lda, leading rank of A
-                inputs,             // B
-                (int)input_size,    // ldb, leading rank of B
-                0.0f,               // beta
-                outputs,            // C
-                (int)output_size);  // ldc, leading rank of C
-  }
-  if (biases != nullptr) {
-    ApplyBias(batch_size, output_size, biases, activation, outputs);
-  }
+      // C←αAB + βC
+      // M Number of rows in matrices A and C.
+      // N Number of columns in matrices B and C.
+      // K Number of columns in matrix A; number of rows in matrix B.
+      // lda The size of the first dimension of matrix A; if you are
+      // passing a matrix A[m][n], the value should be m.
+      //    cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda,
+      //                B, ldb, beta, C, N);
+      cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                  (int)(end - begin),            // M
+                  (int)batch_size,               // N
+                  (int)input_size,               // K
+                  1.0f,                          // alpha
+                  weights + begin * input_size,  // A
+                  (int)input_size,               // lda, leading rank of A
+                  inputs,                        // B
+                  (int)input_size,               // ldb, leading rank of B
+                  0.0f,                          // beta
+                  outputs + begin,               // C
+                  (int)output_size);             // ldc, leading rank of C
+    }
+    if (biases != nullptr) {
+      ApplyBias(batch_size, output_size, biases, activation, outputs, begin,
+                end);
+    }
+  });
 }
 
 template <>
@@ -122,22 +133,28 @@ template <>
 void FullyConnectedLayer<true>::Forward1D(
     size_t batch_size, const size_t input_size, const size_t output_size,
     const float* inputs, const float* weights, const float* biases,
-    const ActivationFunction activation, float* outputs) {
-  if (batch_size == 1) {
-    EigenVectorMap<float> y(outputs, output_size);
-    y.noalias() = ConstEigenMatrixMap<float>(weights, input_size, output_size)
-                      .transpose() *
-                  ConstEigenVectorMap<float>(inputs, input_size);
-  } else {
-    auto C_mat = EigenMatrixMap<float>(outputs, output_size, batch_size);
-    C_mat.noalias() =
-        ConstEigenMatrixMap<float>(weights, input_size, output_size)
-            .transpose() *
-        ConstEigenMatrixMap<float>(inputs, input_size, batch_size);
-  }
-  if (biases != nullptr) {
-    ApplyBias(batch_size, output_size, biases, activation, outputs);
-  }
+    const ActivationFunction activation, float* outputs,
+    OutputChannelPool* pool) {
+  SplitOutputChannels(pool, output_size, [&](size_t begin, size_t end) {
+    const auto weights_mat = ConstEigenMatrixMap<float>(
+        weights + begin * input_size, input_size, end - begin);
+    if (batch_size == 1) {
+      EigenVectorMap<float> y(outputs + begin, end - begin);
+      y.noalias() = weights_mat.transpose() *
+                    ConstEigenVectorMap<float>(inputs, input_size);
+    } else {
+      auto C_mat = EigenStridedMatrixMap<float>(
+          outputs + begin, end - begin, batch_size,
+          Eigen::OuterStride<>(output_size));
+      C_mat.noalias() =
+          weights_mat.transpose() *
+          ConstEigenMatrixMap<float>(inputs, input_size, batch_size);
+    }
+    if (biases != nullptr) {
+      ApplyBias(batch_size, output_size, biases, activation, outputs, begin,
+                end);
+    }
+  });
 }
 
 template <>
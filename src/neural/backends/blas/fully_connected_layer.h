@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "neural/backends/blas/output_channel_pool.h"
 #include "neural/backends/shared/activation.h"
 
 #include <cstddef>
@@ -30,11 +31,13 @@ class FullyConnectedLayer {
  public:
   FullyConnectedLayer() = delete;
 
-  // Forward inference, batched, from input_size to output_size
+  // Forward inference, batched, from input_size to output_size. With a
+  // @pool the output channels are split between its threads.
   static void Forward1D(const size_t batch_size, const size_t input_size,
                         const size_t output_size, const float* input,
                         const float* weights, const float* biases,
-                        const ActivationFunction activation, float* output);
+                        const ActivationFunction activation, float* output,
+                        OutputChannelPool* pool = nullptr);
 
   // Forward inference, no batched, from input_size to scalar
   static float Forward0D(const size_t input_size, const float* input,
@@ -21,11 +21,15 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <optional>
 
 #include "neural/backends/blas/blas.h"
+#include "neural/backends/blas/blas_weights.h"
 #include "neural/backends/blas/convolution1.h"
+#include "neural/backends/blas/direct_convolution3.h"
 #include "neural/backends/blas/encoder.h"
 #include "neural/backends/blas/fully_connected_layer.h"
+#include "neural/backends/blas/output_channel_pool.h"
 #include "neural/backends/blas/se_unit.h"
 #include "neural/backends/blas/winograd_convolution3.h"
 #include "neural/backends/shared/activation.h"
@@ -35,6 +39,8 @@
 #include "neural/network_legacy.h"
 #include "neural/tables/attention_policy_map.h"
 #include "neural/tables/policy_map.h"
+#include "neural/weights_store.h"
+#include "utils/cpu_features.h"
 #include "utils/numa.h"
 
 #ifdef USE_DNNL
@@ -55,6 +61,45 @@ struct Buffers {
   std::vector<float> buffer4;
 };
 
+// Convolution weights in the original layout for DirectConvolution3. Only
+// kept when some batches skip Winograd.
+struct DirectConvWeights {
+  std::vector<float> input;
+  std::vector<std::vector<float>> residual_conv1;
+  std::vector<std::vector<float>> residual_conv2;
+  std::vector<float> policy1;
+  std::vector<float> policy;
+};
+
+// Collects the converted weights for a WeightsStore, or to build BlasWeights
+// directly on them.
+struct WeightsWriter {
+  void Tensor(const std::vector<float>& tensor) { writer.AddTensor(tensor); }
+  void Int(int value) { writer.AddInt(value); }
+  template <typename T>
+  void Count(const std::vector<T>& layers) {
+    writer.AddInt(layers.size());
+  }
+
+  WeightsStoreWriter writer;
+};
+
+// Fills BlasWeights from what WeightsWriter collected.
+struct WeightsReader {
+  void Tensor(BlasWeights::Vec& tensor) { tensor = tensors.at(tensor_idx++); }
+  void Int(int& value) { value = ints.at(int_idx++); }
+  void Int(bool& value) { value = ints.at(int_idx++); }
+  template <typename T>
+  void Count(std::vector<T>& layers) {
+    layers.resize(ints.at(int_idx++));
+  }
+
+  const std::vector<std::span<const float>>& tensors;
+  const std::vector<int64_t>& ints;
+  size_t tensor_idx = 0;
+  size_t int_idx = 0;
+};
+
 template <bool use_eigen>
 class BlasNetwork;
 
@@ -62,7 +107,7 @@ template <bool use_eigen>
 class BlasComputation : public NetworkComputation {
  public:
   BlasComputation(BlasNetwork<use_eigen>* network,
-                  const MultiHeadWeights& weights,
+                  const BlasWeights& weights,
                   const std::string policy_head, const std::string value_head,
                   const size_t max_batch_size, const bool wdl,
                   const bool moves_left, const bool conv_policy,
@@ -121,9 +166,10 @@ class BlasComputation : public NetworkComputation {
   void ForwardEncoderLayer(
       std::vector<float>& encoder_buffer, std::vector<float>& encoder_buffer2,
       std::vector<float>& encoder_buffer3, std::vector<float>& encoder_buffer4,
-      size_t batch_size, const MultiHeadWeights::EncoderLayer& layer,
+      size_t batch_size, const BlasWeights::EncoderLayer& layer,
       int embedding_size, int heads, ActivationFunction smolgen_activation,
-      ActivationFunction ffn_activation, float alpha, float default_eps);
+      ActivationFunction ffn_activation, float alpha, float default_eps,
+      OutputChannelPool* pool);
 
   static constexpr auto kWidth = 8;
   static constexpr auto kHeight = 8;
@@ -133,7 +179,7 @@ class BlasComputation : public NetworkComputation {
   // The real number of planes is higher because of padding.
   static constexpr auto kPolicyUsedPlanes = 73;
 
-  const MultiHeadWeights& weights_;
+  const BlasWeights& weights_;
   size_t max_batch_size_;
   std::vector<InputPlanes> planes_;
   std::vector<std::vector<float>> policies_;
@@ -176,6 +222,15 @@ class BlasNetwork : public Network {
 
   void InitThread(int id) override { Numa::BindThread(id); }
 
+  // Batches up to this size run in latency mode, with layers split over the
+  // output channel pool.
+  size_t GetSmallBatchSize() const { return small_batch_size_; }
+
+  // Batches up to this size use DirectConvolution3 instead of Winograd.
+  size_t GetDirectConvBatchSize() const { return direct_conv_batch_size_; }
+
+  OutputChannelPool* GetOutputChannelPool() const { return pool_.get(); }
+
   std::unique_ptr<Buffers> GetBuffers() {
     std::lock_guard<std::mutex> lock(buffers_lock_);
     if (free_buffers_.empty()) {
@@ -195,9 +250,19 @@ class BlasNetwork : public Network {
  private:
   // A cap on the max batch size since it consumes a lot of memory
   static constexpr auto kHardMaxBatchSize = 2048;
+  // Largest batch that runs in latency mode by default.
+  static constexpr auto kDefaultSmallBatchSize = 8;
+
+  // Converts the weights into owned_weights_ and direct_weights_, and passes
+  // the ones to compute with to @writer.
+  void ConvertWeights(const WeightsFile& file, WeightsWriter* writer);
 
   const NetworkCapabilities capabilities_;
-  MultiHeadWeights weights_;
+  // Either the weights are in the store, or the converted weights are owned.
+  std::unique_ptr<WeightsStore> store_;
+  std::optional<MultiHeadWeights> owned_weights_;
+  DirectConvWeights direct_weights_;
+  BlasWeights weights_;
   size_t max_batch_size_;
   bool wdl_;
   bool moves_left_;
@@ -212,11 +277,14 @@ class BlasNetwork : public Network {
   std::string value_head_;
   std::mutex buffers_lock_;
   std::vector<std::unique_ptr<Buffers>> free_buffers_;
+  size_t small_batch_size_;
+  size_t direct_conv_batch_size_;
+  std::unique_ptr<OutputChannelPool> pool_;
 };
 
 template <bool use_eigen>
 BlasComputation<use_eigen>::BlasComputation(
-    BlasNetwork<use_eigen>* network, const MultiHeadWeights& weights,
+    BlasNetwork<use_eigen>* network, const BlasWeights& weights,
     const std::string policy_head, const std::string value_head,
     const size_t max_batch_size, const bool wdl, const bool moves_left,
     const bool conv_policy, const ActivationFunction default_activation,
@@ -270,9 +338,10 @@ template <bool use_eigen>
 void BlasComputation<use_eigen>::ForwardEncoderLayer(
     std::vector<float>& encoder_buffer, std::vector<float>& encoder_buffer2,
     std::vector<float>& encoder_buffer3, std::vector<float>& encoder_buffer4,
-    size_t batch_size, const MultiHeadWeights::EncoderLayer& layer,
+    size_t batch_size, const BlasWeights::EncoderLayer& layer,
     int embedding_size, int heads, ActivationFunction smolgen_activation,
-    ActivationFunction ffn_activation, float alpha, float default_eps) {
+    ActivationFunction ffn_activation, float alpha, float default_eps,
+    OutputChannelPool* pool) {
   const int d_model = layer.mha.q_b.size();
   const int dff_size = layer.ffn.dense1_b.size();
   const int hidden_channels =
@@ -304,48 +373,49 @@ void BlasComputation<use_eigen>::ForwardEncoderLayer(
     FullyConnectedLayer<use_eigen>::Forward1D(
         batch_size * kSquares, embedding_size, hidden_channels, input,
         layer.mha.smolgen.compress.data(), (const float*)nullptr,
-        ACTIVATION_NONE, encoder_buffer2.data());
+        ACTIVATION_NONE, encoder_buffer2.data(), pool);
 
-    // Dense 1.
+    // Dense 1, bias and activation are applied in the layer norm epilogue.
     FullyConnectedLayer<use_eigen>::Forward1D(
         batch_size, kSquares * hidden_channels, hidden_sz,
         encoder_buffer2.data(), layer.mha.smolgen.dense1_w.data(),
-        layer.mha.smolgen.dense1_b.data(), smolgen_activation,
-        encoder_buffer3.data());
-    // Layer Norm.
-    LayerNorm2DWithSkipConnection(batch_size, hidden_sz, encoder_buffer3.data(),
-                                  1.0f, (const float*)nullptr,
-                                  layer.mha.smolgen.ln1_gammas.data(),
-                                  layer.mha.smolgen.ln1_betas.data(), 1e-3);
+        (const float*)nullptr, ACTIVATION_NONE, encoder_buffer3.data(), pool);
+    // Bias + activation + Layer Norm.
+    BiasActivateLayerNorm(batch_size, hidden_sz, encoder_buffer3.data(),
+                          layer.mha.smolgen.dense1_b.data(), smolgen_activation,
+                          1.0f, (const float*)nullptr,
+                          layer.mha.smolgen.ln1_gammas.data(),
+                          layer.mha.smolgen.ln1_betas.data(), 1e-3);
 
     // Dense 2.
     FullyConnectedLayer<use_eigen>::Forward1D(
         batch_size, hidden_sz, gen_sz_outputs, encoder_buffer3.data(),
-        layer.mha.smolgen.dense2_w.data(), layer.mha.smolgen.dense2_b.data(),
-        smolgen_activation, encoder_buffer2.data());
-    // Layer Norm.
-    LayerNorm2DWithSkipConnection(
-        batch_size, gen_sz_outputs, encoder_buffer2.data(), 1.0f,
-        (const float*)nullptr, layer.mha.smolgen.ln2_gammas.data(),
-        layer.mha.smolgen.ln2_betas.data(), 1e-3);
+        layer.mha.smolgen.dense2_w.data(), (const float*)nullptr,
+        ACTIVATION_NONE, encoder_buffer2.data(), pool);
+    // Bias + activation + Layer Norm.
+    BiasActivateLayerNorm(batch_size, gen_sz_outputs, encoder_buffer2.data(),
+                          layer.mha.smolgen.dense2_b.data(), smolgen_activation,
+                          1.0f, (const float*)nullptr,
+                          layer.mha.smolgen.ln2_gammas.data(),
+                          layer.mha.smolgen.ln2_betas.data(), 1e-3);
 
     // Global smolgen weights.
     FullyConnectedLayer<use_eigen>::Forward1D(
         batch_size * heads, gen_sz_outputs / heads, kSquares * kSquares,
         encoder_buffer2.data(), weights_.smolgen_w.data(),
-        (const float*)nullptr, ACTIVATION_NONE, QK);
+        (const float*)nullptr, ACTIVATION_NONE, QK, pool);
   }
 
   // Q
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, embedding_size, d_model, encoder_buffer.data(),
       layer.mha.q_w.data(), layer.mha.q_b.data(), ACTIVATION_NONE,
-      encoder_buffer2.data());
+      encoder_buffer2.data(), pool);
   // K
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, embedding_size, d_model, encoder_buffer.data(),
       layer.mha.k_w.data(), layer.mha.k_b.data(), ACTIVATION_NONE,
-      encoder_buffer3.data());
+      encoder_buffer3.data(), pool);
 
   // MHA (Q, K, V)
   const int depth = d_model / heads;
@@ -407,7 +477,7 @@ void BlasComputation<use_eigen>::ForwardEncoderLayer(
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, embedding_size, d_model, encoder_buffer.data(),
       layer.mha.v_w.data(), layer.mha.v_b.data(), ACTIVATION_NONE,
-      encoder_buffer3.data());
+      encoder_buffer3.data(), pool);
 
   for (auto batch = size_t{0}; batch < batch_size; batch++) {
     auto batchStart = batch * kSquares * d_model;
@@ -439,39 +509,41 @@ void BlasComputation<use_eigen>::ForwardEncoderLayer(
   // Fully connected final MHA layer.
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, d_model, embedding_size, encoder_buffer2.data(),
-      layer.mha.dense_w.data(), layer.mha.dense_b.data(), ACTIVATION_NONE,
-      encoder_buffer3.data());
-
-  // Layer Norm + skip connection.
-  LayerNorm2DWithSkipConnection(batch_size * kSquares, embedding_size,
-                                encoder_buffer3.data(), alpha,
-                                encoder_buffer.data(), layer.ln1_gammas.data(),
-                                layer.ln1_betas.data(), default_eps);
+      layer.mha.dense_w.data(), (const float*)nullptr, ACTIVATION_NONE,
+      encoder_buffer3.data(), pool);
+
+  // Bias + Layer Norm + skip connection.
+  BiasActivateLayerNorm(batch_size * kSquares, embedding_size,
+                        encoder_buffer3.data(), layer.mha.dense_b.data(),
+                        ACTIVATION_NONE, alpha, encoder_buffer.data(),
+                        layer.ln1_gammas.data(), layer.ln1_betas.data(),
+                        default_eps);
   std::swap(encoder_buffer3, encoder_buffer);
 
   // FFN.
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, embedding_size, dff_size, encoder_buffer.data(),
       layer.ffn.dense1_w.data(), layer.ffn.dense1_b.data(), ffn_activation,
-      encoder_buffer4.data());
+      encoder_buffer4.data(), pool);
 
   FullyConnectedLayer<use_eigen>::Forward1D(
       batch_size * kSquares, dff_size, layer.ffn.dense2_b.size(),
-      encoder_buffer4.data(), layer.ffn.dense2_w.data(),
-      layer.ffn.dense2_b.data(), ACTIVATION_NONE, encoder_buffer3.data());
-
-  // Layer Norm + skip connection.
-  LayerNorm2DWithSkipConnection(batch_size * kSquares, embedding_size,
-                                encoder_buffer3.data(), alpha,
-                                encoder_buffer.data(), layer.ln2_gammas.data(),
-                                layer.ln2_betas.data(), default_eps);
+      encoder_buffer4.data(), layer.ffn.dense2_w.data(), (const float*)nullptr,
+      ACTIVATION_NONE, encoder_buffer3.data(), pool);
+
+  // Bias + Layer Norm + skip connection.
+  BiasActivateLayerNorm(batch_size * kSquares, embedding_size,
+                        encoder_buffer3.data(), layer.ffn.dense2_b.data(),
+                        ACTIVATION_NONE, alpha, encoder_buffer.data(),
+                        layer.ln2_gammas.data(), layer.ln2_betas.data(),
+                        default_eps);
   std::swap(encoder_buffer3, encoder_buffer);
 }
 
 template <bool use_eigen>
 void BlasComputation<use_eigen>::ComputeBlocking() {
-  const auto& value_head = weights_.value_heads.at(value_head_);
-  const auto& policy_head = weights_.policy_heads.at(policy_head_);
+  const auto& value_head = weights_.value_head;
+  const auto& policy_head = weights_.policy_head;
   // Retrieve network key dimensions from the weights structure.
   const auto num_value_channels = value_head.ip1_val_b.size();
   const auto num_moves_channels = weights_.ip1_mov_b.size();
@@ -552,36 +624,58 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
 
   WinogradConvolution3<use_eigen> convolve3(largest_batch_size, max_channels,
                                             max_output_channels);
+  const auto& direct_weights = weights_.direct;
+  DirectConvolution3<use_eigen> direct_convolve3(
+      std::min(largest_batch_size, network_->GetDirectConvBatchSize()),
+      max_channels);
 
   for (size_t start = 0; start < total_batches; start += largest_batch_size) {
     const auto batch_size = std::min(total_batches - start, largest_batch_size);
+    // Latency mode for small batches.
+    OutputChannelPool* pool = batch_size <= network_->GetSmallBatchSize()
+                                  ? network_->GetOutputChannelPool()
+                                  : nullptr;
+    const bool direct_conv = batch_size <= network_->GetDirectConvBatchSize();
+    auto convolve = [&](size_t input_channels, size_t output_channels,
+                        const float* input, BlasWeights::Vec weights,
+                        BlasWeights::Vec direct, float* output) {
+      if (direct_conv) {
+        direct_convolve3.Forward(batch_size, input_channels, output_channels,
+                                 input, direct.data(), output, pool);
+      } else {
+        convolve3.Forward(batch_size, input_channels, output_channels, input,
+                          weights.data(), output, pool);
+      }
+    };
     for (size_t j = 0; j < batch_size; j++) {
       EncodePlanes(planes_[start + j], &buffer1[j * kSquares * kInputPlanes]);
     }
 
     if (num_res_blocks > 0) {
       // Input convolution
-      convolve3.Forward(batch_size, kInputPlanes, output_channels,
-                        buffer1.data(), weights_.input.weights.data(),
-                        buffer2.data());
+      convolve(kInputPlanes, output_channels, buffer1.data(),
+               weights_.input.weights, direct_weights.input, buffer2.data());
 
       BiasActivate(batch_size, output_channels, buffer2.data(),
                    weights_.input.biases.data(), default_activation_);
 
       // Residual tower
-      for (auto& residual : weights_.residual) {
+      for (size_t i = 0; i < num_res_blocks; i++) {
+        const auto& residual = weights_.residual[i];
         const auto& conv1 = residual.conv1;
         const auto& conv2 = residual.conv2;
         const auto& se = residual.se;
 
-        convolve3.Forward(batch_size, output_channels, output_channels,
-                          buffer2.data(), conv1.weights.data(), buffer1.data());
+        convolve(output_channels, output_channels, buffer2.data(),
+                 conv1.weights, direct_weights.residual_conv1[i],
+                 buffer1.data());
 
         BiasActivate(batch_size, output_channels, buffer1.data(),
                      conv1.biases.data(), default_activation_);
 
-        convolve3.Forward(batch_size, output_channels, output_channels,
-                          buffer1.data(), conv2.weights.data(), buffer3.data());
+        convolve(output_channels, output_channels, buffer1.data(),
+                 conv2.weights, direct_weights.residual_conv2[i],
+                 buffer3.data());
 
         if (residual.has_se) {
           // No relu if followed by SE-unit and residual/bias is added later
@@ -622,7 +716,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
               batch_size, kSquares * 12, weights_.ip_emb_preproc_b.size(),
               buffer3.data(), weights_.ip_emb_preproc_w.data(),
               weights_.ip_emb_preproc_b.data(), ACTIVATION_NONE,
-              buffer2.data());
+              buffer2.data(), pool);
         }
 
         // Preprocess for attention body.
@@ -650,16 +744,20 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
         }
       }
 
-      // Input embedding.
+      // Input embedding. With the new encoding bias and activation are
+      // applied in the layer norm epilogue.
       FullyConnectedLayer<use_eigen>::Forward1D(
           batch_size * kSquares, input_size, embedding_size, buffer3.data(),
-          weights_.ip_emb_w.data(), weights_.ip_emb_b.data(),
-          default_activation_, buffer1.data());
+          weights_.ip_emb_w.data(),
+          is_pe_dense_embedding_ ? (const float*)nullptr
+                                 : weights_.ip_emb_b.data(),
+          default_activation_, buffer1.data(), pool);
 
-      // Layer norm for new encoding.
+      // Bias + activation + Layer norm for new encoding.
       if (is_pe_dense_embedding_) {
-        LayerNorm2DWithSkipConnection(
-            batch_size * kSquares, embedding_size, buffer1.data(), 1.0f,
+        BiasActivateLayerNorm(
+            batch_size * kSquares, embedding_size, buffer1.data(),
+            weights_.ip_emb_b.data(), default_activation_, 1.0f,
             (const float*)nullptr, weights_.ip_emb_ln_gammas.data(),
             weights_.ip_emb_ln_betas.data(), 1e-3);
       }
@@ -689,20 +787,20 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
             batch_size * kSquares, embedding_size, dff_size, buffer1.data(),
             weights_.ip_emb_ffn.dense1_w.data(),
             weights_.ip_emb_ffn.dense1_b.data(), ffn_activation_,
-            buffer3.data());
+            buffer3.data(), pool);
 
         // FFN dense 2.
         FullyConnectedLayer<use_eigen>::Forward1D(
             batch_size * kSquares, dff_size,
             weights_.ip_emb_ffn.dense2_b.size(), buffer3.data(),
-            weights_.ip_emb_ffn.dense2_w.data(),
-            weights_.ip_emb_ffn.dense2_b.data(), ACTIVATION_NONE,
-            buffer2.data());
+            weights_.ip_emb_ffn.dense2_w.data(), (const float*)nullptr,
+            ACTIVATION_NONE, buffer2.data(), pool);
 
-        // Layer Norm.
-        LayerNorm2DWithSkipConnection(
+        // Bias + Layer Norm + skip connection.
+        BiasActivateLayerNorm(
             batch_size * kSquares, weights_.ip_emb_ffn.dense2_b.size(),
-            buffer2.data(), alpha, buffer1.data(),
+            buffer2.data(), weights_.ip_emb_ffn.dense2_b.data(),
+            ACTIVATION_NONE, alpha, buffer1.data(),
             weights_.ip_emb_ffn_ln_gammas.data(),
             weights_.ip_emb_ffn_ln_betas.data(), 1e-3);
 
@@ -714,7 +812,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
         ForwardEncoderLayer(buffer1, buffer2, buffer3, head_buffer, batch_size,
                             layer, embedding_size, weights_.encoder_head_count,
                             smolgen_activation_, ffn_activation_, alpha,
-                            is_pe_dense_embedding_ ? 1e-3 : 1e-6);
+                            is_pe_dense_embedding_ ? 1e-3 : 1e-6, pool);
       }
     }
 
@@ -724,11 +822,12 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
       FullyConnectedLayer<use_eigen>::Forward1D(
           batch_size * kSquares, weights_.ip_emb_b.size(),
           num_value_input_planes, buffer1.data(), value_head.ip_val_w.data(),
-          value_head.ip_val_b.data(), default_activation_, head_buffer.data());
+          value_head.ip_val_b.data(), default_activation_, head_buffer.data(),
+          pool);
     } else {
       Convolution1<use_eigen>::Forward(
           batch_size, output_channels, num_value_input_planes, buffer2.data(),
-          value_head.value.weights.data(), head_buffer.data());
+          value_head.value.weights.data(), head_buffer.data(), pool);
 
       BiasActivate(batch_size, num_value_input_planes, &head_buffer[0],
                    value_head.value.biases.data(), default_activation_);
@@ -739,7 +838,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
         head_buffer.data(), value_head.ip1_val_w.data(),
         value_head.ip1_val_b.data(),
         default_activation_,  // Activation On
-        buffer3.data());
+        buffer3.data(), pool);
 
     // Now get the score
     if (wdl_) {
@@ -748,7 +847,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
           batch_size, num_value_channels, 3, buffer3.data(),
           value_head.ip2_val_w.data(), value_head.ip2_val_b.data(),
           ACTIVATION_NONE,  // Activation Off
-          wdl.data());
+          wdl.data(), pool);
 
       for (size_t j = 0; j < batch_size; j++) {
         std::vector<float> wdl_softmax(3);
@@ -775,11 +874,12 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
         FullyConnectedLayer<use_eigen>::Forward1D(
             batch_size * kSquares, weights_.ip_emb_b.size(),
             num_moves_input_planes, buffer1.data(), weights_.ip_mov_w.data(),
-            weights_.ip_mov_b.data(), default_activation_, head_buffer.data());
+            weights_.ip_mov_b.data(), default_activation_, head_buffer.data(),
+            pool);
       } else {
         Convolution1<use_eigen>::Forward(
             batch_size, output_channels, num_moves_input_planes, buffer2.data(),
-            weights_.moves_left.weights.data(), head_buffer.data());
+            weights_.moves_left.weights.data(), head_buffer.data(), pool);
 
         BiasActivate(batch_size, num_moves_input_planes, &head_buffer[0],
                      weights_.moves_left.biases.data(), default_activation_);
@@ -790,14 +890,14 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
           head_buffer.data(), weights_.ip1_mov_w.data(),
           weights_.ip1_mov_b.data(),
           default_activation_,  // Activation On
-          buffer3.data());
+          buffer3.data(), pool);
 
       std::vector<float> output_moves_left(batch_size);
       FullyConnectedLayer<use_eigen>::Forward1D(
           batch_size, num_moves_channels, 1, buffer3.data(),
           weights_.ip2_mov_w.data(), weights_.ip2_mov_b.data(),
           ACTIVATION_RELU,  // Specifically Relu
-          &m_values_[start]);
+          &m_values_[start], pool);
     }
 
     // Policy head.
@@ -823,7 +923,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
           attn_body_
               ? default_activation_
               : ACTIVATION_SELU,  // SELU activation hardcoded for apmish nets.
-          buffer2.data());
+          buffer2.data(), pool);
 
       const size_t policy_d_model = policy_head.ip2_pol_b.size();
 
@@ -832,19 +932,19 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
             buffer2, buffer1, buffer3, head_buffer, batch_size, layer,
             policy_embedding_size, policy_head.pol_encoder_head_count,
             attn_body_ ? smolgen_activation_ : ACTIVATION_NONE,
-            attn_body_ ? ffn_activation_ : ACTIVATION_SELU, 1.0f, 1e-6);
+            attn_body_ ? ffn_activation_ : ACTIVATION_SELU, 1.0f, 1e-6, pool);
       }
 
       // Q
       FullyConnectedLayer<use_eigen>::Forward1D(
           batch_size * kSquares, policy_embedding_size, policy_d_model,
           buffer2.data(), policy_head.ip2_pol_w.data(),
-          policy_head.ip2_pol_b.data(), ACTIVATION_NONE, buffer1.data());
+          policy_head.ip2_pol_b.data(), ACTIVATION_NONE, buffer1.data(), pool);
       // K
       FullyConnectedLayer<use_eigen>::Forward1D(
           batch_size * kSquares, policy_embedding_size, policy_d_model,
           buffer2.data(), policy_head.ip3_pol_w.data(),
-          policy_head.ip3_pol_b.data(), ACTIVATION_NONE, buffer3.data());
+          policy_head.ip3_pol_b.data(), ACTIVATION_NONE, buffer3.data(), pool);
       const float scaling = 1.0f / sqrtf(policy_d_model);
       for (auto batch = size_t{0}; batch < batch_size; batch++) {
         const float* A = &buffer1[batch * 64 * policy_d_model];
@@ -912,16 +1012,16 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
       }
     } else if (conv_policy_) {
       assert(!attn_body_);  // not supported with attention body
-      convolve3.Forward(batch_size, output_channels, output_channels,
-                        buffer2.data(), policy_head.policy1.weights.data(),
-                        buffer1.data());
+      convolve(output_channels, output_channels, buffer2.data(),
+               policy_head.policy1.weights, direct_weights.policy1,
+               buffer1.data());
 
       BiasActivate(batch_size, output_channels, buffer1.data(),
                    policy_head.policy1.biases.data(), default_activation_);
 
-      convolve3.Forward(batch_size, output_channels, num_policy_input_planes,
-                        buffer1.data(), policy_head.policy.weights.data(),
-                        head_buffer.data());
+      convolve(output_channels, num_policy_input_planes, buffer1.data(),
+               policy_head.policy.weights, direct_weights.policy,
+               head_buffer.data());
 
       BiasActivate(batch_size, num_policy_input_planes, head_buffer.data(),
                    policy_head.policy.biases.data(), ACTIVATION_NONE);
@@ -943,7 +1043,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
       assert(!attn_body_);  // not supported with attention body
       Convolution1<use_eigen>::Forward(
           batch_size, output_channels, num_policy_input_planes, buffer2.data(),
-          policy_head.policy.weights.data(), head_buffer.data());
+          policy_head.policy.weights.data(), head_buffer.data(), pool);
 
       BiasActivate(batch_size, num_policy_input_planes, &head_buffer[0],
                    policy_head.policy.biases.data(), default_activation_);
@@ -953,7 +1053,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
           head_buffer.data(), policy_head.ip_pol_w.data(),
           policy_head.ip_pol_b.data(),
           ACTIVATION_NONE,  // Activation Off
-          buffer3.data());
+          buffer3.data(), pool);
 
       for (size_t j = 0; j < batch_size; j++) {
         std::vector<float> policy(num_output_policy);
@@ -969,6 +1069,7 @@ void BlasComputation<use_eigen>::ComputeBlocking() {
 }
 
 template <bool use_eigen>
+LCZERO_CPU_DISPATCH
 void BlasComputation<use_eigen>::EncodePlanes(const InputPlanes& sample,
                                               float* buffer) {
   for (const InputPlane& plane : sample) {
@@ -983,8 +1084,7 @@ BlasNetwork<use_eigen>::BlasNetwork(const WeightsFile& file,
                                     const OptionsDict& options)
     : capabilities_{file.format().network_format().input(),
                     file.format().network_format().output(),
-                    file.format().network_format().moves_left()},
-      weights_(file.weights()) {
+                    file.format().network_format().moves_left()} {
   Numa::Init();
 
   max_batch_size_ =
@@ -1028,50 +1128,77 @@ BlasNetwork<use_eigen>::BlasNetwork(const WeightsFile& file,
     max_batch_size_ = kHardMaxBatchSize;
   }
 
-  const auto inputChannels = kInputPlanes;
-  const auto channels = static_cast<int>(weights_.input.biases.size());
-  const auto residual_blocks = weights_.residual.size();
-
-  weights_.input.weights =
-      WinogradFilterTransformF(weights_.input.weights, channels, inputChannels);
-
-  // residual blocks
-  for (size_t i = 0; i < residual_blocks; i++) {
-    auto& residual = weights_.residual[i];
-    auto& conv1 = residual.conv1;
-    auto& conv2 = residual.conv2;
-
-    conv1.weights = WinogradFilterTransformF(conv1.weights, channels, channels);
-    conv2.weights = WinogradFilterTransformF(conv2.weights, channels, channels);
+  small_batch_size_ = static_cast<size_t>(
+      options.GetOrDefault<int>("small_batch_size", kDefaultSmallBatchSize));
+  const int small_batch_threads =
+      options.GetOrDefault<int>("small_batch_threads", 1);
+  if (small_batch_threads > 1) {
+    pool_ = std::make_unique<OutputChannelPool>(small_batch_threads);
   }
+  direct_conv_batch_size_ = static_cast<size_t>(
+      options.GetOrDefault<int>("direct_conv_batch_size", 0));
 
   policy_head_ = options.GetOrDefault<std::string>("policy_head", "vanilla");
-  // Check that selected policy head exists.
-  if (weights_.policy_heads.count(policy_head_) == 0) {
-    throw Exception("The policy head you specified '" + policy_head_ +
-                    "' does not exist in this net.");
-  }
-
   value_head_ = options.GetOrDefault<std::string>("value_head", "winner");
-  // Check that selected value head exists.
-  if (weights_.value_heads.count(value_head_) == 0) {
-    throw Exception("The value head you specified '" + value_head_ +
-                    "' does not exist in this net.");
-  }
 
-  if (conv_policy_) {
-    auto& policy_head = weights_.policy_heads.at("vanilla");
-    policy_head.policy1.weights = WinogradFilterTransformF(
-        policy_head.policy1.weights, channels, channels);
-    auto pol_channels = policy_head.policy.biases.size();
-    policy_head.policy.weights = WinogradFilterTransformF(
-        policy_head.policy.weights, pol_channels, channels);
+  // The key is set by the backend wrapper, it identifies the weights file.
+  const auto store_path =
+      options.GetOrDefault<std::string>("weights_store", "");
+  const auto store_key =
+      options.GetOrDefault<std::string>("weights_store_key", "");
+  const auto store_source =
+      options.GetOrDefault<std::string>("weights_store_source", "");
+  if (!store_path.empty() && store_key.empty()) {
+    CERR << "Weights store is not supported here, ignoring " << store_path
+         << ".";
+  } else if (!store_path.empty()) {
+    store_ = WeightsStore::Open(store_path, store_key);
   }
+  WeightsWriter writer;
+  if (store_) {
+    CERR << "Using weights from store " << store_path << ".";
+  } else {
+    // Only the format was loaded when the store was found, load the weights
+    // if the store has been replaced or removed since.
+    std::optional<WeightsFile> reloaded;
+    if (!file.has_weights()) {
+      CERR << "Weights store " << store_path
+           << " was replaced while loading, loading the weights file.";
+      reloaded = LoadWeights(store_source);
+    }
+    const WeightsFile& weights = reloaded ? *reloaded : file;
+    ConvertWeights(weights, &writer);
+    if (!store_path.empty() && !store_key.empty()) {
+      try {
+        writer.writer.Publish(store_path, store_key, weights);
+        // Switch to the published copy, which is shared with other processes.
+        store_ = WeightsStore::Open(store_path, store_key);
+      } catch (const Exception& e) {
+        CERR << "Cannot use weights store: " << e.what();
+      }
+    }
+  }
+  WeightsReader reader{store_ ? store_->tensors() : writer.writer.tensors(),
+                       store_ ? store_->ints() : writer.writer.ints()};
+  VisitBlasWeights(weights_, weights_.policy_head, weights_.value_head,
+                   weights_.direct, reader);
+  if (store_) {
+    owned_weights_.reset();
+    direct_weights_ = {};
+  }
+  // Direct convolution weights are looked up for every residual block, even
+  // when they are not used.
+  weights_.direct.residual_conv1.resize(weights_.residual.size());
+  weights_.direct.residual_conv2.resize(weights_.residual.size());
 
   if (use_eigen) {
     CERR << "Using Eigen version " << EIGEN_WORLD_VERSION << "."
          << EIGEN_MAJOR_VERSION << "." << EIGEN_MINOR_VERSION;
     CERR << "Eigen max batch size is " << max_batch_size_ << ".";
+    if (pool_) {
+      CERR << "Eigen latency mode for batches up to " << small_batch_size_
+           << " with " << small_batch_threads << " threads.";
+    }
   } else {
 #ifdef USE_OPENBLAS
     int num_procs = openblas_get_num_procs();
@@ -1106,7 +1233,72 @@ BlasNetwork<use_eigen>::BlasNetwork(const WeightsFile& file,
     CERR << "BLAS vendor: Apple vecLib.";
 #endif
     CERR << "BLAS max batch size is " << max_batch_size_ << ".";
+    if (pool_) {
+      CERR << "BLAS latency mode for batches up to " << small_batch_size_
+           << " with " << small_batch_threads << " threads.";
+    }
+  }
+}
+
+template <bool use_eigen>
+void BlasNetwork<use_eigen>::ConvertWeights(const WeightsFile& file,
+                                            WeightsWriter* writer) {
+  owned_weights_.emplace(file.weights());
+  auto& weights = *owned_weights_;
+  const auto inputChannels = kInputPlanes;
+  const auto channels = static_cast<int>(weights.input.biases.size());
+  const auto residual_blocks = weights.residual.size();
+
+  // Keep the original layout of the 3x3 filters for direct convolution.
+  if (direct_conv_batch_size_ > 0) {
+    direct_weights_.input = weights.input.weights;
+    for (const auto& residual : weights.residual) {
+      direct_weights_.residual_conv1.push_back(residual.conv1.weights);
+      direct_weights_.residual_conv2.push_back(residual.conv2.weights);
+    }
+  }
+
+  weights.input.weights =
+      WinogradFilterTransformF(weights.input.weights, channels, inputChannels);
+
+  // residual blocks
+  for (size_t i = 0; i < residual_blocks; i++) {
+    auto& residual = weights.residual[i];
+    auto& conv1 = residual.conv1;
+    auto& conv2 = residual.conv2;
+
+    conv1.weights = WinogradFilterTransformF(conv1.weights, channels, channels);
+    conv2.weights = WinogradFilterTransformF(conv2.weights, channels, channels);
+  }
+
+  // Check that selected policy head exists.
+  if (weights.policy_heads.count(policy_head_) == 0) {
+    throw Exception("The policy head you specified '" + policy_head_ +
+                    "' does not exist in this net.");
+  }
+
+  // Check that selected value head exists.
+  if (weights.value_heads.count(value_head_) == 0) {
+    throw Exception("The value head you specified '" + value_head_ +
+                    "' does not exist in this net.");
   }
+
+  if (conv_policy_) {
+    auto& policy_head = weights.policy_heads.at("vanilla");
+    if (direct_conv_batch_size_ > 0) {
+      direct_weights_.policy1 = policy_head.policy1.weights;
+      direct_weights_.policy = policy_head.policy.weights;
+    }
+    policy_head.policy1.weights = WinogradFilterTransformF(
+        policy_head.policy1.weights, channels, channels);
+    auto pol_channels = policy_head.policy.biases.size();
+    policy_head.policy.weights = WinogradFilterTransformF(
+        policy_head.policy.weights, pol_channels, channels);
+  }
+
+  VisitBlasWeights(weights, weights.policy_heads.at(policy_head_),
+                   weights.value_heads.at(value_head_), direct_weights_,
+                   *writer);
 }
 
 template <bool use_eigen>
@@ -1179,9 +1371,9 @@ std::unique_ptr<Network> MakeBlasNetwork(const std::optional<WeightsFile>& w,
 }
 
 #ifdef USE_BLAS
-REGISTER_NETWORK("blas", MakeBlasNetwork<false>, 50)
+REGISTER_NETWORK_WITH_WEIGHTS_STORE("blas", MakeBlasNetwork<false>, 50)
 #endif
-REGISTER_NETWORK("eigen", MakeBlasNetwork<true>, 49)
+REGISTER_NETWORK_WITH_WEIGHTS_STORE("eigen", MakeBlasNetwork<true>, 49)
 
 }  // namespace
 }  // namespace lczero
@@ -0,0 +1,98 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2026 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "neural/backends/blas/output_channel_pool.h"
+
+#include <algorithm>
+
+namespace lczero {
+namespace {
+constexpr size_t kChannelGranularity = OutputChannelPool::kChannelGranularity;
+
+std::pair<size_t, size_t> GetRange(size_t channels, size_t id, size_t parts) {
+  const size_t blocks =
+      (channels + kChannelGranularity - 1) / kChannelGranularity;
+  const size_t begin =
+      std::min(channels, blocks * id / parts * kChannelGranularity);
+  const size_t end =
+      std::min(channels, blocks * (id + 1) / parts * kChannelGranularity);
+  return {begin, end};
+}
+}  // namespace
+
+OutputChannelPool::OutputChannelPool(int threads) {
+  for (int i = 1; i < threads; i++) {
+    workers_.emplace_back([this, i]() { Worker(i); });
+  }
+}
+
+OutputChannelPool::~OutputChannelPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void OutputChannelPool::Run(size_t channels, const Func& func) {
+  std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+  if (!run_lock.owns_lock() || workers_.empty()) {
+    func(0, channels);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    func_ = &func;
+    channels_ = channels;
+    pending_ = workers_.size();
+    generation_++;
+  }
+  work_cv_.notify_all();
+  const auto [begin, end] = GetRange(channels, 0, GetThreads());
+  if (begin < end) func(begin, end);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return pending_ == 0; });
+  func_ = nullptr;
+}
+
+void OutputChannelPool::Worker(size_t id) {
+  size_t seen_generation = 0;
+  while (true) {
+    const Func* func;
+    size_t channels;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [&]() {
+        return stop_ || generation_ != seen_generation;
+      });
+      if (stop_) return;
+      seen_generation = generation_;
+      func = func_;
+      channels = channels_;
+    }
+    const auto [begin, end] = GetRange(channels, id, GetThreads());
+    if (begin < end) (*func)(begin, end);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pending_ == 0) done_cv_.notify_one();
+    }
+  }
+}
+
+}  // namespace lczero
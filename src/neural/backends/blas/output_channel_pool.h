@@ -0,0 +1,78 @@
+/*
+ This file is part of Leela Chess Zero.
+ Copyright (C) 2026 The LCZero Authors
+
+ Leela Chess is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Leela Chess is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lczero {
+
+// Worker threads that split the output channels of a layer between them.
+// Large batches keep a single core busy with one GEMM, but for batches of a
+// few positions a layer is too small for that, so latency mode divides every
+// layer across several cores instead.
+class OutputChannelPool {
+ public:
+  using Func = std::function<void(size_t begin, size_t end)>;
+
+  // Ranges are a multiple of this, so that every thread writes whole cache
+  // lines and GEMM kernels get reasonably sized blocks.
+  static constexpr size_t kChannelGranularity = 16;
+
+  explicit OutputChannelPool(int threads);
+  ~OutputChannelPool();
+
+  int GetThreads() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // Calls @func on contiguous ranges covering [0, channels), one range per
+  // thread, and returns when all of them are done. If the pool is already used
+  // by another computation, everything runs on the calling thread.
+  void Run(size_t channels, const Func& func);
+
+ private:
+  void Worker(size_t id);
+
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  const Func* func_ = nullptr;
+  size_t channels_ = 0;
+  size_t generation_ = 0;
+  size_t pending_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+// Splits @channels over @pool, or calls @func once for all channels when there
+// is no pool or too few channels to split.
+inline void SplitOutputChannels(OutputChannelPool* pool, size_t channels,
+                                const OutputChannelPool::Func& func) {
+  if (pool == nullptr || channels <= OutputChannelPool::kChannelGranularity) {
+    func(0, channels);
+  } else {
+    pool->Run(channels, func);
+  }
+}
+
+}  // namespace lczero
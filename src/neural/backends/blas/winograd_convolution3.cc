@@ -18,6 +18,7 @@
 
 #include "neural/backends/blas/winograd_convolution3.h"
 #include "neural/backends/blas/blas.h"
+#include "utils/cpu_features.h"
 
 #include <algorithm>
 #include <cassert>
@@ -38,6 +39,14 @@ using EigenMatrixMap =
 template <typename T>
 using ConstEigenMatrixMap =
     Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
+template <typename T>
+using EigenStridedMatrixMap =
+    Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>, 0,
+               Eigen::OuterStride<>>;
+template <typename T>
+using ConstEigenStridedMatrixMap =
+    Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>, 0,
+               Eigen::OuterStride<>>;
 
 template <bool use_eigen>
 WinogradConvolution3<use_eigen>::WinogradConvolution3(
@@ -52,13 +61,15 @@ void WinogradConvolution3<use_eigen>::Forward(const size_t batch_size,
                                               const size_t output_channels,
                                               const float* input,
                                               const float* weights,
-                                              float* output) {
+                                              float* output,
+                                              OutputChannelPool* pool) {
   TransformIn(batch_size, input, input_channels);
-  Sgemm(batch_size, weights, input_channels, output_channels);
+  Sgemm(batch_size, weights, input_channels, output_channels, pool);
   TransformOut(batch_size, output, output_channels);
 }
 
 template <bool use_eigen>
+LCZERO_CPU_DISPATCH
 void WinogradConvolution3<use_eigen>::TransformIn(const size_t batch_size,
                                                   const float* input,
                                                   const size_t channels) {
@@ -165,77 +176,80 @@ template <>
 void WinogradConvolution3<false>::Sgemm(const size_t batch_size,
                                         const float* weights,
                                         const size_t input_channels,
-                                        const size_t output_channels) {
+                                        const size_t output_channels,
+                                        OutputChannelPool* pool) {
+  SplitOutputChannels(pool, output_channels, [&](size_t begin, size_t end) {
 #ifdef USE_MKL
 
-  /*
-   void cblas_sgemm_batch (const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE*
-   transa_array, const CBLAS_TRANSPOSE* transb_array, const MKL_INT* m_array,
-   const MKL_INT* n_array, const MKL_INT* k_array, const float* alpha_array,
-   const float **a_array, const MKL_INT* lda_array, const float **b_array, const
-   MKL_INT* ldb_array, const float* beta_array, float **c_array, const MKL_INT*
-   ldc_array, const MKL_INT group_count, const MKL_INT* group_size);
-   */
-
-  CBLAS_TRANSPOSE transA = CblasNoTrans;
-  CBLAS_TRANSPOSE transB = CblasNoTrans;
-  MKL_INT m_array = output_channels;
-  MKL_INT n_array = batch_size * kTiles;
-  MKL_INT k_array = input_channels;
-  float alpha_array = 1.0;
-  const float* a_array[kWinogradTile];
-  MKL_INT lda_array = output_channels;
-  const float* b_array[kWinogradTile];
-  MKL_INT ldb_array = input_channels;
-  float* c_array[kWinogradTile];
-  MKL_INT ldc_array = output_channels;
-  float beta_array = 0.0;
-  MKL_INT groupSize = kWinogradTile;
-
-  for (auto b = 0; b < kWinogradTile; b++) {
-    auto offset_u = b * output_channels * input_channels;
-    auto offset_v = b * batch_size * input_channels * kTiles;
-    auto offset_m = b * batch_size * output_channels * kTiles;
-
-    a_array[b] = &weights[offset_u];
-    b_array[b] = &V_[offset_v];
-    c_array[b] = &M_[offset_m];
-  }
+    /*
+     void cblas_sgemm_batch (const CBLAS_LAYOUT Layout, const CBLAS_TRANSPOSE*
+     transa_array, const CBLAS_TRANSPOSE* transb_array, const MKL_INT* m_array,
+     const MKL_INT* n_array, const MKL_INT* k_array, const float* alpha_array,
+     const float **a_array, const MKL_INT* lda_array, const float **b_array,
+     const MKL_INT* ldb_array, const float* beta_array, float **c_array, const
+     MKL_INT* ldc_array, const MKL_INT group_count, const MKL_INT* group_size);
+     */
+
+    CBLAS_TRANSPOSE transA = CblasNoTrans;
+    CBLAS_TRANSPOSE transB = CblasNoTrans;
+    MKL_INT m_array = end - begin;
+    MKL_INT n_array = batch_size * kTiles;
+    MKL_INT k_array = input_channels;
+    float alpha_array = 1.0;
+    const float* a_array[kWinogradTile];
+    MKL_INT lda_array = output_channels;
+    const float* b_array[kWinogradTile];
+    MKL_INT ldb_array = input_channels;
+    float* c_array[kWinogradTile];
+    MKL_INT ldc_array = output_channels;
+    float beta_array = 0.0;
+    MKL_INT groupSize = kWinogradTile;
+
+    for (auto b = 0; b < kWinogradTile; b++) {
+      auto offset_u = b * output_channels * input_channels;
+      auto offset_v = b * batch_size * input_channels * kTiles;
+      auto offset_m = b * batch_size * output_channels * kTiles;
+
+      a_array[b] = &weights[offset_u + begin];
+      b_array[b] = &V_[offset_v];
+      c_array[b] = &M_[offset_m + begin];
+    }
 
-  cblas_sgemm_batch(CblasColMajor, &transA, &transB, &m_array, &n_array,
-                    &k_array, &alpha_array, a_array, &lda_array, b_array,
-                    &ldb_array, &beta_array, c_array, &ldc_array, 1,
-                    &groupSize);
+    cblas_sgemm_batch(CblasColMajor, &transA, &transB, &m_array, &n_array,
+                      &k_array, &alpha_array, a_array, &lda_array, b_array,
+                      &ldb_array, &beta_array, c_array, &ldc_array, 1,
+                      &groupSize);
 
 #else
 
-  for (size_t b = 0; b < kWinogradTile; b++) {
-    auto offset_u = b * output_channels * input_channels;
-
-    // In col major
-    //
-    //            M               =         weights(T)        x          V
-    //
-    // cols      tiles                  input_channels              tiles
-    // rows   output_channels          output_channels            input_channels
-
-    auto offset_v = b * batch_size * input_channels * kTiles;
-    auto offset_m = b * batch_size * output_channels * kTiles;
-    cblas_sgemm(CblasColMajor,               // Row major format
-                CblasNoTrans,                // A no trans
-                CblasNoTrans,                // B no trans
-                (int)output_channels,        // rows W, M
-                (int)(batch_size * kTiles),  // cols V, M
-                (int)input_channels,         // cols W, rows V
-                1.0f,                        // alpha
-                &weights[offset_u],          // W
-                (int)output_channels,        // ldW
-                &V_[offset_v],               // V
-                (int)input_channels, 0.0f,   // ldV
-                &M_[offset_m],               // M
-                (int)output_channels);       // ldM
-  }
+    for (size_t b = 0; b < kWinogradTile; b++) {
+      auto offset_u = b * output_channels * input_channels;
+
+      // In col major
+      //
+      //            M               =         weights(T)        x          V
+      //
+      // cols      tiles                  input_channels              tiles
+      // rows   output_channels          output_channels        input_channels
+
+      auto offset_v = b * batch_size * input_channels * kTiles;
+      auto offset_m = b * batch_size * output_channels * kTiles;
+      cblas_sgemm(CblasColMajor,               // Row major format
+                  CblasNoTrans,                // A no trans
+                  CblasNoTrans,                // B no trans
+                  (int)(end - begin),          // rows W, M
+                  (int)(batch_size * kTiles),  // cols V, M
+                  (int)input_channels,         // cols W, rows V
+                  1.0f,                        // alpha
+                  &weights[offset_u + begin],  // W
+                  (int)output_channels,        // ldW
+                  &V_[offset_v],               // V
+                  (int)input_channels, 0.0f,   // ldV
+                  &M_[offset_m + begin],       // M
+                  (int)output_channels);       // ldM
+    }
 #endif
+  });
 }
 #endif
 
@@ -243,21 +257,28 @@ template <>
 void WinogradConvolution3<true>::Sgemm(const size_t batch_size,
                                        const float* weights,
                                        const size_t input_channels,
-                                       const size_t output_channels) {
-  for (size_t b = 0; b < kWinogradTile; b++) {
-    auto offset_u = b * output_channels * input_channels;
-    auto offset_v = b * batch_size * input_channels * kTiles;
-    auto offset_m = b * batch_size * output_channels * kTiles;
-    auto C_mat = EigenMatrixMap<float>(&M_[offset_m], output_channels,
-                                       batch_size * kTiles);
-    C_mat.noalias() = ConstEigenMatrixMap<float>(
-                          &weights[offset_u], output_channels, input_channels) *
-                      ConstEigenMatrixMap<float>(&V_[offset_v], input_channels,
-                                                 batch_size * kTiles);
-  }
+                                       const size_t output_channels,
+                                       OutputChannelPool* pool) {
+  SplitOutputChannels(pool, output_channels, [&](size_t begin, size_t end) {
+    for (size_t b = 0; b < kWinogradTile; b++) {
+      auto offset_u = b * output_channels * input_channels;
+      auto offset_v = b * batch_size * input_channels * kTiles;
+      auto offset_m = b * batch_size * output_channels * kTiles;
+      auto C_mat = EigenStridedMatrixMap<float>(
+          &M_[offset_m + begin], end - begin, batch_size * kTiles,
+          Eigen::OuterStride<>(output_channels));
+      C_mat.noalias() =
+          ConstEigenStridedMatrixMap<float>(
+              &weights[offset_u + begin], end - begin, input_channels,
+              Eigen::OuterStride<>(output_channels)) *
+          ConstEigenMatrixMap<float>(&V_[offset_v], input_channels,
+                                     batch_size * kTiles);
+    }
+  });
 }
 
 template <bool use_eigen>
+LCZERO_CPU_DISPATCH
 void WinogradConvolution3<use_eigen>::TransformOut(const size_t batch_size,
                                                    float* output,
                                                    const size_t channels) {
@@ -21,6 +21,8 @@
 #include <cstddef>
 #include <vector>
 
+#include "neural/backends/blas/output_channel_pool.h"
+
 namespace lczero {
 
 // Convolution 3x3 on a 8x8 board using the Winograd algorithm.
@@ -44,17 +46,20 @@ class WinogradConvolution3 {
                        const size_t max_input_layers,
                        const size_t max_output_layers);
 
-  // Forward inference, batched.
+  // Forward inference, batched. With a @pool the matrix multiplications are
+  // split over output channels between its threads.
   void Forward(const size_t batch_size, const size_t input_channels,
                const size_t output_channels, const float* input,
-               const float* weights, float* output);
+               const float* weights, float* output,
+               OutputChannelPool* pool = nullptr);
 
  private:
   void TransformIn(const size_t batch_size, const float* input,
                    const size_t channels);
 
   void Sgemm(const size_t batch_size, const float* weights,
-             const size_t input_channels, const size_t output_channels);
+             const size_t input_channels, const size_t output_channels,
+             OutputChannelPool* pool);
 
   void TransformOut(const size_t batch_size, float* output,
                     const size_t channels);
@@ -0,0 +1,108 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "neural/backends/child_backends.h"
+
+#include "neural/shared_params.h"
+#include "utils/exception.h"
+#include "utils/string.h"
+
+namespace lczero {
+
+std::vector<std::string> SplitTopLevel(const std::string& str) {
+  std::vector<std::string> result(1);
+  int depth = 0;
+  bool quoted = false;
+  for (const char c : str) {
+    if (c == '"') quoted = !quoted;
+    if (!quoted && c == '(') depth++;
+    if (!quoted && c == ')') depth--;
+    if (!quoted && depth == 0 && c == ',') {
+      result.emplace_back();
+    } else {
+      result.back() += c;
+    }
+  }
+  return result;
+}
+
+std::vector<ChildSpec> ParseChildren(const std::string& backend_opts,
+                                     const std::string& wrapper,
+                                     std::string* wrapper_opts) {
+  std::vector<ChildSpec> children;
+  if (wrapper_opts) wrapper_opts->clear();
+  for (auto item : SplitTopLevel(backend_opts)) {
+    item = Trim(item);
+    if (item.empty()) continue;
+    const auto paren = item.find('(');
+    if (paren == std::string::npos) {
+      // Either an option of this backend, or a child without options.
+      if (item.find('=') == std::string::npos) {
+        children.push_back({item, item, ""});
+      } else if (wrapper_opts) {
+        if (!wrapper_opts->empty()) *wrapper_opts += ',';
+        *wrapper_opts += item;
+      }
+      continue;
+    }
+    if (item.back() != ')') {
+      throw Exception("Cannot parse " + wrapper +
+                      " backend options: " + item);
+    }
+    ChildSpec child;
+    child.name = Trim(item.substr(0, paren));
+    child.backend = child.name;
+    for (auto option :
+         SplitTopLevel(item.substr(paren + 1, item.size() - paren - 2))) {
+      option = Trim(option);
+      const auto eq = option.find('=');
+      if (eq != std::string::npos && Trim(option.substr(0, eq)) == "backend") {
+        child.backend = Trim(option.substr(eq + 1));
+        continue;
+      }
+      if (!child.backend_opts.empty()) child.backend_opts += ',';
+      child.backend_opts += option;
+    }
+    children.push_back(child);
+  }
+  return children;
+}
+
+float GetNumber(const OptionsDict& options, const std::string& key,
+                float default_value) {
+  if (options.Exists<int>(key)) return options.Get<int>(key);
+  return options.GetOrDefault<float>(key, default_value);
+}
+
+void SetChildOptions(const ChildSpec& child, OptionsDict* child_options) {
+  child_options->Set<std::string>(SharedBackendParams::kBackendId,
+                                  child.backend);
+  child_options->Set<std::string>(SharedBackendParams::kBackendOptionsId,
+                                  child.backend_opts);
+}
+
+}  // namespace lczero
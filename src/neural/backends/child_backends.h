@@ -0,0 +1,67 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "utils/optionsdict.h"
+
+namespace lczero {
+
+// Child backend of a wrapper backend (balance, shadow), as given in the
+// wrapper's backend options.
+struct ChildSpec {
+  std::string name;
+  std::string backend;
+  std::string backend_opts;
+};
+
+// Splits @str at the commas that are not inside parentheses or quotes.
+std::vector<std::string> SplitTopLevel(const std::string& str);
+
+// Parses "name(backend=eigen,threads=2),onednn" into one spec per child, with
+// the options in parentheses passed on as the child's backend options. Items
+// without parentheses which look like "key=value" are options of the wrapper
+// itself; they are joined into @wrapper_opts if it's given, to be parsed with
+// OptionsDict::AddSubdictFromString(). @wrapper is only used in error messages.
+std::vector<ChildSpec> ParseChildren(const std::string& backend_opts,
+                                     const std::string& wrapper,
+                                     std::string* wrapper_opts = nullptr);
+
+// Returns the number @key in wrapper or child options, @default_value if not
+// set. Backend options are parsed by type, so "fixed_ms=3" is an integer while
+// "fixed_ms=2.5" is a float. Accept both.
+float GetNumber(const OptionsDict& options, const std::string& key,
+                float default_value);
+
+// Sets the backend and backend options of @child in @child_options, which
+// should have the options of the wrapper backend as parent.
+void SetChildOptions(const ChildSpec& child, OptionsDict* child_options);
+
+}  // namespace lczero
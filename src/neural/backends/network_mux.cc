@@ -25,18 +25,20 @@
   Program grant you additional permission to convey the resulting work.
 */
 
-#include <condition_variable>
-#include <queue>
+#include <atomic>
+#include <mutex>
 #include <thread>
 
 #include "neural/factory.h"
 #include "utils/exception.h"
+#include "utils/mpsc_queue.h"
+#include "utils/spinhelper.h"
 
 namespace lczero {
 namespace {
 
 class MuxingNetwork;
-class MuxingComputation : public NetworkComputation {
+class MuxingComputation : public NetworkComputation, public MpscNode {
  public:
   MuxingComputation(MuxingNetwork* network) : network_(network) {}
 
@@ -69,10 +71,23 @@ class MuxingComputation : public NetworkComputation {
     for (auto& x : planes_) parent_->AddInput(std::move(x));
   }
 
-  void NotifyReady() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    dataready_ = true;
-    dataready_cv_.notify_one();
+  // Wakes up only the thread waiting for this computation. The waiter doesn't
+  // return (and destroy the computation) before the final kReleased store, so
+  // the notification never touches a destroyed computation.
+  void MarkReady() {
+    state_.store(kReady, std::memory_order_release);
+    state_.notify_one();
+    state_.store(kReleased, std::memory_order_release);
+  }
+
+  void WaitForResult(AdaptiveSpinParkWaiter* waiter) {
+    waiter->Wait(state_, [this]() {
+      return state_.load(std::memory_order_acquire) != kPending;
+    });
+    // The worker is at most a notify_one() call away from releasing it.
+    while (state_.load(std::memory_order_acquire) != kReleased) {
+      SpinloopPause();
+    }
   }
 
  private:
@@ -81,9 +96,8 @@ class MuxingComputation : public NetworkComputation {
   std::shared_ptr<NetworkComputation> parent_;
   int idx_in_parent_ = 0;
 
-  std::mutex mutex_;
-  std::condition_variable dataready_cv_;
-  bool dataready_ = false;
+  enum State : int { kPending, kReady, kReleased };
+  std::atomic<int> state_ = kPending;
 };
 
 class MuxingNetwork : public Network {
@@ -151,18 +165,24 @@ class MuxingNetwork : public Network {
   bool IsCpu() const override { return is_cpu_; }
 
   void Enqueue(MuxingComputation* computation) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(computation);
-    cv_.notify_one();
+    queue_.Push(computation);
+    // Only a worker which has seen an empty queue may be parked.
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      pending_.notify_one();
+    }
+  }
+
+  void WaitForResult(MuxingComputation* computation) {
+    computation->WaitForResult(&completion_waiter_);
   }
 
   ~MuxingNetwork() {
     Abort();
     Wait();
     // Unstuck waiting computations.
-    while (!queue_.empty()) {
-      queue_.front()->NotifyReady();
-      queue_.pop();
+    if (carry_) carry_->MarkReady();
+    while (MuxingComputation* computation = queue_.Pop()) {
+      computation->MarkReady();
     }
   }
 
@@ -174,42 +194,51 @@ class MuxingNetwork : public Network {
       // there.
       std::shared_ptr<NetworkComputation> parent(network->NewComputation());
       {
-        std::unique_lock<std::mutex> lock(mutex_);
+        // Only one worker at a time consumes from the queue, others wait here.
+        std::lock_guard<std::mutex> lock(consumer_mutex_);
         // Wait until there's come work to compute.
-        cv_.wait(lock, [&] { return abort_ || !queue_.empty(); });
-        if (abort_) break;
+        request_waiter_.Wait(pending_, [&] {
+          return abort_.load(std::memory_order_acquire) ||
+                 pending_.load(std::memory_order_acquire) != 0;
+        });
+        if (abort_.load(std::memory_order_acquire)) break;
 
         // While there is a work in queue, add it.
-        while (!queue_.empty()) {
-          // If we are reaching batch size limit, stop adding.
+        // pending_ has to be checked first, as Abort() bumps it after setting
+        // abort_ and there is no computation behind that increment.
+        while (pending_.load(std::memory_order_acquire) != 0 &&
+               !abort_.load(std::memory_order_acquire)) {
+          MuxingComputation* next = carry_ ? carry_ : queue_.PopWait();
+          // If we are reaching batch size limit, stop adding, and keep the
+          // computation for the next batch.
           // However, if a single input batch is larger than output batch limit,
           // we still have to add it.
           if (parent->GetBatchSize() != 0 &&
-              parent->GetBatchSize() + queue_.front()->GetBatchSize() >
-                  max_batch) {
+              parent->GetBatchSize() + next->GetBatchSize() > max_batch) {
+            carry_ = next;
             break;
           }
+          carry_ = nullptr;
+          pending_.fetch_sub(1, std::memory_order_acq_rel);
           // Remember which of "input" computations we serve.
-          children.push_back(queue_.front());
-          queue_.pop();
+          children.push_back(next);
           // Make "input" computation populate data into output batch.
-          children.back()->PopulateToParent(parent);
+          next->PopulateToParent(parent);
         }
       }
 
       // Compute.
       parent->ComputeBlocking();
       // Notify children that data is ready!
-      for (auto child : children) child->NotifyReady();
+      for (auto child : children) child->MarkReady();
     }
   }
 
   void Abort() {
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      abort_ = true;
-    }
-    cv_.notify_all();
+    abort_.store(true, std::memory_order_release);
+    // Bump the counter so that a parked worker wakes up and sees abort_.
+    pending_.fetch_add(1, std::memory_order_acq_rel);
+    pending_.notify_all();
   }
 
   void Wait() {
@@ -221,22 +250,32 @@ class MuxingNetwork : public Network {
 
  private:
   std::vector<std::unique_ptr<Network>> networks_;
-  std::queue<MuxingComputation*> queue_;
-  bool abort_ = false;
   NetworkCapabilities capabilities_;
   int min_batch_size_ = std::numeric_limits<int>::max();
   bool is_cpu_ = true;
 
-  std::mutex mutex_;
-  std::condition_variable cv_;
+  // Request path: queue of computations, with the number of computations not
+  // yet taken by a worker (including carry_). Only enqueueing is lock-free,
+  // the workers take turns consuming under consumer_mutex_, as a batch is
+  // gathered by one worker at a time anyway.
+  MpscQueue<MuxingComputation> queue_;
+  std::atomic<int> pending_ = 0;
+  std::atomic<bool> abort_ = false;
+  // Popped from the queue but didn't fit into the previous batch.
+  MuxingComputation* carry_ = nullptr;
+  std::mutex consumer_mutex_;
+  AdaptiveSpinParkWaiter request_waiter_;
+
+  // Completion path: every computation parks on its own state word, this only
+  // keeps the spin budget shared.
+  AdaptiveSpinParkWaiter completion_waiter_;
 
   std::vector<std::thread> threads_;
 };
 
 void MuxingComputation::ComputeBlocking() {
   network_->Enqueue(this);
-  std::unique_lock<std::mutex> lock(mutex_);
-  dataready_cv_.wait(lock, [this]() { return dataready_; });
+  network_->WaitForResult(this);
 }
 
 std::unique_ptr<Network> MakeMuxingNetwork(
@@ -30,6 +30,8 @@
 #include <fstream>
 #include <iterator>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -50,6 +52,7 @@
 #include "utils/exception.h"
 #include "utils/fp16_utils.h"
 #include "utils/logging.h"
+#include "utils/string.h"
 
 namespace lczero {
 namespace {
@@ -58,10 +61,26 @@ enum class OnnxProvider { CPU, CUDA, DML, ROCM, TRT };
 
 class OnnxNetwork;
 
+struct OnnxBuffersBase {
+  virtual ~OnnxBuffersBase() = default;
+};
+
+// Input and output buffers of a computation. They are kept by the network and
+// reused, together with their bindings, so that nothing is allocated per batch.
+template <typename DataType>
+struct OnnxBuffers : public OnnxBuffersBase {
+  std::vector<DataType> input;
+  std::vector<std::vector<DataType>> outputs;
+  // One per fixed batch size session, with the input and outputs bound to the
+  // start of the buffers.
+  std::vector<Ort::IoBinding> bindings;
+};
+
 template <typename DataType>
 class OnnxComputation : public NetworkComputation {
  public:
   OnnxComputation(OnnxNetwork* network);
+  ~OnnxComputation() override;
   void AddInput(InputPlanes&& input) override;
   int GetBatchSize() const override { return raw_input_.size(); }
   void ComputeBlocking() override;
@@ -71,14 +90,11 @@ class OnnxComputation : public NetworkComputation {
   float GetMVal(int sample) const override;
 
  private:
-  Ort::Value PrepareInputs(int start, int batch_size);
+  void PrepareInputs(int start, int batch_size);
 
   OnnxNetwork* network_;
   std::vector<InputPlanes> raw_input_;
-  std::vector<DataType> input_tensor_data_;
-  std::vector<Ort::Value> output_tensors_;
-  std::vector<std::vector<DataType>> output_tensors_data_;
-  std::vector<size_t> output_tensors_step_;
+  std::unique_ptr<OnnxBuffers<DataType>> buffers_;
 };
 
 class OnnxNetwork : public Network {
@@ -98,17 +114,37 @@ class OnnxNetwork : public Network {
     return capabilities_;
   }
   int GetMiniBatchSize() const override {
-    return batch_size_ == -1 ? Network::GetMiniBatchSize()
-                             : batch_size_ * steps_;
+    return batch_sizes_.empty() ? Network::GetMiniBatchSize()
+                                : batch_sizes_.back();
   }
   bool IsCpu() const override { return provider_ == OnnxProvider::CPU; }
 
   Ort::SessionOptions GetOptions(int gpu, int threads, int batch_size);
 
+  // Index of the session to use for the next @batch_size samples: the
+  // smallest fixed batch size that fits them all, or else the largest.
+  size_t GetSessionIndex(int batch_size) const;
+
+  template <typename DataType>
+  std::unique_ptr<OnnxBuffers<DataType>> GetBuffers();
+  void ReleaseBuffers(std::unique_ptr<OnnxBuffersBase> buffers);
+
+  // Binds @batch_size samples of @buffers starting at @start.
+  template <typename DataType>
+  void BindBuffers(Ort::IoBinding* binding, OnnxBuffers<DataType>* buffers,
+                   int start, int batch_size) const;
+
   Ort::Env onnx_env_;
   // Prepare sessions for this many multiples of the batch size;
   int steps_;
+  // Lets the sessions share the prepacked weights of the CPU kernels, so must
+  // outlive them.
+  Ort::PrepackedWeightsContainer prepacked_weights_;
   std::vector<Ort::Session> session_;
+  // Batch size of every session in session_, in increasing order. Empty if
+  // there is a single session with variable batch size.
+  std::vector<int> batch_sizes_;
+  Ort::RunOptions run_options_;
   std::vector<std::string> inputs_;
   // Points to strings in inputs_.
   std::vector<const char*> inputs_cstr_;
@@ -120,6 +156,8 @@ class OnnxNetwork : public Network {
   int wdl_head_ = -1;
   int value_head_ = -1;
   int mlh_head_ = -1;
+  // Number of values per sample of every output.
+  std::vector<size_t> output_steps_;
   NetworkCapabilities capabilities_;
   bool fp16_;
   bool bf16_;
@@ -131,31 +169,80 @@ class OnnxNetwork : public Network {
   // For conditional locking if running the DML/ROCM/TRT provider.
   OnnxProvider provider_;
   std::mutex lock_;
+  std::mutex buffers_lock_;
+  std::vector<std::unique_ptr<OnnxBuffersBase>> free_buffers_;
 };
 
+size_t OnnxNetwork::GetSessionIndex(int batch_size) const {
+  for (size_t i = 0; i < batch_sizes_.size(); i++) {
+    if (batch_sizes_[i] >= batch_size) return i;
+  }
+  return batch_sizes_.empty() ? 0 : batch_sizes_.size() - 1;
+}
+
 template <typename DataType>
-OnnxComputation<DataType>::OnnxComputation(OnnxNetwork* network)
-    : network_(network) {
-  output_tensors_data_.resize(network_->outputs_.size());
-  output_tensors_step_.resize(network_->outputs_.size());
-  output_tensors_step_[network_->policy_head_] = 1858;
-  output_tensors_data_[network_->policy_head_] =
-      std::vector<DataType>(1858 * network_->max_batch_size_);
-  if (network_->wdl_head_ != -1) {
-    output_tensors_step_[network_->wdl_head_] = 3;
-    output_tensors_data_[network_->wdl_head_] =
-        std::vector<DataType>(3 * network_->max_batch_size_);
+void OnnxNetwork::BindBuffers(Ort::IoBinding* binding,
+                              OnnxBuffers<DataType>* buffers, int start,
+                              int batch_size) const {
+  auto memory_info =
+      Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+  int64_t input_dims[] = {batch_size, kInputPlanes, 8, 8};
+  binding->BindInput(inputs_cstr_[0],
+                     Ort::Value::CreateTensor<DataType>(
+                         memory_info, buffers->input.data(),
+                         batch_size * kInputPlanes * 8 * 8, input_dims, 4));
+  for (size_t i = 0; i < output_steps_.size(); i++) {
+    int64_t size = output_steps_[i];
+    int64_t dims[] = {batch_size, size};
+    binding->BindOutput(
+        outputs_cstr_[i],
+        Ort::Value::CreateTensor<DataType>(
+            memory_info, buffers->outputs[i].data() + start * size,
+            size * batch_size, dims, 2));
   }
-  if (network_->value_head_ != -1) {
-    output_tensors_step_[network_->value_head_] = 1;
-    output_tensors_data_[network_->value_head_] =
-        std::vector<DataType>(network_->max_batch_size_);
+}
+
+template <typename DataType>
+std::unique_ptr<OnnxBuffers<DataType>> OnnxNetwork::GetBuffers() {
+  {
+    std::lock_guard<std::mutex> lock(buffers_lock_);
+    if (!free_buffers_.empty()) {
+      auto buffers = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+      return std::unique_ptr<OnnxBuffers<DataType>>(
+          static_cast<OnnxBuffers<DataType>*>(buffers.release()));
+    }
   }
-  if (network_->mlh_head_ != -1) {
-    output_tensors_step_[network_->mlh_head_] = 1;
-    output_tensors_data_[network_->mlh_head_] =
-        std::vector<DataType>(network_->max_batch_size_);
+  auto buffers = std::make_unique<OnnxBuffers<DataType>>();
+  const int input_batch_size =
+      batch_sizes_.empty() ? max_batch_size_ : batch_sizes_.back();
+  buffers->input.resize(input_batch_size * kInputPlanes * 8 * 8);
+  // The last chunk of a large batch may be padded up to a full session.
+  const int output_batch_size =
+      batch_sizes_.empty() ? max_batch_size_
+                           : max_batch_size_ + batch_sizes_.back();
+  for (const auto step : output_steps_) {
+    buffers->outputs.emplace_back(step * output_batch_size);
   }
+  for (size_t i = 0; i < batch_sizes_.size(); i++) {
+    buffers->bindings.emplace_back(session_[i]);
+    BindBuffers(&buffers->bindings.back(), buffers.get(), 0, batch_sizes_[i]);
+  }
+  return buffers;
+}
+
+void OnnxNetwork::ReleaseBuffers(std::unique_ptr<OnnxBuffersBase> buffers) {
+  std::lock_guard<std::mutex> lock(buffers_lock_);
+  free_buffers_.push_back(std::move(buffers));
+}
+
+template <typename DataType>
+OnnxComputation<DataType>::OnnxComputation(OnnxNetwork* network)
+    : network_(network), buffers_(network_->GetBuffers<DataType>()) {}
+
+template <typename DataType>
+OnnxComputation<DataType>::~OnnxComputation() {
+  network_->ReleaseBuffers(std::move(buffers_));
 }
 
 template <typename DataType>
@@ -182,10 +269,10 @@ float AsFloat(Ort::BFloat16_t x) {
 template <typename DataType>
 float OnnxComputation<DataType>::GetQVal(int sample) const {
   if (network_->wdl_head_ != -1) {
-    const auto& data = output_tensors_data_[network_->wdl_head_];
+    const auto& data = buffers_->outputs[network_->wdl_head_];
     return AsFloat(data[sample * 3 + 0]) - AsFloat(data[sample * 3 + 2]);
   } else {
-    const auto& data = output_tensors_data_[network_->value_head_];
+    const auto& data = buffers_->outputs[network_->value_head_];
     return AsFloat(data[sample]);
   }
 }
@@ -193,20 +280,20 @@ float OnnxComputation<DataType>::GetQVal(int sample) const {
 template <typename DataType>
 float OnnxComputation<DataType>::GetDVal(int sample) const {
   if (network_->wdl_head_ == -1) return 0.0f;
-  const auto& data = output_tensors_data_[network_->wdl_head_];
+  const auto& data = buffers_->outputs[network_->wdl_head_];
   return AsFloat(data[sample * 3 + 1]);
 }
 
 template <typename DataType>
 float OnnxComputation<DataType>::GetPVal(int sample, int move_id) const {
-  const auto& data = output_tensors_data_[network_->policy_head_];
+  const auto& data = buffers_->outputs[network_->policy_head_];
   return AsFloat(data[sample * 1858 + move_id]);
 }
 
 template <typename DataType>
 float OnnxComputation<DataType>::GetMVal(int sample) const {
   if (network_->mlh_head_ == -1) return 0.0f;
-  const auto& data = output_tensors_data_[network_->mlh_head_];
+  const auto& data = buffers_->outputs[network_->mlh_head_];
   return AsFloat(data[sample]);
 }
 
@@ -221,58 +308,42 @@ void AsDataType(float x, Ort::BFloat16_t* y) {
 }
 
 template <typename DataType>
-Ort::Value OnnxComputation<DataType>::PrepareInputs(int start, int batch_size) {
-  input_tensor_data_.clear();
-  input_tensor_data_.resize(batch_size * kInputPlanes * 8 * 8);
-  auto iter = input_tensor_data_.data();
+void OnnxComputation<DataType>::PrepareInputs(int start, int batch_size) {
+  auto iter = buffers_->input.data();
+  const auto batch_end = iter + batch_size * kInputPlanes * 8 * 8;
   int end = std::min(start + batch_size, static_cast<int>(raw_input_.size()));
   for (int i = start; i < end; i++) {
     for (const auto& plane : raw_input_[i]) {
       DataType value;
       AsDataType(plane.value, &value);
+      std::fill(iter, iter + 64, DataType());
       for (auto bit : IterateBits(plane.mask)) {
         *(iter + bit) = value;
       }
       iter += 64;
     }
   }
-  for (int i = end; i < start + batch_size; i++) {
-    for (int j = 0; j < kInputPlanes * 64; j++) {
-      *iter++ = DataType();
-    }
-  }
-
-  auto memory_info =
-      Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-
-  output_tensors_.clear();
-  for (size_t i = 0; i < output_tensors_step_.size(); i++) {
-    int size = output_tensors_step_[i];
-    int64_t dims[] = {batch_size, size};
-    output_tensors_.emplace_back(Ort::Value::CreateTensor<DataType>(
-        memory_info, output_tensors_data_[i].data() + start * size,
-        size * batch_size, dims, 2));
-  }
-
-  int64_t dims[] = {batch_size, kInputPlanes, 8, 8};
-  return Ort::Value::CreateTensor<DataType>(memory_info,
-                                            input_tensor_data_.data(),
-                                            input_tensor_data_.size(), dims, 4);
+  // Only the padding up to the bucket size is left to clear.
+  std::fill(iter, batch_end, DataType());
 }
 
 template <typename DataType>
 void OnnxComputation<DataType>::ComputeBlocking() {
-  int batch_size = network_->batch_size_;
-  if (batch_size < 0) {
-    batch_size = std::max(static_cast<int>(raw_input_.size()),
-                          network_->min_batch_size_);
-  }
   for (size_t i = 0; i < raw_input_.size();) {
-    int step = (raw_input_.size() - i + batch_size - 1) / batch_size;
-    if (step > network_->steps_) step = network_->steps_;
-    int batch = batch_size * step;
-
-    auto input_tensor = PrepareInputs(i, batch);
+    const int remaining = raw_input_.size() - i;
+    const size_t index = network_->GetSessionIndex(remaining);
+    const int batch = network_->batch_sizes_.empty()
+                          ? std::max(remaining, network_->min_batch_size_)
+                          : network_->batch_sizes_[index];
+
+    PrepareInputs(i, batch);
+    // The prepared bindings cover the start of the buffers, the rest of a batch
+    // larger than all the sessions, or a variable batch, is bound here.
+    std::optional<Ort::IoBinding> binding;
+    if (i > 0 || network_->batch_sizes_.empty()) {
+      binding.emplace(network_->session_[index]);
+      network_->BindBuffers(&*binding, buffers_.get(), i, batch);
+    }
     // The DML onnxruntime execution provider is documented as not supporting
     // multi-threaded calls to Run on the same inference session. We found the
     // same to be true for the ROCm execution provider (at least for CNNs).
@@ -282,10 +353,9 @@ void OnnxComputation<DataType>::ComputeBlocking() {
         network_->provider_ == OnnxProvider::TRT) {
       network_->lock_.lock();
     }
-    network_->session_[step - 1].Run(
-        {}, network_->inputs_cstr_.data(), &input_tensor, 1,
-        network_->outputs_cstr_.data(), output_tensors_.data(),
-        output_tensors_.size());
+    network_->session_[index].Run(
+        network_->run_options_,
+        binding ? *binding : buffers_->bindings[index]);
     if (network_->provider_ == OnnxProvider::DML ||
         network_->provider_ == OnnxProvider::ROCM ||
         network_->provider_ == OnnxProvider::TRT) {
@@ -347,6 +417,14 @@ Ort::SessionOptions OnnxNetwork::GetOptions(int gpu, int threads,
             inputs_[0] + ":" + std::to_string(max_batch_size_) + "x112x8x8";
         trt_options["trt_profile_opt_shapes"] =
             inputs_[0] + ":" + std::to_string(max_batch_size_ / 4) + "x112x8x8";
+      } else if (batch_size_ < 0) {
+        // A bucket session.
+        for (const auto* profile : {"trt_profile_min_shapes",
+                                    "trt_profile_max_shapes",
+                                    "trt_profile_opt_shapes"}) {
+          trt_options[profile] =
+              inputs_[0] + ":" + std::to_string(batch_size) + "x112x8x8";
+        }
       } else {
         trt_options["trt_profile_min_shapes"] =
             inputs_[0] + ":" + std::to_string(batch_size_) + "x112x8x8";
@@ -426,6 +504,26 @@ OnnxNetwork::OnnxNetwork(const WeightsFile& file, const OptionsDict& opts,
   if (batch_size_ * steps_ > max_batch_size_) {
     batch_size_ = max_batch_size_ / steps_;
   }
+  if (batch_size_ > 0) {
+    for (int step = 1; step <= steps_; step++) {
+      batch_sizes_.push_back(batch_size_ * step);
+    }
+  } else {
+    // Sessions with fixed batch sizes avoid the shape inference and allocation
+    // overhead of variable ones, which matters most for the CPU.
+    const auto buckets = opts.GetOrDefault<std::string>(
+        "buckets", provider == OnnxProvider::CPU ? "1,8,32,128,256" : "");
+    if (!buckets.empty()) batch_sizes_ = ParseIntList(buckets);
+    for (const auto batch_size : batch_sizes_) {
+      if (batch_size <= 0 || batch_size > max_batch_size_) {
+        throw Exception("Invalid ONNX batch bucket size " +
+                        std::to_string(batch_size) + ".");
+      }
+    }
+    std::sort(batch_sizes_.begin(), batch_sizes_.end());
+    batch_sizes_.erase(std::unique(batch_sizes_.begin(), batch_sizes_.end()),
+                       batch_sizes_.end());
+  }
 
   const auto& md = file.onnx_model();
   if (!md.has_input_planes()) {
@@ -457,10 +555,23 @@ OnnxNetwork::OnnxNetwork(const WeightsFile& file, const OptionsDict& opts,
                  std::back_inserter(outputs_cstr_),
                  [](const auto& x) { return x.c_str(); });
 
-  for (int step = 1; step <= steps_; step++)
+  output_steps_.resize(outputs_.size());
+  output_steps_[policy_head_] = 1858;
+  if (wdl_head_ != -1) output_steps_[wdl_head_] = 3;
+  if (value_head_ != -1) output_steps_[value_head_] = 1;
+  if (mlh_head_ != -1) output_steps_[mlh_head_] = 1;
+
+  if (batch_sizes_.empty()) {
+    session_.emplace_back(onnx_env_, file.onnx_model().model().data(),
+                          file.onnx_model().model().size(),
+                          GetOptions(gpu, threads, -1), prepacked_weights_);
+  }
+  for (const auto batch_size : batch_sizes_) {
     session_.emplace_back(onnx_env_, file.onnx_model().model().data(),
                           file.onnx_model().model().size(),
-                          GetOptions(gpu, threads, batch_size_ * step));
+                          GetOptions(gpu, threads, batch_size),
+                          prepacked_weights_);
+  }
 }
 
 template <OnnxProvider kProvider>
@@ -478,6 +589,7 @@ std::unique_ptr<Network> MakeOnnxNetwork(const std::optional<WeightsFile>& w,
     converter_options.alt_layernorm = opts.GetOrDefault<bool>(
         "alt_layernorm", kProvider == OnnxProvider::DML ? true : false);
     converter_options.no_shape = opts.GetOrDefault<bool>("no_shape", false);
+    converter_options.fused_ops = opts.GetOrDefault<bool>("fused_ops", false);
     converter_options.policy_head =
         opts.GetOrDefault<std::string>("policy_head", "vanilla");
     converter_options.value_head =
@@ -25,19 +25,228 @@
   Program grant you additional permission to convey the resulting work.
 */
 
-#include <iostream>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <thread>
+#include <unordered_map>
 
 #include "neural/factory.h"
+#include "utils/exception.h"
+#include "utils/filesystem.h"
 #include "utils/hashcat.h"
+#include "utils/mutex.h"
 
 namespace lczero {
 namespace {
 
+// Version 1 files are a sequence of records, each one a hash, a count and that
+// many floats. Version 2 files start with a header, followed by the same floats
+// without the hashes and counts, and end with an index of fixed size entries
+// sorted by hash. Replay maps them and searches the index in place.
+constexpr char kRecordMagic[8] = {'L', 'c', '0', 'R', 'e', 'c', 'v', '2'};
+
+struct RecordHeader {
+  char magic[8];
+  // File offset of the index, 0 while the file is being written.
+  uint64_t index_offset;
+  // Number of index entries.
+  uint64_t index_size;
+};
+
+struct RecordIndexEntry {
+  uint64_t hash;
+  // File offset of the recorded floats.
+  uint64_t offset;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(RecordHeader) == 24);
+static_assert(sizeof(RecordIndexEntry) == 24);
+
+bool IsIndexedRecordFile(const MappedFile& file) {
+  return file.size() >= sizeof(RecordHeader) &&
+         std::memcmp(file.data(), kRecordMagic, sizeof(kRecordMagic)) == 0;
+}
+
+// Returns the format of an existing record file, 0 if it is missing or empty.
+int GetRecordFileFormat(const std::string& filename) {
+  if (GetFileSize(filename) == 0) return 0;
+  return IsIndexedRecordFile(MappedFile(filename)) ? 2 : 1;
+}
+
+// Returns the header of a version 2 file, after checking that it is complete.
+RecordHeader ReadRecordHeader(const MappedFile& file,
+                              const std::string& filename) {
+  RecordHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.index_offset == 0) {
+    throw Exception("Record file " + filename +
+                    " is incomplete, the recording was interrupted.");
+  }
+  if (header.index_offset % alignof(RecordIndexEntry) != 0 ||
+      header.index_offset > file.size() ||
+      header.index_size >
+          (file.size() - header.index_offset) / sizeof(RecordIndexEntry)) {
+    throw Exception("Record file " + filename + " is corrupt.");
+  }
+  return header;
+}
+
+std::span<const RecordIndexEntry> GetRecordIndex(const MappedFile& file,
+                                                 const RecordHeader& header) {
+  return {reinterpret_cast<const RecordIndexEntry*>(file.data() +
+                                                    header.index_offset),
+          header.index_size};
+}
+
+struct Record {
+  uint64_t hash;
+  std::vector<float> values;
+};
+
+// Writes the records of all computations from a background thread, through a
+// large buffer. A version 2 file gets its index written when the writer is
+// destroyed, so an interrupted recording is detected on replay.
+class RecordWriter {
+ public:
+  RecordWriter(const std::string& filename, int format);
+  ~RecordWriter();
+
+  void Add(std::vector<Record>&& records);
+
+ private:
+  void Worker();
+  void Write(const Record& record);
+  void WriteIndex();
+
+  const int format_;
+  std::vector<char> buffer_;
+  std::fstream output_;
+  // File offset for the next floats, version 2 only.
+  uint64_t offset_ = 0;
+  std::vector<RecordIndexEntry> index_;
+  Mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Record> pending_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+RecordWriter::RecordWriter(const std::string& filename, int format)
+    : format_(format), buffer_(1 << 20) {
+  output_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+  if (format_ == 1) {
+    output_.open(filename, std::ios::out | std::ios::app | std::ios::binary);
+  } else if (GetFileSize(filename) == 0) {
+    output_.open(filename,
+                 std::ios::out | std::ios::trunc | std::ios::binary);
+    // The header marks the file incomplete until the index is written.
+    RecordHeader header{};
+    std::memcpy(header.magic, kRecordMagic, sizeof(kRecordMagic));
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset_ = sizeof(RecordHeader);
+  } else {
+    // The new floats go after the existing index, and the merged index after
+    // them. The old header and index stay valid until the new header is
+    // written, so an interrupted recording keeps the previous one readable.
+    {
+      MappedFile file(filename);
+      const auto header = ReadRecordHeader(file, filename);
+      const auto index = GetRecordIndex(file, header);
+      index_.assign(index.begin(), index.end());
+      offset_ = file.size();
+    }
+    output_.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+    output_.seekp(offset_);
+  }
+  if (!output_) throw Exception("Cannot open record file " + filename);
+  thread_ = std::thread([this]() { Worker(); });
+}
+
+RecordWriter::~RecordWriter() {
+  {
+    Mutex::Lock lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  if (format_ != 1) WriteIndex();
+  output_.flush();
+}
+
+void RecordWriter::Add(std::vector<Record>&& records) {
+  {
+    Mutex::Lock lock(mutex_);
+    std::move(records.begin(), records.end(), std::back_inserter(pending_));
+  }
+  cv_.notify_one();
+}
+
+void RecordWriter::Worker() {
+  std::vector<Record> records;
+  while (true) {
+    {
+      Mutex::Lock lock(mutex_);
+      cv_.wait(lock.get_raw(), [&]() { return stop_ || !pending_.empty(); });
+      if (pending_.empty()) return;
+      records.swap(pending_);
+    }
+    for (const auto& record : records) Write(record);
+    records.clear();
+  }
+}
+
+void RecordWriter::Write(const Record& record) {
+  const int32_t length = static_cast<int32_t>(record.values.size());
+  if (format_ == 1) {
+    output_.write(reinterpret_cast<const char*>(&record.hash),
+                  sizeof(record.hash));
+    output_.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  } else {
+    index_.push_back({record.hash, offset_, static_cast<uint32_t>(length), 0});
+    offset_ += length * sizeof(float);
+  }
+  output_.write(reinterpret_cast<const char*>(record.values.data()),
+                length * sizeof(float));
+}
+
+void RecordWriter::WriteIndex() {
+  // Only use the first recorded value for any hash collisions.
+  std::stable_sort(
+      index_.begin(), index_.end(),
+      [](const auto& a, const auto& b) { return a.hash < b.hash; });
+  index_.erase(std::unique(index_.begin(), index_.end(),
+                           [](const auto& a, const auto& b) {
+                             return a.hash == b.hash;
+                           }),
+               index_.end());
+  // Align the index so that replay can use it in place.
+  const char padding[alignof(RecordIndexEntry)] = {};
+  const auto padding_size = -offset_ % alignof(RecordIndexEntry);
+  output_.write(padding, padding_size);
+  offset_ += padding_size;
+  output_.write(reinterpret_cast<const char*>(index_.data()),
+                index_.size() * sizeof(RecordIndexEntry));
+  // The index has to reach the file before the header points to it.
+  output_.flush();
+
+  RecordHeader header;
+  std::memcpy(header.magic, kRecordMagic, sizeof(kRecordMagic));
+  header.index_offset = offset_;
+  header.index_size = index_.size();
+  output_.seekp(0);
+  output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
 class RecordComputation : public NetworkComputation {
  public:
   RecordComputation(std::unique_ptr<NetworkComputation>&& inner,
-                    const std::string& record_file)
-      : inner_(std::move(inner)), record_file_(record_file) {}
+                    RecordWriter* writer)
+      : inner_(std::move(inner)), writer_(writer) {}
   static uint64_t make_hash(const InputPlanes& input) {
     std::uint64_t hash = 0x2134435D4534LL;
     for (const auto& plane : input) {
@@ -83,49 +292,134 @@ class RecordComputation : public NetworkComputation {
     return Capture(inner_->GetMVal(sample), sample);
   }
   virtual ~RecordComputation() {
-    Mutex::Lock lock(mutex_);
-    std::fstream output(record_file_, std::ios::app | std::ios_base::binary);
+    if (!writer_) return;
+    std::vector<Record> records;
+    records.reserve(hashes_.size());
     for (size_t i = 0; i < hashes_.size(); i++) {
-      uint64_t value = hashes_[i];
-      output.write(reinterpret_cast<const char*>(&value), sizeof(value));
-      int32_t length = static_cast<int32_t>(requests_[i].size());
-      output.write(reinterpret_cast<const char*>(&length), sizeof(length));
-      for (int j = 0; j < length; j++) {
-        float recorded = requests_[i][j];
-        output.write(reinterpret_cast<const char*>(&recorded),
-                     sizeof(recorded));
-      }
+      records.push_back({hashes_[i], std::move(requests_[i])});
     }
+    writer_->Add(std::move(records));
   }
   std::unique_ptr<NetworkComputation> inner_;
-  std::string record_file_;
+  RecordWriter* writer_;
   std::vector<uint64_t> hashes_;
   mutable std::vector<int> q_count_;
   mutable std::vector<std::vector<float>> requests_;
-  static Mutex mutex_;
 };
 
-Mutex RecordComputation::mutex_;
+class ReplayLookup {
+ public:
+  virtual ~ReplayLookup() = default;
+  // Returns the values recorded for @hash, empty if there are none.
+  virtual std::span<const float> Find(uint64_t hash) const = 0;
+};
+
+// Version 1 files have no index, so they are loaded into a hash map.
+class LoadedReplayLookup : public ReplayLookup {
+ public:
+  LoadedReplayLookup(const std::string& filename) {
+    std::ifstream input(filename, std::ios_base::binary);
+    input.seekg(0, input.end);
+    auto file_length = input.tellg();
+    input.seekg(0, input.beg);
+    while (input.tellg() < file_length) {
+      uint64_t value = 0;
+      input.read(reinterpret_cast<char*>(&value), sizeof(value));
+      int32_t length = 0;
+      input.read(reinterpret_cast<char*>(&length), sizeof(length));
+      auto& entry = lookup_[value];
+      // Only use the first recorded value for any hash collisions.
+      bool fill = entry.size() == 0;
+      for (int j = 0; j < length; j++) {
+        float recorded = 0.0f;
+        input.read(reinterpret_cast<char*>(&recorded), sizeof(recorded));
+        if (fill) {
+          entry.push_back(recorded);
+        }
+      }
+    }
+  }
+
+  std::span<const float> Find(uint64_t hash) const override {
+    const auto entry = lookup_.find(hash);
+    if (entry == lookup_.end()) return {};
+    return entry->second;
+  }
+
+ private:
+  std::unordered_map<uint64_t, std::vector<float>> lookup_;
+};
+
+// Version 2 files are mapped and their index searched in place.
+class MappedReplayLookup : public ReplayLookup {
+ public:
+  MappedReplayLookup(std::unique_ptr<MappedFile> file,
+                     const std::string& filename)
+      : file_(std::move(file)),
+        index_(GetRecordIndex(*file_, ReadRecordHeader(*file_, filename))) {
+    for (const auto& entry : index_) {
+      if (entry.offset + uint64_t{entry.length} * sizeof(float) >
+          file_->size()) {
+        throw Exception("Record file " + filename + " is corrupt.");
+      }
+    }
+  }
+
+  std::span<const float> Find(uint64_t hash) const override {
+    // The hashes are close to uniformly distributed, so interpolation gets
+    // near the entry in a few steps. Binary search finishes the job, and also
+    // bounds the cost if the distribution is skewed.
+    size_t low = 0;
+    size_t high = index_.size();
+    for (int step = 0; step < 4 && high - low > 16; step++) {
+      const uint64_t low_hash = index_[low].hash;
+      const uint64_t high_hash = index_[high - 1].hash;
+      if (hash < low_hash || hash > high_hash) return {};
+      const size_t middle =
+          low + static_cast<size_t>(static_cast<double>(hash - low_hash) /
+                                    static_cast<double>(high_hash - low_hash) *
+                                    (high - 1 - low));
+      if (index_[middle].hash < hash) {
+        low = middle + 1;
+      } else if (index_[middle].hash > hash) {
+        high = middle;
+      } else {
+        return Values(index_[middle]);
+      }
+    }
+    const auto entry = std::lower_bound(
+        index_.begin() + low, index_.begin() + high, hash,
+        [](const auto& entry, uint64_t hash) { return entry.hash < hash; });
+    if (entry == index_.begin() + high || entry->hash != hash) return {};
+    return Values(*entry);
+  }
+
+ private:
+  std::span<const float> Values(const RecordIndexEntry& entry) const {
+    return {reinterpret_cast<const float*>(file_->data() + entry.offset),
+            entry.length};
+  }
+
+  std::unique_ptr<MappedFile> file_;
+  std::span<const RecordIndexEntry> index_;
+};
 
 class ReplayComputation : public NetworkComputation {
  public:
-  ReplayComputation(std::unordered_map<uint64_t, std::vector<float>>* lookup)
-      : lookup_(lookup) {}
+  ReplayComputation(const ReplayLookup* lookup) : lookup_(lookup) {}
   // Adds a sample to the batch.
   void AddInput(InputPlanes&& input) override {
-    hashes_.push_back(RecordComputation::make_hash(input));
+    entries_.push_back(lookup_->Find(RecordComputation::make_hash(input)));
     replay_counter_.push_back(0);
   }
   // Do the computation.
   void ComputeBlocking() override {}
   // Returns how many times AddInput() was called.
-  int GetBatchSize() const override { return static_cast<int>(hashes_.size()); }
+  int GetBatchSize() const override {
+    return static_cast<int>(entries_.size());
+  }
   float Replay(int index) const {
-    const auto& entry_ptr = lookup_->find(hashes_[index]);
-    if (entry_ptr == lookup_->end()) {
-      return 0.0f;
-    }
-    const auto& entry = entry_ptr->second;
+    const auto& entry = entries_[index];
     size_t counter = replay_counter_[index];
     if (counter >= entry.size()) {
       // Second pass reads the same things in the same order as first.
@@ -149,10 +443,9 @@ class ReplayComputation : public NetworkComputation {
   float GetMVal(int sample) const override { return Replay(sample); }
   virtual ~ReplayComputation() {}
 
-  std::unique_ptr<NetworkComputation> inner_;
-  std::vector<uint64_t> hashes_;
+  std::vector<std::span<const float>> entries_;
   mutable std::vector<size_t> replay_counter_;
-  std::unordered_map<uint64_t, std::vector<float>>* lookup_;
+  const ReplayLookup* lookup_;
 };
 
 class RecordReplayNetwork : public Network {
@@ -173,28 +466,29 @@ class RecordReplayNetwork : public Network {
     replay_file_ = options.GetOrDefault<std::string>("replay_file", "");
     record_file_ = options.GetOrDefault<std::string>("record_file", "");
     if (replay_file_.size() > 0) {
-      lookup_ =
-          std::make_unique<std::unordered_map<uint64_t, std::vector<float>>>();
-      std::ifstream input(replay_file_, std::ios_base::binary);
-      input.seekg(0, input.end);
-      auto file_length = input.tellg();
-      input.seekg(0, input.beg);
-      while (input.tellg() < file_length) {
-        uint64_t value = 0;
-        input.read(reinterpret_cast<char*>(&value), sizeof(value));
-        int32_t length = 0;
-        input.read(reinterpret_cast<char*>(&length), sizeof(length));
-        auto& entry = (*lookup_)[value];
-        // Only use the first recorded value for any hash collisions.
-        bool fill = entry.size() == 0;
-        for (int j = 0; j < length; j++) {
-          float recorded = 0.0f;
-          input.read(reinterpret_cast<char*>(&recorded), sizeof(recorded));
-          if (fill) {
-            entry.push_back(recorded);
-          }
-        }
+      auto file = std::make_unique<MappedFile>(replay_file_);
+      if (IsIndexedRecordFile(*file)) {
+        lookup_ =
+            std::make_unique<MappedReplayLookup>(std::move(file), replay_file_);
+      } else {
+        file.reset();
+        lookup_ = std::make_unique<LoadedReplayLookup>(replay_file_);
+      }
+    } else if (record_file_.size() > 0) {
+      // By default, appends in the format of an existing file, and new files
+      // get format 2.
+      int format = options.GetOrDefault<int>("record_format", 0);
+      if (format != 0 && format != 1 && format != 2) {
+        throw Exception("Unsupported record_format " + std::to_string(format));
+      }
+      const int existing_format = GetRecordFileFormat(record_file_);
+      if (format == 0) format = existing_format ? existing_format : 2;
+      if (existing_format && existing_format != format) {
+        throw Exception("Cannot append to record file " + record_file_ +
+                        " of format " + std::to_string(existing_format) +
+                        " with record_format=" + std::to_string(format));
       }
+      writer_ = std::make_unique<RecordWriter>(record_file_, format);
     }
   }
 
@@ -217,7 +511,7 @@ class RecordReplayNetwork : public Network {
     if (!lookup_) {
       const long long val = ++counter_;
       return std::make_unique<RecordComputation>(
-          networks_[val % networks_.size()]->NewComputation(), record_file_);
+          networks_[val % networks_.size()]->NewComputation(), writer_.get());
     }
     return std::make_unique<ReplayComputation>(lookup_.get());
   }
@@ -234,7 +528,8 @@ class RecordReplayNetwork : public Network {
   NetworkCapabilities capabilities_;
   std::string replay_file_;
   std::string record_file_;
-  std::unique_ptr<std::unordered_map<uint64_t, std::vector<float>>> lookup_;
+  std::unique_ptr<ReplayLookup> lookup_;
+  std::unique_ptr<RecordWriter> writer_;
 };
 
 std::unique_ptr<Network> MakeRecordReplayNetwork(
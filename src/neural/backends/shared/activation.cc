@@ -20,11 +20,15 @@
 
 #include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <string>
 
+#include "utils/cpu_features.h"
 #include "utils/exception.h"
 
 #ifdef USE_ISPC
 #include "activation_ispc.h"
+#include "layer_norm_ispc.h"
 #endif
 
 namespace lczero {
@@ -32,8 +36,28 @@ namespace {
 constexpr int kWidth = 8;
 constexpr int kHeight = 8;
 constexpr int kSquares = kWidth * kHeight;
+
+#ifdef USE_ISPC
+std::string IspcTargetName() {
+  static const char* kTargets[] = {"unknown",   "sse2",      "sse4",
+                                   "avx1",      "avx2",      "avx512knl",
+                                   "avx512skx", "avx512spr", "neon"};
+  int target = ispc::GetTarget();
+  if (target < 0 || target >= static_cast<int>(std::size(kTargets))) {
+    target = 0;
+  }
+  return std::string(kTargets[target]) + "-i32x" +
+         std::to_string(ispc::GetTargetWidth());
+}
+
+// The ISPC kernels are all built for the same targets, so dispatch the same.
+RegisterKernelTarget ispc_target(
+    "ISPC kernels (activation, layer norm, softmax, winograd transform)",
+    IspcTargetName);
+#endif
 }  // namespace
 
+LCZERO_CPU_DISPATCH
 void SoftmaxActivation(const size_t size, const float* input, float* output) {
   auto alpha = *std::max_element(input, input + size);
 
@@ -93,6 +117,7 @@ float Activate(const float val, const ActivationFunction activation) {
   return val;
 }
 
+LCZERO_CPU_DISPATCH
 void Activate(const size_t len, const float* data, const float* bias,
               float* output, const ActivationFunction activation) {
   if (activation == ACTIVATION_NONE) {
@@ -153,6 +178,7 @@ void Activate(const size_t len, const float* data, const float* bias,
   }
 }
 
+LCZERO_CPU_DISPATCH
 void Activate(const size_t len, float gamma, const float* data,
               const float* bias, float beta, float* output,
               const ActivationFunction activation) {
@@ -187,6 +213,7 @@ void Activate(const size_t len, float gamma, const float* data,
   }
 }
 
+LCZERO_CPU_DISPATCH
 void BiasResidual(const size_t batch_size, const size_t channels, float* data,
                   const float* biases, const float* eltwise,
                   const ActivationFunction activation) {
@@ -230,6 +257,7 @@ void BiasResidual(const size_t batch_size, const size_t channels, float* data,
   }
 }
 
+LCZERO_CPU_DISPATCH
 void BiasActivate(const size_t batch_size, const size_t channels, float* data,
                   const float* biases, const ActivationFunction activation) {
   for (size_t i = 0; i < batch_size; i++) {
@@ -266,4 +294,70 @@ void BiasActivate(const size_t batch_size, const size_t channels, float* data,
   }
 }
 
+LCZERO_CPU_DISPATCH
+void BiasActivateLayerNorm(const size_t rows, const size_t channels,
+                           float* data, const float* biases,
+                           const ActivationFunction activation,
+                           const float alpha, const float* skip,
+                           const float* gammas, const float* betas,
+                           const float epsilon) {
+  for (size_t i = 0; i < rows; i++) {
+    float* row = data + i * channels;
+    const float* skip_row = skip != nullptr ? skip + i * channels : nullptr;
+#ifndef USE_ISPC
+    // Bias and activation use the vectorized row kernels, the row is then
+    // still hot for the rest of the epilogue.
+    Activate(channels, row, biases, row, activation);
+
+    // Mean taken in dimension C.
+    float mean = 0;
+    if (skip_row != nullptr) {
+      for (size_t c = 0; c < channels; ++c) {
+        row[c] = row[c] * alpha + skip_row[c];
+        mean += row[c];
+      }
+    } else {
+      for (size_t c = 0; c < channels; ++c) {
+        row[c] *= alpha;
+        mean += row[c];
+      }
+    }
+    mean /= channels;
+
+    // Variance.
+    float var = 0;
+    for (size_t c = 0; c < channels; ++c) {
+      auto diff = row[c] - mean;
+      var += diff * diff;
+    }
+    var /= channels;
+
+    // Norm.
+    float den = 1.0f / std::sqrt(var + epsilon);
+    for (size_t c = 0; c < channels; ++c) {
+      row[c] = betas[c] + gammas[c] * (row[c] - mean) * den;
+    }
+#else
+    if (activation == ACTIVATION_NONE) {
+      ispc::BiasLayerNorm2DWithSkipConnection(channels, row, biases, alpha,
+                                              skip_row, gammas, betas,
+                                              epsilon);
+    } else if (activation == ACTIVATION_MISH ||
+               activation == ACTIVATION_RELU ||
+               activation == ACTIVATION_RELU_2 ||
+               activation == ACTIVATION_SELU ||
+               activation == ACTIVATION_SWISH) {
+      ispc::BiasActivateLayerNorm(channels, row, biases, activation, alpha,
+                                  skip_row, gammas, betas, epsilon);
+    } else {
+      // No ispc version of these activations, throws for unsupported ones as
+      // activate() in the ispc kernel would pass them through.
+      Activate(channels, row, biases, row, activation);
+      ispc::LayerNorm2DWithSkipConnection(channels, row, alpha, skip_row,
+                                          gammas, betas, epsilon);
+    }
+#endif
+  }
+}
+
 }  // namespace lczero
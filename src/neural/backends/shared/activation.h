@@ -41,6 +41,17 @@ float Activate(const float val, const ActivationFunction activation);
 void Activate(const size_t len, const float* data, const float* bias,
               float* output, const ActivationFunction activation);
 
+// Fused epilogue for fully connected layers followed by a layer norm, over
+// `rows` rows of `channels` values. Each row gets bias and activation, is
+// scaled by alpha, has the (optional) skip connection added and is normalized
+// while still in cache, instead of making a separate pass for every step.
+void BiasActivateLayerNorm(const size_t rows, const size_t channels,
+                           float* data, const float* biases,
+                           const ActivationFunction activation,
+                           const float alpha, const float* skip,
+                           const float* gammas, const float* betas,
+                           const float epsilon);
+
 void Activate(const size_t len, float gamma, const float* data,
               const float* bias, float beta, float* out,
               const ActivationFunction activation);
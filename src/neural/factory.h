@@ -108,27 +108,27 @@ class NetworkFactory {
   friend class Register;
 };
 
-#define REGISTER_NETWORK_WITH_COUNTER2(name, func, priority, counter)     \
-  namespace {                                                             \
-  namespace ns##counter {                                                 \
-  static NetworkFactory::Register regH38fhs##counter(                     \
-      name,                                                               \
-      [](const std::optional<WeightsFile>& w, const OptionsDict& o) {     \
-        return func(w, o);                                                \
-      },                                                                  \
-      priority);                                                          \
-  static BackendManager::Register regK03nv##counter(                      \
-      std::make_unique<NetworkAsBackendFactory>(                          \
-          name,                                                           \
-          [](const std::optional<WeightsFile>& w, const OptionsDict& o) { \
-            return func(w, o);                                            \
-          },                                                              \
-          priority));                                                     \
-  }                                                                       \
+#define REGISTER_NETWORK_WITH_COUNTER2(name, func, priority, store, counter) \
+  namespace {                                                                \
+  namespace ns##counter {                                                    \
+  static NetworkFactory::Register regH38fhs##counter(                        \
+      name,                                                                  \
+      [](const std::optional<WeightsFile>& w, const OptionsDict& o) {        \
+        return func(w, o);                                                   \
+      },                                                                     \
+      priority);                                                             \
+  static BackendManager::Register regK03nv##counter(                         \
+      std::make_unique<NetworkAsBackendFactory>(                             \
+          name,                                                              \
+          [](const std::optional<WeightsFile>& w, const OptionsDict& o) {    \
+            return func(w, o);                                               \
+          },                                                                 \
+          priority, store));                                                 \
+  }                                                                          \
   }
 
-#define REGISTER_NETWORK_WITH_COUNTER(name, func, priority, counter) \
-  REGISTER_NETWORK_WITH_COUNTER2(name, func, priority, counter)
+#define REGISTER_NETWORK_WITH_COUNTER(name, func, priority, store, counter) \
+  REGISTER_NETWORK_WITH_COUNTER2(name, func, priority, store, counter)
 
 // Registers a Network.
 // Constructor of a network class must have parameters:
@@ -139,5 +139,11 @@ class NetworkFactory {
 // @priority -- numeric priority of a backend. Higher is higher, highest number
 // is the default backend.
 #define REGISTER_NETWORK(name, func, priority) \
-  REGISTER_NETWORK_WITH_COUNTER(name, func, priority, __LINE__)
+  REGISTER_NETWORK_WITH_COUNTER(name, func, priority, false, __LINE__)
+
+// Same as REGISTER_NETWORK, for networks which read the weights_store,
+// weights_store_key and weights_store_source options, and so can use the
+// weights cache.
+#define REGISTER_NETWORK_WITH_WEIGHTS_STORE(name, func, priority) \
+  REGISTER_NETWORK_WITH_COUNTER(name, func, priority, true, __LINE__)
 }  // namespace lczero
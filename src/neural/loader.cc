@@ -32,9 +32,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <chrono>
 #include <cstdio>
-#include <fstream>
-#include <sstream>
+#include <cstring>
+#include <memory>
 #include <string>
 
 #include "neural/shared_params.h"
@@ -45,63 +46,98 @@
 #include "utils/optionsdict.h"
 #include "version.h"
 
-#ifdef _WIN32
-#include <io.h>
-#else
-#include <unistd.h>
-#endif
-
 namespace lczero {
 
 namespace {
 const std::uint32_t kWeightMagic = 0x1c0;
 
-std::string DecompressGzip(const std::string& filename) {
-  const int kStartingSize = 8 * 1024 * 1024;  // 8M
-  std::string buffer;
-  buffer.resize(kStartingSize);
-  int bytes_read = 0;
+// Raw contents of a weights file: either a view into the mapped file for
+// uncompressed protobufs, or the inflated copy of a gzipped one.
+struct WeightsBuffer {
+  std::unique_ptr<MappedFile> mapped;
+  std::string inflated;
+  std::string_view data;
+};
+
+// Inflates all gzip members of |in| into a buffer presized from the trailer of
+// the last member, so that large files are decompressed without reallocation.
+std::string InflateGzip(std::string_view in, const std::string& filename) {
+  std::string out;
+  uint32_t isize;
+  std::memcpy(&isize, in.data() + in.size() - sizeof(isize), sizeof(isize));
+  // ISIZE is only the size modulo 2^32 of the last member, so it is a hint.
+  out.resize(std::max<size_t>(isize, in.size()));
+  size_t out_pos = 0;
+
+  z_stream strm{};
+  if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) {
+    throw Exception("Cannot process file " + filename);
+  }
+  size_t in_pos = 0;
+  while (true) {
+    if (out_pos == out.size()) out.resize(out.size() * 2);
+    const size_t in_chunk = std::min<size_t>(in.size() - in_pos, 1u << 30);
+    const size_t out_chunk = std::min<size_t>(out.size() - out_pos, 1u << 30);
+    strm.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(in.data() + in_pos));
+    strm.avail_in = in_chunk;
+    strm.next_out = reinterpret_cast<Bytef*>(out.data() + out_pos);
+    strm.avail_out = out_chunk;
+    const int ret = inflate(&strm, Z_NO_FLUSH);
+    in_pos += in_chunk - strm.avail_in;
+    out_pos += out_chunk - strm.avail_out;
+    if (ret == Z_STREAM_END) {
+      // Concatenated gzip members are decompressed as one stream, like gzread.
+      if (in.size() - in_pos < 2 || in[in_pos] != '\x1f' ||
+          in[in_pos + 1] != '\x8b') {
+        break;
+      }
+      inflateReset(&strm);
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      inflateEnd(&strm);
+      throw Exception("Cannot process file " + filename + ": " +
+                      (strm.msg ? strm.msg : "inflate error"));
+    } else if (in_pos == in.size() && out_pos < out.size()) {
+      inflateEnd(&strm);
+      throw Exception("Cannot process file " + filename + ": truncated");
+    }
+  }
+  inflateEnd(&strm);
+  out.resize(out_pos);
+  return out;
+}
 
-  // Read whole file into a buffer.
-  FILE* fp = fopen(filename.c_str(), "rb");
-  if (!fp) {
+WeightsBuffer ReadWeightsFile(const std::string& filename) {
+  WeightsBuffer buffer;
+  try {
+    buffer.mapped = std::make_unique<MappedFile>(filename);
+  } catch (const Exception&) {
     throw Exception("Cannot read weights from " + filename);
   }
+  std::string_view file(buffer.mapped->data(), buffer.mapped->size());
   if (filename == CommandLine::BinaryName()) {
     // The network file should be appended at the end of the lc0 executable,
     // followed by the network file size and a "Lc0!" (0x2130634c) magic.
-    int32_t size, magic;
-    if (fseek(fp, -8, SEEK_END) || fread(&size, 4, 1, fp) != 1 ||
-        fread(&magic, 4, 1, fp) != 1 || magic != 0x2130634c) {
-      fclose(fp);
+    int32_t size = 0, magic = 0;
+    if (file.size() >= 8) {
+      std::memcpy(&size, file.data() + file.size() - 8, 4);
+      std::memcpy(&magic, file.data() + file.size() - 4, 4);
+    }
+    if (magic != 0x2130634c || size <= 0 ||
+        static_cast<size_t>(size) > file.size() - 8) {
       throw Exception("No embedded file detected.");
     }
-    fseek(fp, -size - 8, SEEK_END);
+    file = file.substr(file.size() - 8 - size, size);
   }
-  fflush(fp);
-  gzFile file = gzdopen(dup(fileno(fp)), "rb");
-  fclose(fp);
-  if (!file) {
-    throw Exception("Cannot process file " + filename);
-  }
-  while (true) {
-    const int sz =
-        gzread(file, &buffer[bytes_read], buffer.size() - bytes_read);
-    if (sz < 0) {
-      int errnum;
-      throw Exception(gzerror(file, &errnum));
-    }
-    if (sz == static_cast<int>(buffer.size()) - bytes_read) {
-      bytes_read = buffer.size();
-      buffer.resize(buffer.size() * 2);
-    } else {
-      bytes_read += sz;
-      buffer.resize(bytes_read);
-      break;
-    }
+  if (file.size() >= 18 && file[0] == '\x1f' && file[1] == '\x8b') {
+    buffer.inflated = InflateGzip(file, filename);
+    buffer.data = buffer.inflated;
+    // The compressed file is not needed anymore.
+    buffer.mapped.reset();
+  } else {
+    // Uncompressed protobuf, parsed directly from the mapping.
+    buffer.data = file;
   }
-  gzclose(file);
-
   return buffer;
 }
 
@@ -145,7 +181,7 @@ void FixOlderWeightsFile(WeightsFile* file) {
   // Get updated network format.
   if (file->format().network_format().network() ==
       nf::NETWORK_ATTENTIONBODY_WITH_HEADFORMAT) {
-    auto weights = file->weights();
+    const auto& weights = file->weights();
     if (weights.has_policy_heads() && weights.has_value_heads()) {
       CERR << "Weights file has multihead format, updating format flag";
       net->set_network(nf::NETWORK_ATTENTIONBODY_WITH_MULTIHEADFORMAT);
@@ -157,7 +193,7 @@ void FixOlderWeightsFile(WeightsFile* file) {
   }
 }
 
-WeightsFile ParseWeightsProto(const std::string& buffer) {
+WeightsFile ParseWeightsProto(std::string_view buffer) {
   WeightsFile net;
   net.ParseFromString(buffer);
 
@@ -192,22 +228,34 @@ WeightsFile ParseWeightsProto(const std::string& buffer) {
 }  // namespace
 
 WeightsFile LoadWeightsFromFile(const std::string& filename) {
-  FloatVectors vecs;
-  auto buffer = DecompressGzip(filename);
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  const auto buffer = ReadWeightsFile(filename);
+  const std::string_view data = buffer.data;
 
-  if (buffer.size() < 2) {
+  if (data.size() < 2) {
     throw Exception("Invalid weight file: too small.");
   }
-  if (buffer[0] == '1' && buffer[1] == '\n') {
+  if (data[0] == '1' && data[1] == '\n') {
     throw Exception("Invalid weight file: no longer supported.");
   }
-  if (buffer[0] == '2' && buffer[1] == '\n') {
+  if (data[0] == '2' && data[1] == '\n') {
     throw Exception(
         "Text format weights files are no longer supported. Use a command line "
         "tool to convert it to the new format.");
   }
 
-  return ParseWeightsProto(buffer);
+  const auto read = Clock::now();
+  auto net = ParseWeightsProto(data);
+  const auto parsed = Clock::now();
+  const auto ms = [](auto d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+  };
+  CERR << "Weights loaded in " << ms(parsed - start) << "ms ("
+          << (buffer.inflated.empty() ? "read " : "decompress ")
+          << ms(read - start) << "ms, parse " << ms(parsed - read)
+          << "ms, " << data.size() / 1024 << " KiB).";
+  return net;
 }
 
 std::optional<WeightsFile> LoadWeights(std::string_view location) {
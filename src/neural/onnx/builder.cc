@@ -51,6 +51,8 @@ OnnxBuilder::OnnxBuilder(int opset) : opset_(opset) {
 }
 
 namespace {
+const char* const kContribDomain = "com.microsoft";
+
 void FillValueInfo(pblczero::ValueInfoProto* vip, const std::string& name,
                    std::initializer_list<int> dims,
                    pblczero::TensorProto::DataType datatype) {
@@ -478,4 +480,82 @@ std::string OnnxBuilder::ReduceMean(const std::string& name,
   return out;
 }
 
+std::string OnnxBuilder::Gemm(const std::string& name, const std::string& input,
+                              const OnnxConst& weights,
+                              const OnnxConst& bias) {
+  auto* node = model_.mutable_graph()->add_node();
+  auto out = PopulateStdNodeFields(node, name, input, "Gemm");
+  node->add_input(AddInitializer(name + "/w", weights));
+  node->add_input(AddInitializer(name + "/b", bias));
+  return out;
+}
+
+void OnnxBuilder::UseContribDomain() {
+  if (contrib_domain_) return;
+  auto* opset = model_.add_opset_import();
+  opset->set_domain(kContribDomain);
+  opset->set_version(1);
+  contrib_domain_ = true;
+}
+
+std::string OnnxBuilder::SkipLayerNormalization(const std::string& name,
+                                                const std::string& input,
+                                                const std::string& skip,
+                                                const OnnxConst& gammas,
+                                                const OnnxConst& betas,
+                                                float epsilon) {
+  UseContribDomain();
+  auto* node = model_.mutable_graph()->add_node();
+  auto out = PopulateStdNodeFields(node, name, input, "SkipLayerNormalization");
+  node->set_domain(kContribDomain);
+  node->add_input(skip);
+  node->add_input(AddInitializer(name + "/w/scale", gammas));
+  node->add_input(AddInitializer(name + "/w/bias", betas));
+  AddFloatAttribute(node, "epsilon", epsilon);
+  return out;
+}
+
+std::string OnnxBuilder::SkipLayerNormalization(
+    const std::string& name, const std::string& input, const std::string& skip,
+    const OnnxConst& gammas, const OnnxConst& betas, const OnnxConst& bias,
+    float epsilon) {
+  auto out = SkipLayerNormalization(name, input, skip, gammas, betas, epsilon);
+  auto* node = &model_.mutable_graph()->mutable_node()->back();
+  node->add_input(AddInitializer(name + "/w/input_bias", bias));
+  return out;
+}
+
+std::string OnnxBuilder::MultiHeadAttention(const std::string& name,
+                                            const std::string& query,
+                                            const std::string& key,
+                                            const std::string& value,
+                                            const std::string& attention_bias,
+                                            int num_heads, float scale) {
+  UseContribDomain();
+  auto* node = model_.mutable_graph()->add_node();
+  auto out = PopulateStdNodeFields(node, name, query, "MultiHeadAttention");
+  node->set_domain(kContribDomain);
+  node->add_input(key);
+  node->add_input(value);
+  if (!attention_bias.empty()) {
+    // No packed bias or key padding mask.
+    node->add_input("");
+    node->add_input("");
+    node->add_input(attention_bias);
+  }
+  AddIntAttribute(node, "num_heads", num_heads);
+  AddFloatAttribute(node, "scale", scale);
+  return out;
+}
+
+std::string OnnxBuilder::QuickGelu(const std::string& name,
+                                   const std::string& input, float alpha) {
+  UseContribDomain();
+  auto* node = model_.mutable_graph()->add_node();
+  auto out = PopulateStdNodeFields(node, name, input, "QuickGelu");
+  node->set_domain(kContribDomain);
+  AddFloatAttribute(node, "alpha", alpha);
+  return out;
+}
+
 }  // namespace lczero
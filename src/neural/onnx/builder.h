@@ -126,13 +126,39 @@ class OnnxBuilder {
                    pblczero::TensorProto::DataType type);
   std::string ReduceMean(const std::string& name, const std::string& input,
                          std::initializer_list<int> axes, bool keepdims = true);
+  std::string Gemm(const std::string& name, const std::string& input,
+                   const OnnxConst& weights, const OnnxConst& bias);
+
+  // Operators from the ONNX Runtime "com.microsoft" contrib domain.
+  std::string SkipLayerNormalization(const std::string& name,
+                                     const std::string& input,
+                                     const std::string& skip,
+                                     const OnnxConst& gammas,
+                                     const OnnxConst& betas, float epsilon);
+  std::string SkipLayerNormalization(const std::string& name,
+                                     const std::string& input,
+                                     const std::string& skip,
+                                     const OnnxConst& gammas,
+                                     const OnnxConst& betas,
+                                     const OnnxConst& bias, float epsilon);
+  std::string MultiHeadAttention(const std::string& name,
+                                 const std::string& query,
+                                 const std::string& key,
+                                 const std::string& value,
+                                 const std::string& attention_bias,
+                                 int num_heads, float scale);
+  std::string QuickGelu(const std::string& name, const std::string& input,
+                        float alpha);
   // Returns ONNX model as protobuf.
   const pblczero::ModelProto& as_proto() const { return model_; }
   // Returns serialized model.
   std::string OutputAsString() const { return model_.OutputAsString(); }
 
  private:
+  void UseContribDomain();
+
   const int opset_;
+  bool contrib_domain_ = false;
   pblczero::ModelProto model_;
 };
 
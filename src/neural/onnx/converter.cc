@@ -130,10 +130,26 @@ class Converter {
                             const lczero::OnnxConst& gammas,
                             const lczero::OnnxConst& betas, float eps = 1e-6);
 
+  std::string MakeDense(OnnxBuilder* builder, const std::string& input,
+                        const lczero::OnnxConst& weights,
+                        const lczero::OnnxConst& biases,
+                        const std::string& matmul_name,
+                        const std::string& add_name);
+
+  std::string MakeDenseSkipLayerNorm(
+      OnnxBuilder* builder, const std::string& input, const std::string& skip,
+      const lczero::OnnxConst& weights, const lczero::OnnxConst& biases,
+      float alpha, const std::string& dense_name, const std::string& alpha_name,
+      const std::string& skip_name, const std::string& ln_name,
+      const lczero::OnnxConst& gammas, const lczero::OnnxConst& betas,
+      float eps);
+
   std::string MakeFFN(OnnxBuilder* builder, const MultiHeadWeights::FFN& ffn,
                       int embedding_size, const std::string& ffn_in,
                       const std::string& name, ActivationFunction activation,
-                      float alpha);
+                      float alpha, const std::string& ln_name,
+                      const lczero::OnnxConst& gammas,
+                      const lczero::OnnxConst& betas, float eps);
 
   std::string MakeEncoderLayer(OnnxBuilder* builder,
                                const MultiHeadWeights::EncoderLayer& layer,
@@ -162,6 +178,7 @@ class Converter {
   void AddStdInitializers(OnnxBuilder* builder);
 
   pblczero::TensorProto::DataType GetDataType() const;
+  bool UseFusedOps() const;
   std::unique_ptr<OnnxConst> GetWeghtsConverter(
       const std::vector<float>&, std::initializer_list<int> dims,
       std::initializer_list<int> order = {});
@@ -194,6 +211,14 @@ pblczero::TensorProto::DataType Converter::GetDataType() const {
   }
 }
 
+// The CPU kernels of the ONNX Runtime contrib operators used for fusion only
+// support float32, so other data types are not fused.
+bool Converter::UseFusedOps() const {
+  return options_.fused_ops &&
+         options_.data_type ==
+             WeightsToOnnxConverterOptions::DataType::kFloat32;
+}
+
 std::unique_ptr<OnnxConst> Converter::GetWeghtsConverter(
     const std::vector<float>& weights, std::initializer_list<int> dims,
     std::initializer_list<int> order) {
@@ -292,6 +317,8 @@ std::string Converter::MakeMish(OnnxBuilder* builder, const std::string& input,
 
 std::string Converter::MakeSwish(OnnxBuilder* builder, const std::string& input,
                                  const std::string& name) {
+  // QuickGelu is x * sigmoid(alpha * x).
+  if (UseFusedOps()) return builder->QuickGelu(name, input, 1.0f);
   auto flow = builder->Sigmoid(name + "/sigmoid", input);
   return builder->Mul(name, flow, input);
 }
@@ -336,17 +363,17 @@ std::string Converter::MakeSqueezeAndExcite(
   }
   auto flow = input;
   flow = builder->ReduceMean(name + "/reduce_mean", flow, {2, 3}, false);
-  flow = builder->MatMul(
-      name + "/matmul1", flow,
-      *GetWeghtsConverter(se_unit.w1, {NumFilters(), se_filters}, {1, 0}));
-  flow = builder->Add(name + "/add1", flow,
-                      *GetWeghtsConverter(se_unit.b1, {se_filters}));
+  flow = MakeDense(
+      builder, flow,
+      *GetWeghtsConverter(se_unit.w1, {NumFilters(), se_filters}, {1, 0}),
+      *GetWeghtsConverter(se_unit.b1, {se_filters}), name + "/matmul1",
+      name + "/add1");
   flow = MakeActivation(builder, flow, name, default_activation_);
-  flow = builder->MatMul(
-      name + "/matmul2", flow,
-      *GetWeghtsConverter(se_unit.w2, {se_filters, 2 * NumFilters()}, {1, 0}));
-  flow = builder->Add(name + "/add2", flow,
-                      *GetWeghtsConverter(se_unit.b2, {2 * NumFilters()}));
+  flow = MakeDense(
+      builder, flow,
+      *GetWeghtsConverter(se_unit.w2, {se_filters, 2 * NumFilters()}, {1, 0}),
+      *GetWeghtsConverter(se_unit.b2, {2 * NumFilters()}), name + "/matmul2",
+      name + "/add2");
   flow = builder->Reshape(name + "/reshape", flow, "/const/se_reshape");
 
   auto splits = builder->Split(name + "/split", flow, 1);
@@ -426,27 +453,26 @@ std::string Converter::MakeSmolgen(OnnxBuilder* builder,
       builder->AddInitializer(
           "/const" + name + "/smolgen/compress/shape",
           Int64OnnxConst({-1, 64 * smolgen_hidden_channels}, {2})));
-  flow = builder->MatMul(
-      name + "/smolgen/dense1/w", flow,
+  flow = MakeDense(
+      builder, flow,
       *GetWeghtsConverter(layer.mha.smolgen.dense1_w,
                           {64 * smolgen_hidden_channels, smolgen_hidden_sz},
-                          {1, 0}));
-  flow = builder->Add(
-      name + "/smolgen/dense1/b", flow,
-      *GetWeghtsConverter(layer.mha.smolgen.dense1_b, {smolgen_hidden_sz}));
+                          {1, 0}),
+      *GetWeghtsConverter(layer.mha.smolgen.dense1_b, {smolgen_hidden_sz}),
+      name + "/smolgen/dense1/w", name + "/smolgen/dense1/b");
   flow = MakeActivation(builder, flow, name + "/smolgen/dense1", activation);
   flow = MakeLayerNorm(
       builder, flow, name + "/smolgen/ln1",
       *GetWeghtsConverter(layer.mha.smolgen.ln1_gammas, {smolgen_hidden_sz}),
       *GetWeghtsConverter(layer.mha.smolgen.ln1_betas, {smolgen_hidden_sz}),
       1e-3);
-  flow = builder->MatMul(
-      name + "/smolgen/dense2/w", flow,
+  flow = MakeDense(
+      builder, flow,
       *GetWeghtsConverter(layer.mha.smolgen.dense2_w,
-                          {smolgen_hidden_sz, smolgen_gen_sz * heads}, {1, 0}));
-  flow = builder->Add(name + "/smolgen/dense2/b", flow,
-                      *GetWeghtsConverter(layer.mha.smolgen.dense2_b,
-                                          {smolgen_gen_sz * heads}));
+                          {smolgen_hidden_sz, smolgen_gen_sz * heads}, {1, 0}),
+      *GetWeghtsConverter(layer.mha.smolgen.dense2_b,
+                          {smolgen_gen_sz * heads}),
+      name + "/smolgen/dense2/w", name + "/smolgen/dense2/b");
   flow = MakeActivation(builder, flow, name + "/smolgen/dense2", activation);
   flow = MakeLayerNorm(builder, flow, name + "/smolgen/ln2",
                        *GetWeghtsConverter(layer.mha.smolgen.ln2_gammas,
@@ -499,28 +525,67 @@ std::string Converter::MakeLayerNorm(OnnxBuilder* builder,
   return flow;
 }
 
+std::string Converter::MakeDense(OnnxBuilder* builder,
+                                 const std::string& input,
+                                 const lczero::OnnxConst& weights,
+                                 const lczero::OnnxConst& biases,
+                                 const std::string& matmul_name,
+                                 const std::string& add_name) {
+  if (UseFusedOps()) return builder->Gemm(add_name, input, weights, biases);
+  auto flow = builder->MatMul(matmul_name, input, weights);
+  return builder->Add(add_name, flow, biases);
+}
+
+// Dense layer, scaled by alpha, added to skip and layer normalized. When fused
+// it is a single SkipLayerNormalization, which also adds the dense biases.
+std::string Converter::MakeDenseSkipLayerNorm(
+    OnnxBuilder* builder, const std::string& input, const std::string& skip,
+    const lczero::OnnxConst& weights, const lczero::OnnxConst& biases,
+    float alpha, const std::string& dense_name, const std::string& alpha_name,
+    const std::string& skip_name, const std::string& ln_name,
+    const lczero::OnnxConst& gammas, const lczero::OnnxConst& betas,
+    float eps) {
+  if (UseFusedOps() && !options_.alt_layernorm) {
+    if (alpha == 1.0f) {
+      auto flow = builder->MatMul(dense_name + "/w", input, weights);
+      return builder->SkipLayerNormalization(ln_name, flow, skip, gammas, betas,
+                                             biases, eps);
+    }
+    auto flow = builder->Gemm(dense_name + "/b", input, weights, biases);
+    flow = builder->Mul(alpha_name, flow, *GetScalarConverter(alpha));
+    return builder->SkipLayerNormalization(ln_name, flow, skip, gammas, betas,
+                                           eps);
+  }
+  auto flow = MakeDense(builder, input, weights, biases, dense_name + "/w",
+                        dense_name + "/b");
+  if (alpha != 1.0) {
+    flow = builder->Mul(alpha_name, flow, *GetScalarConverter(alpha));
+  }
+  flow = builder->Add(skip_name, flow, skip);
+  return MakeLayerNorm(builder, flow, ln_name, gammas, betas, eps);
+}
+
 std::string Converter::MakeFFN(OnnxBuilder* builder,
                                const MultiHeadWeights::FFN& ffn,
                                int embedding_size, const std::string& ffn_in,
                                const std::string& name,
-                               ActivationFunction activation, float alpha) {
+                               ActivationFunction activation, float alpha,
+                               const std::string& ln_name,
+                               const lczero::OnnxConst& gammas,
+                               const lczero::OnnxConst& betas, float eps) {
   const int dff_size = ffn.dense1_b.size();
-  auto flow = builder->MatMul(
-      name + "/ffn/dense1/w", ffn_in,
-      *GetWeghtsConverter(ffn.dense1_w, {embedding_size, dff_size}, {1, 0}));
-  flow = builder->Add(name + "/ffn/dense1/b", flow,
-                      *GetWeghtsConverter(ffn.dense1_b, {dff_size}));
+  auto flow = MakeDense(
+      builder, ffn_in,
+      *GetWeghtsConverter(ffn.dense1_w, {embedding_size, dff_size}, {1, 0}),
+      *GetWeghtsConverter(ffn.dense1_b, {dff_size}), name + "/ffn/dense1/w",
+      name + "/ffn/dense1/b");
   flow = MakeActivation(builder, flow, name + "/ffn/dense1", activation);
-  flow = builder->MatMul(
-      name + "/ffn/dense2/w", flow,
-      *GetWeghtsConverter(ffn.dense2_w, {dff_size, embedding_size}, {1, 0}));
-  flow = builder->Add(name + "/ffn/dense2/b", flow,
-                      *GetWeghtsConverter(ffn.dense2_b, {embedding_size}));
-  if (alpha != 1.0) {
-    flow = builder->Mul(name + "/ffn/alpha", flow, *GetScalarConverter(alpha));
-  }
-  flow = builder->Add(name + "/ffn/skip", flow, ffn_in);
-  return flow;
+  return MakeDenseSkipLayerNorm(
+      builder, flow, ffn_in,
+      *GetWeghtsConverter(ffn.dense2_w, {dff_size, embedding_size}, {1, 0}),
+      *GetWeghtsConverter(ffn.dense2_b, {embedding_size}), alpha,
+      name + "/ffn/dense2", name + "/ffn/alpha", name + "/ffn/skip", ln_name,
+      gammas, betas, eps);
 }
 
 std::string Converter::MakeEncoderLayer(
@@ -530,73 +595,83 @@ std::string Converter::MakeEncoderLayer(
   const int d_model = layer.mha.q_b.size();
   const int depth = d_model / heads;
 
-  auto mha_shape =
-      builder->AddInitializer("/const" + name + "/mha/shape",
-                              Int64OnnxConst({-1, 64, heads, depth}, {4}));
-  auto flow = builder->MatMul(
-      name + "/mha/Q/w", encoder_in,
-      *GetWeghtsConverter(layer.mha.q_w, {embedding_size, d_model}, {1, 0}));
-  flow = builder->Add(name + "/mha/Q/b", flow,
-                      *GetWeghtsConverter(layer.mha.q_b, {d_model}));
-  flow = builder->Reshape(name + "/mha/Q/reshape", flow, mha_shape);
-  auto Q = builder->Transpose(name + "/mha/Q/transpose", flow, {0, 2, 1, 3});
-  flow = builder->MatMul(
-      name + "/mha/K/w", encoder_in,
-      *GetWeghtsConverter(layer.mha.k_w, {embedding_size, d_model}, {1, 0}));
-  flow = builder->Add(name + "/mha/K/b", flow,
-                      *GetWeghtsConverter(layer.mha.k_b, {d_model}));
-  flow = builder->Reshape(name + "/mha/K/reshape", flow, mha_shape);
-  auto K = builder->Transpose(name + "/mha/K/transpose", flow, {0, 2, 3, 1});
-  flow = builder->MatMul(
-      name + "/mha/V/w", encoder_in,
-      *GetWeghtsConverter(layer.mha.v_w, {embedding_size, d_model}, {1, 0}));
-  flow = builder->Add(name + "/mha/V/b", flow,
-                      *GetWeghtsConverter(layer.mha.v_b, {d_model}));
-  flow = builder->Reshape(name + "/mha/V/reshape", flow, mha_shape);
-  auto V = builder->Transpose(name + "/mha/V/transpose", flow, {0, 2, 1, 3});
-  flow = builder->MatMul(name + "/mha/QK/matmul", Q, K);
-  flow = builder->Mul(name + "/mha/QK/scale", flow,
-                      *GetScalarConverter(1.0f / sqrtf(depth)));
-  if (layer.mha.has_smolgen) {
-    auto smolgen_weights =
-        MakeSmolgen(builder, layer, embedding_size, heads, encoder_in, name);
-    flow = builder->Add(name + "/smolgen_weights", flow, smolgen_weights);
-  }
-  flow = builder->Softmax(name + "/mha/QK/softmax", flow, 3);
-  flow = builder->MatMul(name + "/mha/QKV/matmul", flow, V);
-  if (heads > 1) {
-    flow = builder->Transpose(name + "/mha/out/transpose", flow, {0, 2, 1, 3});
+  auto Q = MakeDense(
+      builder, encoder_in,
+      *GetWeghtsConverter(layer.mha.q_w, {embedding_size, d_model}, {1, 0}),
+      *GetWeghtsConverter(layer.mha.q_b, {d_model}), name + "/mha/Q/w",
+      name + "/mha/Q/b");
+  auto K = MakeDense(
+      builder, encoder_in,
+      *GetWeghtsConverter(layer.mha.k_w, {embedding_size, d_model}, {1, 0}),
+      *GetWeghtsConverter(layer.mha.k_b, {d_model}), name + "/mha/K/w",
+      name + "/mha/K/b");
+  auto V = MakeDense(
+      builder, encoder_in,
+      *GetWeghtsConverter(layer.mha.v_w, {embedding_size, d_model}, {1, 0}),
+      *GetWeghtsConverter(layer.mha.v_b, {d_model}), name + "/mha/V/w",
+      name + "/mha/V/b");
+  std::string flow;
+  if (UseFusedOps()) {
+    // MultiHeadAttention takes [batch, sequence, d_model] inputs and smolgen
+    // as the attention bias.
+    auto mha_shape =
+        builder->AddInitializer("/const" + name + "/mha/shape",
+                                Int64OnnxConst({-1, 64, d_model}, {3}));
+    Q = builder->Reshape(name + "/mha/Q/reshape", Q, mha_shape);
+    K = builder->Reshape(name + "/mha/K/reshape", K, mha_shape);
+    V = builder->Reshape(name + "/mha/V/reshape", V, mha_shape);
+    std::string smolgen_weights;
+    if (layer.mha.has_smolgen) {
+      smolgen_weights =
+          MakeSmolgen(builder, layer, embedding_size, heads, encoder_in, name);
+    }
+    flow = builder->MultiHeadAttention(name + "/mha", Q, K, V, smolgen_weights,
+                                       heads, 1.0f / sqrtf(depth));
+  } else {
+    auto mha_shape =
+        builder->AddInitializer("/const" + name + "/mha/shape",
+                                Int64OnnxConst({-1, 64, heads, depth}, {4}));
+    flow = builder->Reshape(name + "/mha/Q/reshape", Q, mha_shape);
+    Q = builder->Transpose(name + "/mha/Q/transpose", flow, {0, 2, 1, 3});
+    flow = builder->Reshape(name + "/mha/K/reshape", K, mha_shape);
+    K = builder->Transpose(name + "/mha/K/transpose", flow, {0, 2, 3, 1});
+    flow = builder->Reshape(name + "/mha/V/reshape", V, mha_shape);
+    V = builder->Transpose(name + "/mha/V/transpose", flow, {0, 2, 1, 3});
+    flow = builder->MatMul(name + "/mha/QK/matmul", Q, K);
+    flow = builder->Mul(name + "/mha/QK/scale", flow,
+                        *GetScalarConverter(1.0f / sqrtf(depth)));
+    if (layer.mha.has_smolgen) {
+      auto smolgen_weights =
+          MakeSmolgen(builder, layer, embedding_size, heads, encoder_in, name);
+      flow = builder->Add(name + "/smolgen_weights", flow, smolgen_weights);
+    }
+    flow = builder->Softmax(name + "/mha/QK/softmax", flow, 3);
+    flow = builder->MatMul(name + "/mha/QKV/matmul", flow, V);
+    if (heads > 1) {
+      flow =
+          builder->Transpose(name + "/mha/out/transpose", flow, {0, 2, 1, 3});
+    }
   }
   flow = builder->Reshape(
       name + "/mha/out/reshape", flow,
       builder->AddInitializer("/const" + name + "/mha/out/shape",
                               Int64OnnxConst({-1, d_model}, {2})));
-  flow =
-      builder->MatMul(name + "/mha/out/dense/w", flow,
-                      *GetWeghtsConverter(layer.mha.dense_w,
-                                          {d_model, embedding_size}, {1, 0}));
-  flow = builder->Add(name + "/mha/out/dense/b", flow,
-                      *GetWeghtsConverter(layer.mha.dense_b, {embedding_size}));
-  if (alpha != 1.0) {
-    flow =
-        builder->Mul(name + "/alpha*input", flow, *GetScalarConverter(alpha));
-  }
-  flow = builder->Add(name + "/mha/out/skip", flow, encoder_in);
-  flow = MakeLayerNorm(builder, flow, name + "/ln1",
-                       *GetWeghtsConverter(layer.ln1_gammas, {embedding_size}),
-                       *GetWeghtsConverter(layer.ln1_betas, {embedding_size}),
-                       default_eps_);
+  flow = MakeDenseSkipLayerNorm(
+      builder, flow, encoder_in,
+      *GetWeghtsConverter(layer.mha.dense_w, {d_model, embedding_size},
+                          {1, 0}),
+      *GetWeghtsConverter(layer.mha.dense_b, {embedding_size}), alpha,
+      name + "/mha/out/dense", name + "/alpha*input", name + "/mha/out/skip",
+      name + "/ln1", *GetWeghtsConverter(layer.ln1_gammas, {embedding_size}),
+      *GetWeghtsConverter(layer.ln1_betas, {embedding_size}), default_eps_);
   const auto ffn_activation = static_cast<ActivationFunction>(
       src_.format().network_format().ffn_activation());
-  flow = MakeFFN(
+  return MakeFFN(
       builder, layer.ffn, embedding_size, flow, name,
       ffn_activation == ACTIVATION_DEFAULT ? activation : ffn_activation,
-      alpha);
-  flow = MakeLayerNorm(builder, flow, name + "/ln2",
-                       *GetWeghtsConverter(layer.ln2_gammas, {embedding_size}),
-                       *GetWeghtsConverter(layer.ln2_betas, {embedding_size}),
-                       default_eps_);
-  return flow;
+      alpha, name + "/ln2",
+      *GetWeghtsConverter(layer.ln2_gammas, {embedding_size}),
+      *GetWeghtsConverter(layer.ln2_betas, {embedding_size}), default_eps_);
 }
 
 std::string Converter::AttentionBodyMapEmbedding(OnnxBuilder* builder,
@@ -682,13 +757,14 @@ std::string Converter::AttentionBodyDenseEmbedding(
       builder->AddInitializer("/const/pos_info_shape",
                               Int64OnnxConst({-1, 64 * 12}, {2})));
 
-  pos_info = builder->MatMul(
-      "/attn_body/embedding/preprocess/matmul", pos_info,
+  pos_info = MakeDense(
+      builder, pos_info,
       *GetWeghtsConverter(weights.ip_emb_preproc_w,
-                          {64 * 12, 64 * embedding_dense_size}, {1, 0}));
-  pos_info = builder->Add("/attn_body/embedding/preprocess/add", pos_info,
-                          *GetWeghtsConverter(weights.ip_emb_preproc_b,
-                                              {64 * embedding_dense_size}));
+                          {64 * 12, 64 * embedding_dense_size}, {1, 0}),
+      *GetWeghtsConverter(weights.ip_emb_preproc_b,
+                          {64 * embedding_dense_size}),
+      "/attn_body/embedding/preprocess/matmul",
+      "/attn_body/embedding/preprocess/add");
 
   pos_info = builder->Reshape(
       "/attn_body/embedding/preprocess/reshape", pos_info,
@@ -741,12 +817,12 @@ std::string Converter::MakeAttentionBody(OnnxBuilder* builder,
   }
 
   int embedding_size = weights.ip_emb_b.size();
-  flow = builder->MatMul(
-      "/attn_body/matmul", flow,
+  flow = MakeDense(
+      builder, flow,
       *GetWeghtsConverter(weights.ip_emb_w, {fist_stage_out_C, embedding_size},
-                          {1, 0}));
-  flow = builder->Add("/attn_body/add", flow,
-                      *GetWeghtsConverter(weights.ip_emb_b, {embedding_size}));
+                          {1, 0}),
+      *GetWeghtsConverter(weights.ip_emb_b, {embedding_size}),
+      "/attn_body/matmul", "/attn_body/add");
   flow = MakeActivation(builder, flow, "/attn_body", default_activation_);
 
   if (input_embedding == network_format::INPUT_EMBEDDING_PE_DENSE) {
@@ -780,10 +856,9 @@ std::string Converter::MakeAttentionBody(OnnxBuilder* builder,
   float alpha = std::pow(2.0f * NumEncBlocks(), -0.25f);
 
   if (input_embedding == network_format::INPUT_EMBEDDING_PE_DENSE) {
-    flow = MakeFFN(builder, weights.ip_emb_ffn, embedding_size, flow,
-                   "/attn_body", default_activation_, alpha);
-    flow = MakeLayerNorm(
-        builder, flow, "/attn_body/ln2",
+    flow = MakeFFN(
+        builder, weights.ip_emb_ffn, embedding_size, flow, "/attn_body",
+        default_activation_, alpha, "/attn_body/ln2",
         *GetWeghtsConverter(weights.ip_emb_ffn_ln_gammas, {embedding_size}),
         *GetWeghtsConverter(weights.ip_emb_ffn_ln_betas, {embedding_size}),
         1e-3);
@@ -833,15 +908,14 @@ std::string Converter::MakeAttentionPolicy(
         builder->AddInitializer("/const/policy_shape",
                                 Int64OnnxConst({-1, NumFilters()}, {2})));
   }
-  flow = builder->MatMul(
-      "/policy/dense1/matmul", flow,
+  flow = MakeDense(
+      builder, flow,
       *GetWeghtsConverter(head.ip_pol_w,
                           {NumEncBlocks() > 0 ? embedding_size : NumFilters(),
                            policy_embedding_size},
-                          {1, 0}));
-  flow = builder->Add("/policy/dense1/add", flow,
-                      *GetWeghtsConverter(head.ip_pol_b,
-                                          {policy_embedding_size}));
+                          {1, 0}),
+      *GetWeghtsConverter(head.ip_pol_b, {policy_embedding_size}),
+      "/policy/dense1/matmul", "/policy/dense1/add");
   flow = MakeActivation(builder, flow, "/policy/dense1", activation);
 
   for (size_t i = 0; i < head.pol_encoder.size(); i++) {
@@ -852,22 +926,22 @@ std::string Converter::MakeAttentionPolicy(
                          head.pol_encoder_head_count, flow, name, activation);
   }
   auto encoder_out = flow;
-  flow = builder->MatMul(
-      "/policy/Q/matmul", encoder_out,
+  flow = MakeDense(
+      builder, encoder_out,
       *GetWeghtsConverter(head.ip2_pol_w,
-                          {policy_embedding_size, policy_d_model}, {1, 0}));
-  flow = builder->Add("/policy/Q/add", flow,
-                      *GetWeghtsConverter(head.ip2_pol_b, {policy_d_model}));
+                          {policy_embedding_size, policy_d_model}, {1, 0}),
+      *GetWeghtsConverter(head.ip2_pol_b, {policy_d_model}),
+      "/policy/Q/matmul", "/policy/Q/add");
   auto Q = builder->Reshape(
       "/policy/Q/reshape", flow,
       builder->AddInitializer("/const/QK_shape",
                               Int64OnnxConst({-1, 64, policy_d_model}, {3})));
-  flow = builder->MatMul(
-      "/policy/K/matmul", encoder_out,
+  flow = MakeDense(
+      builder, encoder_out,
       *GetWeghtsConverter(head.ip3_pol_w,
-                          {policy_embedding_size, policy_d_model}, {1, 0}));
-  flow = builder->Add("/policy/K/add", flow,
-                      *GetWeghtsConverter(head.ip3_pol_b, {policy_d_model}));
+                          {policy_embedding_size, policy_d_model}, {1, 0}),
+      *GetWeghtsConverter(head.ip3_pol_b, {policy_d_model}),
+      "/policy/K/matmul", "/policy/K/add");
   auto K = builder->Reshape("/policy/K/reshape", flow, "/const/QK_shape");
   flow = builder->Transpose("/policy/K/transpose", K, {0, 2, 1});
   flow = builder->MatMul("/policy/matmul", Q, flow);
@@ -973,13 +1047,12 @@ void Converter::MakePolicyHead(pblczero::OnnxModel* onnx, OnnxBuilder* builder,
                          builder->AddInitializer(
                              "/const/policy_shape",
                              Int64OnnxConst({-1, pol_channels * 8 * 8}, {2})));
-    flow = builder->MatMul(
-        "/policy/dense/matmul", flow,
-        *GetWeghtsConverter(head.ip_pol_w,
-                            {pol_channels * 8 * 8, 1858}, {1, 0}));
-    auto output = builder->Add(
-        options_.output_policy_head, flow,
-        *GetWeghtsConverter(head.ip_pol_b, {1858}));
+    auto output = MakeDense(
+        builder, flow,
+        *GetWeghtsConverter(head.ip_pol_w, {pol_channels * 8 * 8, 1858},
+                            {1, 0}),
+        *GetWeghtsConverter(head.ip_pol_b, {1858}), "/policy/dense/matmul",
+        options_.output_policy_head);
     builder->AddOutput(output, {options_.batch_size, 1858}, GetDataType());
     onnx->set_output_policy(output);
   }
@@ -1003,12 +1076,12 @@ void Converter::MakeValueHead(pblczero::OnnxModel* onnx, OnnxBuilder* builder,
   const int val_channels = NumEncBlocks() > 0 ? head.ip_val_b.size() : 32;
   if (NumEncBlocks() > 0) {
     int embedding_size = weights.ip_emb_b.size();
-    flow = builder->MatMul(
-        "/value/embed/matmul", input,
+    flow = MakeDense(
+        builder, input,
         *GetWeghtsConverter(head.ip_val_w, {embedding_size, val_channels},
-                            {1, 0}));
-    flow = builder->Add("/value/embed/add", flow,
-                        *GetWeghtsConverter(head.ip_val_b, {val_channels}));
+                            {1, 0}),
+        *GetWeghtsConverter(head.ip_val_b, {val_channels}),
+        "/value/embed/matmul", "/value/embed/add");
     flow = MakeActivation(builder, flow, "/value/embed", default_activation_);
   } else {
     flow = MakeConvBlock(builder, head.value, NumFilters(), val_channels, input,
@@ -1018,30 +1091,28 @@ void Converter::MakeValueHead(pblczero::OnnxModel* onnx, OnnxBuilder* builder,
       "/value/reshape", flow,
       builder->AddInitializer("/const/value_shape",
                               Int64OnnxConst({-1, val_channels * 8 * 8}, {2})));
-  flow = builder->MatMul(
-      "/value/dense1/matmul", flow,
-      *GetWeghtsConverter(head.ip1_val_w, {val_channels * 8 * 8, 128}, {1, 0}));
-  flow = builder->Add("/value/dense1/add", flow,
-                      *GetWeghtsConverter(head.ip1_val_b, {128}));
+  flow = MakeDense(
+      builder, flow,
+      *GetWeghtsConverter(head.ip1_val_w, {val_channels * 8 * 8, 128}, {1, 0}),
+      *GetWeghtsConverter(head.ip1_val_b, {128}), "/value/dense1/matmul",
+      "/value/dense1/add");
   flow = MakeActivation(builder, flow, "/value/dense1", default_activation_);
 
   const bool wdl = src_.format().network_format().value() ==
                    pblczero::NetworkFormat::VALUE_WDL;
   if (wdl) {
-    flow =
-        builder->MatMul("/value/dense2/matmul", flow,
-                        *GetWeghtsConverter(head.ip2_val_w, {128, 3}, {1, 0}));
-    flow = builder->Add("/value/dense2/add", flow,
-                        *GetWeghtsConverter(head.ip2_val_b, {3}));
+    flow = MakeDense(builder, flow,
+                     *GetWeghtsConverter(head.ip2_val_w, {128, 3}, {1, 0}),
+                     *GetWeghtsConverter(head.ip2_val_b, {3}),
+                     "/value/dense2/matmul", "/value/dense2/add");
     auto output = builder->Softmax(options_.output_wdl, flow);
     builder->AddOutput(output, {options_.batch_size, 3}, GetDataType());
     onnx->set_output_wdl(output);
   } else {
-    flow =
-        builder->MatMul("/value/dense2/matmul", flow,
-                        *GetWeghtsConverter(head.ip2_val_w, {128, 1}, {1, 0}));
-    flow = builder->Add("/value/dense2/add", flow,
-                        *GetWeghtsConverter(head.ip2_val_b, {1}));
+    flow = MakeDense(builder, flow,
+                     *GetWeghtsConverter(head.ip2_val_w, {128, 1}, {1, 0}),
+                     *GetWeghtsConverter(head.ip2_val_b, {1}),
+                     "/value/dense2/matmul", "/value/dense2/add");
     auto output = builder->Tanh(options_.output_value, flow);
     builder->AddOutput(output, {options_.batch_size, 1}, GetDataType());
     onnx->set_output_value(output);
@@ -1063,12 +1134,12 @@ void Converter::MakeMovesLeftHead(pblczero::OnnxModel* onnx,
   std::string flow;
   if (NumEncBlocks() > 0) {
     int embedding_size = weights.ip_emb_b.size();
-    flow = builder->MatMul(
-        "/mlh/embed/matmul", input,
+    flow = MakeDense(
+        builder, input,
         *GetWeghtsConverter(weights.ip_mov_w, {embedding_size, mlh_channels},
-                            {1, 0}));
-    flow = builder->Add("/mlh/embed/add", flow,
-                        *GetWeghtsConverter(weights.ip_mov_b, {mlh_channels}));
+                            {1, 0}),
+        *GetWeghtsConverter(weights.ip_mov_b, {mlh_channels}),
+        "/mlh/embed/matmul", "/mlh/embed/add");
     flow = MakeActivation(builder, flow, "/mlh/embed", default_activation_);
   } else {
     flow =
@@ -1079,19 +1150,18 @@ void Converter::MakeMovesLeftHead(pblczero::OnnxModel* onnx,
       "/mlh/reshape", flow,
       builder->AddInitializer("/const/mlh_shape",
                               Int64OnnxConst({-1, mlh_channels * 8 * 8}, {2})));
-  flow = builder->MatMul(
-      "/mlh/dense1/matmul", flow,
+  flow = MakeDense(
+      builder, flow,
       *GetWeghtsConverter(weights.ip1_mov_w,
-                          {mlh_channels * 8 * 8, mlh_fc1_outputs}, {1, 0}));
-  flow =
-      builder->Add("/mlh/dense1/add", flow,
-                   *GetWeghtsConverter(weights.ip1_mov_b, {mlh_fc1_outputs}));
+                          {mlh_channels * 8 * 8, mlh_fc1_outputs}, {1, 0}),
+      *GetWeghtsConverter(weights.ip1_mov_b, {mlh_fc1_outputs}),
+      "/mlh/dense1/matmul", "/mlh/dense1/add");
   flow = MakeActivation(builder, flow, "/mlh/dense1", default_activation_);
-  flow = builder->MatMul(
-      "/mlh/dense2/matmul", flow,
-      *GetWeghtsConverter(weights.ip2_mov_w, {mlh_fc1_outputs, 1}, {1, 0}));
-  flow = builder->Add("/mlh/dense2/add", flow,
-                      *GetWeghtsConverter(weights.ip2_mov_b, {1}));
+  flow = MakeDense(
+      builder, flow,
+      *GetWeghtsConverter(weights.ip2_mov_w, {mlh_fc1_outputs, 1}, {1, 0}),
+      *GetWeghtsConverter(weights.ip2_mov_b, {1}), "/mlh/dense2/matmul",
+      "/mlh/dense2/add");
   flow = MakeActivation(builder, flow, "/mlh/dense2", default_activation_);
   auto output = builder->Identity(options_.output_mlh, flow);
   builder->AddOutput(output, {options_.batch_size, 1}, GetDataType());
@@ -28,6 +28,7 @@
 #include "neural/shared_params.h"
 
 #include "neural/factory.h"
+#include "neural/register.h"
 
 namespace lczero {
 const OptionId SharedBackendParams::kPolicySoftmaxTemp{
@@ -65,6 +66,14 @@ const OptionId SharedBackendParams::kNNCacheSizeId{
     "Number of positions to store in a memory cache. A large cache can speed "
     "up searching, but takes memory."};
 
+const OptionId SharedBackendParams::kWeightsCacheDirId{
+    "weights-cache-dir", "WeightsCacheDir",
+    "Directory where backends which support it keep their converted weights, "
+    "so that later starts map them instead of converting the weights file "
+    "again. Entries are keyed by the contents of the weights file, the backend "
+    "and its options, so the weights file is still read and hashed at every "
+    "start. Empty to disable."};
+
 void SharedBackendParams::Populate(OptionsParser* options) {
   options->Add<FloatOption>(kPolicySoftmaxTemp, 0.1f, 10.0f) = 1.359f;
   std::vector<std::string> history_fill_opt{"no", "fen_only", "always"};
@@ -75,12 +84,13 @@ void SharedBackendParams::Populate(OptionsParser* options) {
 #else
   options->Add<StringOption>(SharedBackendParams::kWeightsId) = kAutoDiscover;
 #endif
-  const auto backends = NetworkFactory::Get()->GetBackendsList();
+  const auto backends = BackendManager::Get()->GetBackendNames();
   options->Add<ChoiceOption>(SharedBackendParams::kBackendId, backends) =
       backends.empty() ? "<none>" : backends[0];
   options->Add<StringOption>(SharedBackendParams::kBackendOptionsId);
   options->Add<IntOption>(SharedBackendParams::kNNCacheSizeId, 0, 999999999) =
       2000000;
+  options->Add<StringOption>(SharedBackendParams::kWeightsCacheDirId);
 }
 
 }  // namespace lczero
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "neural/weights_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "utils/exception.h"
+#include "utils/hashcat.h"
+#include "utils/logging.h"
+#include "utils/random.h"
+#include "version.h"
+
+namespace lczero {
+namespace {
+
+constexpr char kStoreMagic[8] = {'L', 'c', '0', 'W', 'S', 't', 'r', '1'};
+constexpr uint64_t kTensorAlignment = 64;
+
+// The file starts with this header, followed by the key, the weights file
+// stub, the integers, the tensor directory (offset and size in floats of every
+// tensor) and the tensor data, with every tensor aligned to kTensorAlignment.
+struct StoreHeader {
+  char magic[8];
+  uint64_t key_size;
+  uint64_t stub_size;
+  uint64_t int_count;
+  uint64_t tensor_count;
+  uint64_t file_size;
+};
+
+struct TensorEntry {
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Hashes @data with four independent lanes, fast enough to hash a weights file
+// at every start.
+uint64_t HashBytes(std::string_view data) {
+  uint64_t lanes[4] = {1, 2, 3, 4};
+  size_t pos = 0;
+  for (; pos + 32 <= data.size(); pos += 32) {
+    for (int i = 0; i < 4; ++i) {
+      uint64_t word;
+      std::memcpy(&word, data.data() + pos + 8 * i, 8);
+      lanes[i] = HashCat(lanes[i], word);
+    }
+  }
+  uint64_t hash =
+      HashCat({lanes[0], lanes[1], lanes[2], lanes[3], data.size()});
+  for (; pos < data.size(); ++pos) {
+    hash = HashCat(hash, static_cast<unsigned char>(data[pos]));
+  }
+  return hash;
+}
+
+std::string HexHash(uint64_t hash) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(hash));
+  return buf;
+}
+
+uint64_t Align(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+std::unique_ptr<WeightsStore> WeightsStore::Open(const std::string& path,
+                                                 const std::string& key) {
+  if (GetFileSize(path) < sizeof(StoreHeader)) return nullptr;
+  std::unique_ptr<WeightsStore> store(
+      new WeightsStore(std::make_unique<MappedFile>(path)));
+  const char* data = store->file_->data();
+  const uint64_t size = store->file_->size();
+  StoreHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kStoreMagic, sizeof(kStoreMagic)) != 0 ||
+      header.file_size != size) {
+    return nullptr;
+  }
+  // A corrupt store is treated as missing, so that the caller converts the
+  // weights again and replaces it.
+  const auto corrupt = [&path]() {
+    LOGFILE << "Weights store is corrupt, ignoring it: " << path;
+    return nullptr;
+  };
+  uint64_t offset = sizeof(header);
+  const auto take = [&](uint64_t bytes) -> const char* {
+    if (bytes > size - offset) return nullptr;
+    const char* result = data + offset;
+    offset += bytes;
+    return result;
+  };
+  const char* key_data = take(header.key_size);
+  if (!key_data) return corrupt();
+  if (std::string_view(key_data, header.key_size) != key) return nullptr;
+  const char* stub_data = take(header.stub_size);
+  if (!stub_data) return corrupt();
+  store->stub_ = std::string_view(stub_data, header.stub_size);
+  offset = std::min(Align(offset, alignof(int64_t)), size);
+  if (header.int_count > size / sizeof(int64_t) ||
+      header.tensor_count > size / sizeof(TensorEntry)) {
+    return corrupt();
+  }
+  const char* ints_data = take(header.int_count * sizeof(int64_t));
+  if (!ints_data) return corrupt();
+  store->ints_.resize(header.int_count);
+  std::memcpy(store->ints_.data(), ints_data,
+              header.int_count * sizeof(int64_t));
+  const char* entries_data = take(header.tensor_count * sizeof(TensorEntry));
+  if (!entries_data) return corrupt();
+  std::vector<TensorEntry> entries(header.tensor_count);
+  std::memcpy(entries.data(), entries_data,
+              header.tensor_count * sizeof(TensorEntry));
+  for (const auto& entry : entries) {
+    if (entry.offset % kTensorAlignment != 0 || entry.offset > size ||
+        entry.size > (size - entry.offset) / sizeof(float)) {
+      return corrupt();
+    }
+    store->tensors_.emplace_back(
+        reinterpret_cast<const float*>(data + entry.offset), entry.size);
+  }
+  return store;
+}
+
+WeightsFile WeightsStore::GetWeightsFileStub() const {
+  WeightsFile file;
+  file.ParseFromString(stub_);
+  return file;
+}
+
+void WeightsStoreWriter::Publish(const std::string& path,
+                                 const std::string& key,
+                                 const WeightsFile& weights) const {
+  WeightsFile stub;
+  stub.set_magic(weights.magic());
+  *stub.mutable_min_version() = weights.min_version();
+  *stub.mutable_format() = weights.format();
+  const std::string stub_str = stub.OutputAsString();
+
+  StoreHeader header;
+  std::memcpy(header.magic, kStoreMagic, sizeof(kStoreMagic));
+  header.key_size = key.size();
+  header.stub_size = stub_str.size();
+  header.int_count = ints_.size();
+  header.tensor_count = tensors_.size();
+  uint64_t offset =
+      Align(sizeof(header) + key.size() + stub_str.size(), alignof(int64_t));
+  offset += ints_.size() * sizeof(int64_t);
+  offset += tensors_.size() * sizeof(TensorEntry);
+  std::vector<TensorEntry> entries;
+  for (const auto& tensor : tensors_) {
+    offset = Align(offset, kTensorAlignment);
+    entries.push_back({offset, tensor.size()});
+    offset += tensor.size() * sizeof(float);
+  }
+  header.file_size = offset;
+
+  const std::string tmp_path = path + ".tmp" + Random::Get().GetString(8);
+  {
+    std::ofstream file(tmp_path, std::ios::binary);
+    if (!file) throw Exception("Cannot create weights store: " + tmp_path);
+    uint64_t written = 0;
+    const auto write = [&](const void* data, uint64_t bytes) {
+      file.write(static_cast<const char*>(data), bytes);
+      written += bytes;
+    };
+    const auto pad_to = [&](uint64_t target) {
+      static const char kZeros[kTensorAlignment] = {};
+      write(kZeros, target - written);
+    };
+    write(&header, sizeof(header));
+    write(key.data(), key.size());
+    write(stub_str.data(), stub_str.size());
+    pad_to(Align(written, alignof(int64_t)));
+    write(ints_.data(), ints_.size() * sizeof(int64_t));
+    write(entries.data(), entries.size() * sizeof(TensorEntry));
+    for (size_t i = 0; i < tensors_.size(); i++) {
+      pad_to(entries[i].offset);
+      write(tensors_[i].data(), tensors_[i].size() * sizeof(float));
+    }
+    if (!file) {
+      file.close();
+      std::remove(tmp_path.c_str());
+      throw Exception("Cannot write weights store: " + tmp_path);
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    // Windows doesn't replace existing files.
+    std::remove(path.c_str());
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      std::remove(tmp_path.c_str());
+      throw Exception("Cannot publish weights store: " + path);
+    }
+  }
+  CERR << "Published weights store " << path << " ("
+       << header.file_size / (1024 * 1024) << " MiB).";
+}
+
+std::string GetWeightsStoreKey(const std::string& weights_path,
+                               const std::string& backend,
+                               const std::string& backend_options) {
+  const MappedFile file(weights_path);
+  return "lc0 " + GetVersionStr() + "\nweights " +
+         std::to_string(file.size()) + " " +
+         HexHash(HashBytes({file.data(), file.size()})) + "\nbackend " +
+         backend + "\noptions " + backend_options;
+}
+
+std::string GetWeightsCachePath(const std::string& dir,
+                                const std::string& backend,
+                                const std::string& key) {
+  std::string path = dir;
+  if (!path.empty() && path.back() != '/') path += '/';
+  return path + backend + "-" + HexHash(HashBytes(key)) + ".lc0w";
+}
+
+}  // namespace lczero
@@ -0,0 +1,112 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "neural/loader.h"
+#include "utils/filesystem.h"
+
+namespace lczero {
+
+// Read-only store of decoded, backend-ready weight tensors in a file which is
+// memory mapped by every process using it, so that several engine instances
+// on a host share one copy of the weights in RAM (put it in /dev/shm for a
+// POSIX shared memory object). Besides the tensors, the store has a sequence
+// of integers for layer counts and flags, and the weights file without the
+// weights, for the network format. The layout of the tensors is up to the
+// backend.
+//
+// A store is identified by a key which describes the weights file and the
+// backend options the tensors were converted with. A store with a different
+// key is ignored (and replaced when published).
+class WeightsStore {
+ public:
+  // Returns nullptr if there is no valid store with the given key at @path,
+  // including when the file is truncated or corrupt.
+  static std::unique_ptr<WeightsStore> Open(const std::string& path,
+                                            const std::string& key);
+
+  // The weights file with only the format and version information.
+  WeightsFile GetWeightsFileStub() const;
+  const std::vector<std::span<const float>>& tensors() const {
+    return tensors_;
+  }
+  const std::vector<int64_t>& ints() const { return ints_; }
+
+ private:
+  WeightsStore(std::unique_ptr<MappedFile> file) : file_(std::move(file)) {}
+
+  std::unique_ptr<MappedFile> file_;
+  std::string_view stub_;
+  std::vector<std::span<const float>> tensors_;
+  std::vector<int64_t> ints_;
+};
+
+// Collects tensors and integers, and atomically publishes them as a store.
+class WeightsStoreWriter {
+ public:
+  // The tensor has to stay alive until Publish().
+  void AddTensor(std::span<const float> tensor) { tensors_.push_back(tensor); }
+  void AddInt(int64_t value) { ints_.push_back(value); }
+  const std::vector<std::span<const float>>& tensors() const {
+    return tensors_;
+  }
+  const std::vector<int64_t>& ints() const { return ints_; }
+
+  // Writes a temporary file and renames it to @path, so that readers never see
+  // a partially written store. Throws on errors.
+  void Publish(const std::string& path, const std::string& key,
+               const WeightsFile& weights) const;
+
+ private:
+  std::vector<std::span<const float>> tensors_;
+  std::vector<int64_t> ints_;
+};
+
+// Returns the key of a store for the weights file at @weights_path, converted
+// by @backend with @backend_options. Uses a hash of the contents of the weights
+// file, so that the key follows the weights rather than their path, and the
+// lc0 version, as the layout of the tensors may change between versions. The
+// whole weights file is read and hashed on every call, also when a store with
+// this key exists, so the cost grows with the size of the weights file (it is
+// still much cheaper than decompressing and converting it).
+std::string GetWeightsStoreKey(const std::string& weights_path,
+                               const std::string& backend,
+                               const std::string& backend_options);
+
+// Returns the path of the store with @key in the weights cache directory @dir.
+std::string GetWeightsCachePath(const std::string& dir,
+                                const std::string& backend,
+                                const std::string& key);
+
+}  // namespace lczero
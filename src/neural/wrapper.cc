@@ -28,23 +28,18 @@
 #include "neural/wrapper.h"
 
 #include <algorithm>
-#include <numeric>
+#include <chrono>
 
+#include "neural/backend_util.h"
 #include "neural/encoder.h"
 #include "neural/shared_params.h"
+#include "neural/weights_store.h"
 #include "utils/atomic_vector.h"
-#include "utils/fastmath.h"
+#include "utils/filesystem.h"
 
 namespace lczero {
 namespace {
 
-FillEmptyHistory EncodeHistoryFill(std::string history_fill) {
-  if (history_fill == "fen_only") return FillEmptyHistory::FEN_ONLY;
-  if (history_fill == "always") return FillEmptyHistory::ALWAYS;
-  assert(history_fill == "no");
-  return FillEmptyHistory::NO;
-}
-
 class NetworkAsBackend : public Backend {
  public:
   NetworkAsBackend(std::unique_ptr<Network> network, const OptionsDict& options)
@@ -125,32 +120,14 @@ class NetworkAsBackendComputation : public BackendComputation {
       if (result.q) *result.q = computation_->GetQVal(i);
       if (result.d) *result.d = computation_->GetDVal(i);
       if (result.m) *result.m = computation_->GetMVal(i);
-      if (!result.p.empty()) SoftmaxPolicy(result.p, computation_.get(), i);
+      if (!result.p.empty()) {
+        SoftmaxPolicy(result.p, *computation_, i, entries_[i].legal_moves,
+                      entries_[i].transform,
+                      backend_->softmax_policy_temperature_);
+      }
     }
   }
 
-  void SoftmaxPolicy(std::span<float> dst,
-                     const NetworkComputation* computation, int idx) {
-    const std::vector<Move>& moves = entries_[idx].legal_moves;
-    const int transform = entries_[idx].transform;
-    // Copy the values to the destination array and compute the maximum.
-    const float max_p = std::accumulate(
-        moves.begin(), moves.end(), -std::numeric_limits<float>::infinity(),
-        [&, counter = 0](float max_p, const Move& move) mutable {
-          return std::max(max_p, dst[counter++] = computation->GetPVal(
-                                     idx, MoveToNNIndex(move, transform)));
-        });
-    // Compute the softmax and compute the total.
-    const float temperature = backend_->softmax_policy_temperature_;
-    float total = std::accumulate(
-        dst.begin(), dst.end(), 0.0f, [&](float total, float& val) {
-          return total + (val = FastExp((val - max_p) * temperature));
-        });
-    const float scale = total > 0.0f ? 1.0f / total : 1.0f;
-    // Scale the values to sum to 1.0.
-    std::for_each(dst.begin(), dst.end(), [&](float& val) { val *= scale; });
-  }
-
  private:
   struct Entry {
     InputPlanes input;
@@ -172,8 +149,12 @@ std::unique_ptr<BackendComputation> NetworkAsBackend::CreateComputation() {
 
 NetworkAsBackendFactory::NetworkAsBackendFactory(const std::string& name,
                                                  FactoryFunc factory,
-                                                 int priority)
-    : name_(name), factory_(factory), priority_(priority) {}
+                                                 int priority,
+                                                 bool supports_weights_store)
+    : name_(name),
+      factory_(factory),
+      priority_(priority),
+      supports_weights_store_(supports_weights_store) {}
 
 std::unique_ptr<Backend> NetworkAsBackendFactory::Create(
     const OptionsDict& options) {
@@ -184,10 +165,61 @@ std::unique_ptr<Backend> NetworkAsBackendFactory::Create(
 
   std::string net_path =
       options.Get<std::string>(SharedBackendParams::kWeightsId);
-  std::optional<WeightsFile> weights = LoadWeights(net_path);
+  std::optional<WeightsFile> weights;
+  // Backends which publish converted weights to a weights store only need the
+  // format of the weights file once the store exists. The store is either
+  // given in the backend options or kept in the weights cache directory.
+  OptionsDict store_options;
+  store_options.AddSubdictFromString(backend_options);
+  auto store_path =
+      store_options.GetOrDefault<std::string>("weights_store", "");
+  auto cache_dir =
+      options.Get<std::string>(SharedBackendParams::kWeightsCacheDirId);
+  if (!supports_weights_store_) {
+    if (!store_path.empty()) {
+      throw Exception("Backend " + name_ +
+                      " doesn't support the weights_store option.");
+    }
+    if (!cache_dir.empty()) {
+      CERR << "Backend " << name_ << " doesn't support the weights cache.";
+      cache_dir.clear();
+    }
+  }
+  bool use_cache = false;
+  std::string store_key;
+  if ((!store_path.empty() || !cache_dir.empty()) &&
+      net_path != SharedBackendParams::kEmbed) {
+    if (net_path == SharedBackendParams::kAutoDiscover) {
+      net_path = DiscoverWeightsFile();
+    }
+    if (!net_path.empty()) {
+      store_key = GetWeightsStoreKey(net_path, name_, backend_options);
+      if (store_path.empty()) {
+        use_cache = true;
+        CreateDirectory(cache_dir);
+        store_path = GetWeightsCachePath(cache_dir, name_, store_key);
+        network_options.Set<std::string>("weights_store", store_path);
+      }
+      network_options.Set<std::string>("weights_store_key", store_key);
+      // To load the weights again if the store is replaced in the meantime.
+      network_options.Set<std::string>("weights_store_source", net_path);
+      if (auto store = WeightsStore::Open(store_path, store_key)) {
+        weights = store->GetWeightsFileStub();
+      }
+    }
+  }
+  const bool from_store = weights.has_value();
+  if (!from_store) weights = LoadWeights(net_path);
+  const auto start = std::chrono::steady_clock::now();
   std::unique_ptr<Network> network =
       factory_(std::move(weights), network_options);
+  if (use_cache) CERR << "Weights cache entry: " << store_path;
   network_options.CheckAllOptionsRead(name_);
+  CERR << "Backend " << name_ << " initialized in "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count()
+       << "ms.";
   return std::make_unique<NetworkAsBackend>(std::move(network), options);
 }
 
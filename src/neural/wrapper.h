@@ -40,8 +40,11 @@ class NetworkAsBackendFactory : public BackendFactory {
   using FactoryFunc = std::function<std::unique_ptr<Network>(
       const std::optional<WeightsFile>&, const OptionsDict&)>;
 
+  // @supports_weights_store tells whether the network understands the
+  // weights_store options, and so can use the weights cache.
   NetworkAsBackendFactory(const std::string& name, FactoryFunc factory,
-                          int priority = 0);
+                          int priority = 0,
+                          bool supports_weights_store = false);
 
   int GetPriority() const override { return priority_; }
   std::string_view GetName() const override { return name_; }
@@ -51,6 +54,7 @@ class NetworkAsBackendFactory : public BackendFactory {
   std::string name_;
   FactoryFunc factory_;
   int priority_;
+  bool supports_weights_store_;
 };
 
 }  // namespace lczero
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+
+#include "search/classic/batch_controller.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace lczero {
+namespace classic {
+namespace {
+// Iterations measured before each decision.
+constexpr int kIterationsPerStep = 16;
+// Relative change of the size per step.
+constexpr float kSizeStep = 1.25f;
+// Nodes per second gain needed to move on to a new size, so that noise
+// doesn't make the size wander.
+constexpr float kMinGain = 0.02f;
+}  // namespace
+
+MinibatchController::MinibatchController(int initial_size, int min_size,
+                                         int max_size,
+                                         float target_latency_ms)
+    : initial_size_(std::clamp(initial_size, min_size, max_size)),
+      min_size_(min_size),
+      max_size_(max_size),
+      target_latency_ms_(target_latency_ms),
+      size_(initial_size_),
+      base_size_(initial_size_),
+      smallest_size_(initial_size_),
+      largest_size_(initial_size_) {}
+
+int MinibatchController::StepSize(int size, int direction) const {
+  int result = static_cast<int>(
+      std::round(direction > 0 ? size * kSizeStep : size / kSizeStep));
+  if (result == size) result += direction;
+  return std::clamp(result, min_size_, max_size_);
+}
+
+bool MinibatchController::AddIteration(int nodes, int batch_size,
+                                       float gather_ms, float nn_ms,
+                                       float backup_ms) {
+  auto& stats = latency_stats_[std::bit_floor(
+      static_cast<unsigned>(std::max(batch_size, 1)))];
+  ++stats.iterations;
+  stats.batch_size += batch_size;
+  stats.gather_ms += gather_ms;
+  stats.nn_ms += nn_ms;
+  stats.backup_ms += backup_ms;
+
+  ++step_iterations_;
+  step_nodes_ += nodes;
+  step_ms_ += gather_ms + nn_ms + backup_ms;
+  if (step_iterations_ < kIterationsPerStep) return false;
+  const int old_size = size_;
+  EndStep();
+  step_iterations_ = 0;
+  step_nodes_ = 0;
+  step_ms_ = 0.0;
+  if (size_ == old_size) return false;
+  ++changes_;
+  smallest_size_ = std::min(smallest_size_, size_);
+  largest_size_ = std::max(largest_size_, size_);
+  return true;
+}
+
+void MinibatchController::EndStep() {
+  if (step_ms_ <= 0.0) return;
+  if (target_latency_ms_ > 0.0f) {
+    // Assumes the latency grows about linearly with the size.
+    const float latency_ms = step_ms_ / step_iterations_;
+    const float factor =
+        std::clamp(target_latency_ms_ / latency_ms, 1.0f / kSizeStep, kSizeStep);
+    size_ = std::clamp(static_cast<int>(std::round(size_ * factor)), min_size_,
+                       max_size_);
+    return;
+  }
+  const float nps = step_nodes_ * 1000.0 / step_ms_;
+  if (probing_ && nps > base_nps_ * (1.0f + kMinGain)) {
+    // The new size is better, try one more step the same way.
+    base_size_ = size_;
+    base_nps_ = nps;
+    size_ = StepSize(size_, direction_);
+    if (size_ == base_size_) probing_ = false;
+    return;
+  }
+  if (probing_) {
+    // Go back and measure the base size again, as nodes per second drift
+    // while the tree grows. Try the other way next time.
+    size_ = base_size_;
+    direction_ = -direction_;
+    probing_ = false;
+    return;
+  }
+  base_size_ = size_;
+  base_nps_ = nps;
+  size_ = StepSize(size_, direction_);
+  if (size_ == base_size_) {
+    direction_ = -direction_;
+    size_ = StepSize(size_, direction_);
+  }
+  probing_ = size_ != base_size_;
+}
+
+std::vector<std::string> MinibatchController::GetReport() const {
+  std::vector<std::string> lines;
+  std::ostringstream oss;
+  oss << "Adaptive minibatch: size " << initial_size_ << " -> " << size_
+      << " after " << changes_ << " changes, range " << smallest_size_ << ".."
+      << largest_size_;
+  if (target_latency_ms_ > 0.0f) {
+    oss << ", target latency " << target_latency_ms_ << "ms";
+  }
+  lines.push_back(oss.str());
+  for (const auto& [bucket, stats] : latency_stats_) {
+    std::ostringstream line;
+    const double n = stats.iterations;
+    line << std::fixed << std::setprecision(2) << "  NN batch " << bucket
+         << ".." << 2 * bucket - 1 << ": " << stats.iterations
+         << " iterations, avg batch " << std::setprecision(1)
+         << stats.batch_size / n << std::setprecision(2) << ", gather "
+         << stats.gather_ms / n << "ms, NN " << stats.nn_ms / n
+         << "ms, backup " << stats.backup_ms / n << "ms";
+    lines.push_back(line.str());
+  }
+  return lines;
+}
+
+}  // namespace classic
+}  // namespace lczero
@@ -0,0 +1,99 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace lczero {
+namespace classic {
+
+// Tunes the minibatch size of a search worker while it searches. It measures
+// the worker's iterations in steps of a few iterations. Without a target
+// latency it hill-climbs on nodes per second: it measures the current size,
+// then a size one step larger or smaller, keeps going while that helps, and
+// turns around when it doesn't. With a target latency it scales the size
+// towards the one whose iterations take that long.
+class MinibatchController {
+ public:
+  // Starts from @initial_size and stays within [@min_size, @max_size].
+  // @target_latency_ms of 0 means to maximize nodes per second.
+  MinibatchController(int initial_size, int min_size, int max_size,
+                      float target_latency_ms);
+
+  int GetSize() const { return size_; }
+
+  // Records an iteration which finished @nodes playouts, @batch_size of which
+  // went to the backend. Returns whether the size changed.
+  bool AddIteration(int nodes, int batch_size, float gather_ms, float nn_ms,
+                    float backup_ms);
+
+  // Lines describing the decisions and the latencies measured per batch size.
+  std::vector<std::string> GetReport() const;
+
+ private:
+  void EndStep();
+  // Returns the size one step away in @direction, within the bounds.
+  int StepSize(int size, int direction) const;
+
+  const int initial_size_;
+  const int min_size_;
+  const int max_size_;
+  const float target_latency_ms_;
+  int size_;
+
+  // Hill climbing state: the size being compared against and its nodes per
+  // second, and whether the current step tries a new size.
+  int base_size_;
+  float base_nps_ = 0.0f;
+  bool probing_ = false;
+  int direction_ = 1;
+
+  // The step in progress.
+  int step_iterations_ = 0;
+  int64_t step_nodes_ = 0;
+  double step_ms_ = 0.0;
+
+  int changes_ = 0;
+  int smallest_size_;
+  int largest_size_;
+  struct LatencyStats {
+    int64_t iterations = 0;
+    int64_t batch_size = 0;
+    double gather_ms = 0.0;
+    double nn_ms = 0.0;
+    double backup_ms = 0.0;
+  };
+  // Keyed by the backend batch size rounded down to a power of two.
+  std::map<int, LatencyStats> latency_stats_;
+};
+
+}  // namespace classic
+}  // namespace lczero
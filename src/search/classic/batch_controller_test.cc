@@ -0,0 +1,127 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "search/classic/batch_controller.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace lczero {
+namespace classic {
+namespace {
+
+// Iterations the controller measures before each decision.
+constexpr int kIterationsPerStep = 16;
+
+// Runs @steps steps of iterations which take @latency_ms(size) milliseconds,
+// three quarters of their nodes going to the backend. Returns the size chosen
+// after each step.
+std::vector<int> RunSteps(MinibatchController* controller, int steps,
+                          const std::function<float(int)>& latency_ms) {
+  std::vector<int> sizes;
+  for (int i = 0; i < steps; i++) {
+    const int size = controller->GetSize();
+    const float ms = latency_ms(size);
+    for (int j = 0; j < kIterationsPerStep; j++) {
+      const bool changed = controller->AddIteration(size, size * 3 / 4,
+                                                    0.1f * ms, 0.8f * ms,
+                                                    0.1f * ms);
+      EXPECT_EQ(changed, controller->GetSize() != size);
+      if (j < kIterationsPerStep - 1) EXPECT_FALSE(changed);
+    }
+    sizes.push_back(controller->GetSize());
+  }
+  return sizes;
+}
+
+}  // namespace
+
+TEST(MinibatchController, ReachesTargetLatency) {
+  MinibatchController controller(32, 1, 256, 10.0f);
+  // Half a millisecond per node.
+  const auto sizes =
+      RunSteps(&controller, 10, [](int size) { return 0.5f * size; });
+  // At most a step of 1.25 per decision.
+  EXPECT_EQ(sizes[0], 26);
+  EXPECT_EQ(sizes.back(), 20);
+  EXPECT_EQ(controller.GetReport()[0],
+            "Adaptive minibatch: size 32 -> 20 after 3 changes, range 20..32, "
+            "target latency 10ms");
+}
+
+TEST(MinibatchController, ClampsTargetLatencyToLimits) {
+  const auto latency_ms = [](int size) { return 0.5f * size; };
+  MinibatchController slow(32, 8, 64, 1.0f);
+  EXPECT_EQ(RunSteps(&slow, 20, latency_ms).back(), 8);
+  MinibatchController fast(32, 8, 64, 1000.0f);
+  EXPECT_EQ(RunSteps(&fast, 20, latency_ms).back(), 64);
+  // The initial size is clamped too.
+  EXPECT_EQ(MinibatchController(500, 8, 64, 0.0f).GetSize(), 64);
+}
+
+TEST(MinibatchController, ClimbsToBestNodesPerSecond) {
+  MinibatchController controller(16, 1, 256, 0.0f);
+  // Nodes per second peak at size 50.
+  const auto sizes = RunSteps(&controller, 40, [](int size) {
+    return 5.0f + 0.002f * size * size;
+  });
+  // Once there, it keeps returning to the best size between probes.
+  const std::vector<int> last(sizes.end() - 10, sizes.end());
+  EXPECT_EQ(std::count(last.begin(), last.end(), 49), 5);
+  EXPECT_GE(*std::min_element(last.begin(), last.end()), 39);
+  EXPECT_LE(*std::max_element(last.begin(), last.end()), 61);
+}
+
+TEST(MinibatchController, ClimbsToLimits) {
+  // Larger batches are always faster per node. At the limit it alternates
+  // between the largest size and probing a smaller one.
+  MinibatchController up(16, 8, 40, 0.0f);
+  const auto up_sizes =
+      RunSteps(&up, 20, [](int size) { return 5.0f + 0.01f * size; });
+  EXPECT_EQ(*std::max_element(up_sizes.begin(), up_sizes.end()), 40);
+  EXPECT_EQ(up_sizes.end()[-2], 32);
+  EXPECT_EQ(up_sizes.back(), 40);
+
+  // Smaller batches are always faster per node.
+  MinibatchController down(16, 8, 40, 0.0f);
+  const auto down_sizes =
+      RunSteps(&down, 20, [](int size) { return 0.02f * size * size; });
+  EXPECT_EQ(*std::min_element(down_sizes.begin(), down_sizes.end()), 8);
+  EXPECT_EQ(down_sizes.end()[-2], 10);
+  EXPECT_EQ(down_sizes.back(), 8);
+}
+
+}  // namespace classic
+}  // namespace lczero
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -31,6 +31,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -39,6 +40,7 @@
 #include "neural/network.h"
 #include "utils/exception.h"
 #include "utils/hashcat.h"
+#include "utils/logging.h"
 
 namespace lczero {
 namespace classic {
@@ -202,18 +204,46 @@ Node* Node::CreateSingleChildNode(Move move) {
   return child_.get();
 }
 
-void Node::CreateEdges(const MoveList& moves) {
+void Node::CreateEdges(const MoveList& moves, bool index_children) {
   assert(!edges_);
   assert(!child_);
   edges_ = Edge::FromMovelist(moves);
   num_edges_ = moves.size();
+  indexed_children_ = index_children;
+}
+
+Node* Node::GetOrSpawnIndexedChild(uint16_t index) {
+  assert(indexed_children_);
+  assert(index < num_edges_);
+  if (!child_) {
+    // The index is only allocated with the first child, as most nodes with
+    // edges never get any.
+    child_.reset(reinterpret_cast<Node*>(new Node*[num_edges_]()));
+  }
+  Node*& child = child_index()[index];
+  if (!child) child = new Node(this, index);
+  return child;
+}
+
+void Node::UnindexChildren() {
+  if (!indexed_children_) return;
+  indexed_children_ = false;
+  Node** index = reinterpret_cast<Node**>(child_.release());
+  if (!index) return;
+  for (int i = num_edges_ - 1; i >= 0; --i) {
+    if (!index[i]) continue;
+    std::unique_ptr<Node> child(index[i]);
+    child->sibling_ = std::move(child_);
+    child_ = std::move(child);
+  }
+  delete[] index;
 }
 
 Node::ConstIterator Node::Edges() const {
-  return {*this, !solid_children_ ? &child_ : nullptr};
+  return {*this, !solid_children_ && !indexed_children_ ? &child_ : nullptr};
 }
 Node::Iterator Node::Edges() {
-  return {*this, !solid_children_ ? &child_ : nullptr};
+  return {*this, !solid_children_ && !indexed_children_ ? &child_ : nullptr};
 }
 
 float Node::GetVisitedPolicy() const {
@@ -238,7 +268,8 @@ std::string Node::DebugString() const {
       << " WL:" << wl_ << " N:" << n_ << " N_:" << n_in_flight_
       << " Edges:" << static_cast<int>(num_edges_)
       << " Bounds:" << static_cast<int>(lower_bound_) - 2 << ","
-      << static_cast<int>(upper_bound_) - 2 << " Solid:" << solid_children_;
+      << static_cast<int>(upper_bound_) - 2 << " Solid:" << solid_children_
+      << " Indexed:" << indexed_children_;
   return oss.str();
 }
 
@@ -246,19 +277,23 @@ bool Node::MakeSolid() {
   if (solid_children_ || num_edges_ == 0 || IsTerminal()) return false;
   // Can only make solid if no immediate leaf children are in flight since we
   // allow the search code to hold references to leaf nodes across locks.
-  Node* old_child_to_check = child_.get();
   uint32_t total_in_flight = 0;
-  while (old_child_to_check != nullptr) {
-    if (old_child_to_check->GetN() <= 1 &&
-        old_child_to_check->GetNInFlight() > 0) {
-      return false;
+  const auto can_move = [&total_in_flight](const Node* child) {
+    if (child->GetN() <= 1 && child->GetNInFlight() > 0) return false;
+    if (child->IsTerminal() && child->GetNInFlight() > 0) return false;
+    total_in_flight += child->GetNInFlight();
+    return true;
+  };
+  if (indexed_children_) {
+    for (int i = 0; child_ && i < num_edges_; i++) {
+      const Node* child = child_index()[i];
+      if (child && !can_move(child)) return false;
     }
-    if (old_child_to_check->IsTerminal() &&
-        old_child_to_check->GetNInFlight() > 0) {
-      return false;
+  } else {
+    for (const Node* child = child_.get(); child != nullptr;
+         child = child->sibling_.get()) {
+      if (!can_move(child)) return false;
     }
-    total_in_flight += old_child_to_check->GetNInFlight();
-    old_child_to_check = old_child_to_check->sibling_.get();
   }
   // If the total of children in flight is not the same as self, then there are
   // collisions against immediate children (which don't update the GetNInFlight
@@ -266,6 +301,7 @@ bool Node::MakeSolid() {
   if (total_in_flight != GetNInFlight()) {
     return false;
   }
+  UnindexChildren();
   std::allocator<Node> alloc;
   auto* new_children = alloc.allocate(num_edges_);
   for (int i = 0; i < num_edges_; i++) {
@@ -392,7 +428,11 @@ void Node::RevertTerminalVisits(float v, float d, float m, int multivisit) {
 }
 
 void Node::UpdateChildrenParents() {
-  if (!solid_children_) {
+  if (indexed_children_) {
+    for (int i = 0; child_ && i < num_edges_; i++) {
+      if (child_index()[i]) child_index()[i]->parent_ = this;
+    }
+  } else if (!solid_children_) {
     Node* cur_child = child_.get();
     while (cur_child != nullptr) {
       cur_child->parent_ = this;
@@ -407,10 +447,12 @@ void Node::UpdateChildrenParents() {
 }
 
 void Node::ReleaseChildren() {
+  UnindexChildren();
   gNodeGc.AddToGcQueue(std::move(child_), solid_children_ ? num_edges_ : 0);
 }
 
 void Node::ReleaseChildrenExceptOne(Node* node_to_save) {
+  UnindexChildren();
   if (solid_children_) {
     std::unique_ptr<Node> saved_node;
     if (node_to_save != nullptr) {
@@ -491,6 +533,11 @@ void NodeTree::TrimTreeAtHead() {
 }
 
 bool NodeTree::ResetToPosition(const GameState& pos) {
+  if (subtree_pool_size_ > 0 && current_head_ && current_head_->GetN() > 0 &&
+      !IsOnPathToHead(pos)) {
+    PoolCurrentHead();
+  }
+
   if (gamebegin_node_ && (history_.Starting() != pos.startpos)) {
     // Completely different position.
     DeallocateTree();
@@ -516,6 +563,7 @@ bool NodeTree::ResetToPosition(const GameState& pos) {
   // retain old n_ and q_ (etc) data, even though its old children were
   // previously trimmed; we need to reset current_head_ in that case.
   if (!seen_old_head) TrimTreeAtHead();
+  ReattachPooledSubtree();
   return seen_old_head;
 }
 
@@ -534,6 +582,278 @@ bool NodeTree::ResetToPosition(const std::string& starting_fen,
   return ResetToPosition(state);
 }
 
+bool NodeTree::IsOnPathToHead(const GameState& pos) const {
+  if (!gamebegin_node_ || history_.Starting() != pos.startpos) return false;
+  const Node* node = gamebegin_node_.get();
+  for (const Move m : pos.moves) {
+    if (node == current_head_) return true;
+    const Node* next = nullptr;
+    for (const auto& edge : node->Edges()) {
+      if (edge.GetMove() == m) {
+        next = edge.node();
+        break;
+      }
+    }
+    if (!next) return false;
+    node = next;
+  }
+  return node == current_head_;
+}
+
+void NodeTree::PoolCurrentHead() {
+  auto subtree = std::make_unique<Node>(nullptr, 0);
+  auto sibling = std::move(current_head_->sibling_);
+  *subtree = std::move(*current_head_);
+  *current_head_ = Node(subtree->parent_, subtree->index_);
+  current_head_->sibling_ = std::move(sibling);
+  subtree->parent_ = nullptr;
+  subtree->UpdateChildrenParents();
+
+  const uint64_t key = GetHistoryKey();
+  std::erase_if(subtree_pool_, [&](PooledSubtree& entry) {
+    if (entry.key != key) return false;
+    pooled_nodes_ -= entry.node->GetN();
+    gNodeGc.AddToGcQueue(std::move(entry.node));
+    return true;
+  });
+  pooled_nodes_ += subtree->GetN();
+  subtree_pool_.push_front({key, std::move(subtree)});
+  SetSubtreePoolSize(subtree_pool_size_);
+}
+
+bool NodeTree::ReattachPooledSubtree() {
+  if (subtree_pool_.empty()) return false;
+  const uint64_t key = GetHistoryKey();
+  auto iter = std::find_if(
+      subtree_pool_.begin(), subtree_pool_.end(),
+      [&](const PooledSubtree& entry) { return entry.key == key; });
+  if (iter == subtree_pool_.end()) return false;
+  std::unique_ptr<Node> subtree = std::move(iter->node);
+  subtree_pool_.erase(iter);
+  pooled_nodes_ -= subtree->GetN();
+  // The tree may have been reused, keep whichever has more visits.
+  if (subtree->GetN() <= current_head_->GetN()) {
+    gNodeGc.AddToGcQueue(std::move(subtree));
+    return false;
+  }
+  if (current_head_->HasChildren()) TrimTreeAtHead();
+
+  subtree->parent_ = current_head_->parent_;
+  subtree->index_ = current_head_->index_;
+  subtree->sibling_ = std::move(current_head_->sibling_);
+  *current_head_ = std::move(*subtree);
+  current_head_->UpdateChildrenParents();
+  LOGFILE << "Reattached pooled subtree of " << current_head_->GetN()
+          << " visits.";
+  return true;
+}
+
+void NodeTree::SetSubtreePoolSize(size_t size) {
+  subtree_pool_size_ = size;
+  while (subtree_pool_.size() > subtree_pool_size_) DropOldestPooledSubtree();
+}
+
+void NodeTree::ShrinkSubtreePool(uint64_t max_nodes) {
+  while (pooled_nodes_ > max_nodes) DropOldestPooledSubtree();
+}
+
+void NodeTree::DropOldestPooledSubtree() {
+  pooled_nodes_ -= subtree_pool_.back().node->GetN();
+  gNodeGc.AddToGcQueue(std::move(subtree_pool_.back().node));
+  subtree_pool_.pop_back();
+}
+
+namespace {
+// Snapshot file layout, in native byte order:
+//   header: magic, version, key of the position history;
+//   nodes in preorder, each: index in parent, N, WL, D, M, flags, number of
+//     edges, edges (move and compressed P as in memory), number of children;
+//   trailer: number of nodes, magic.
+constexpr char kSnapshotMagic[8] = {'L', 'c', '0', 'T', 'r', 'e', 'e', '\0'};
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr size_t kSnapshotBufferSize = 1 << 20;
+static_assert(std::is_trivially_copyable_v<Edge>);
+
+// Flags byte of a node record.
+constexpr int kTerminalShift = 0;
+constexpr int kLowerBoundShift = 2;
+constexpr int kUpperBoundShift = 4;
+constexpr uint8_t kSolidChildrenFlag = 1 << 6;
+
+template <typename T>
+void Write(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T Read(std::istream& in) {
+  T value;
+  if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+    throw Exception("Tree snapshot is truncated.");
+  }
+  return value;
+}
+}  // namespace
+
+void NodeTree::SaveSnapshot(const std::string& filename) const {
+  if (!current_head_) throw Exception("No search tree to save.");
+  std::vector<char> buffer(kSnapshotBufferSize);
+  std::ofstream out;
+  out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  out.open(filename, std::ios::binary | std::ios::trunc);
+  if (!out) throw Exception("Unable to create " + filename);
+  out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+  Write(out, kSnapshotVersion);
+  Write(out, GetHistoryKey());
+
+  uint64_t nodes = 0;
+  std::vector<const Node*> stack = {current_head_};
+  std::vector<const Node*> children;
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+    // Unvisited children carry no information (solid arrays have all of them).
+    children.clear();
+    for (const auto& edge : node->Edges()) {
+      const Node* child = edge.node();
+      if (child && (child->GetN() > 0 || child->IsTerminal())) {
+        children.push_back(child);
+      }
+    }
+    Write(out, static_cast<uint16_t>(node == current_head_ ? 0 : node->index_));
+    Write(out, node->n_);
+    Write(out, node->wl_);
+    Write(out, node->d_);
+    Write(out, node->m_);
+    Write(out, static_cast<uint8_t>(
+                   static_cast<int>(node->terminal_type_) << kTerminalShift |
+                   static_cast<int>(node->lower_bound_) << kLowerBoundShift |
+                   static_cast<int>(node->upper_bound_) << kUpperBoundShift |
+                   (node->solid_children_ ? kSolidChildrenFlag : 0)));
+    Write(out, node->num_edges_);
+    out.write(reinterpret_cast<const char*>(node->edges_.get()),
+              node->num_edges_ * sizeof(Edge));
+    Write(out, static_cast<uint8_t>(children.size()));
+    stack.insert(stack.end(), children.rbegin(), children.rend());
+    ++nodes;
+  }
+  Write(out, nodes);
+  out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+  out.close();
+  if (!out) throw Exception("Unable to write " + filename);
+  LOGFILE << "Saved " << nodes << " nodes to " << filename;
+}
+
+void NodeTree::LoadSnapshot(const std::string& filename) {
+  if (!current_head_) throw Exception("No position to load the tree for.");
+  std::vector<char> buffer(kSnapshotBufferSize);
+  std::ifstream in;
+  in.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+  in.open(filename, std::ios::binary);
+  if (!in) throw Exception("Unable to open " + filename);
+  char magic[sizeof(kSnapshotMagic)];
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 ||
+      Read<uint32_t>(in) != kSnapshotVersion) {
+    throw Exception(filename + " is not a tree snapshot.");
+  }
+  if (Read<uint64_t>(in) != GetHistoryKey()) {
+    throw Exception("Tree snapshot " + filename +
+                    " is for a different position.");
+  }
+
+  // Reads the next node record into @node, returns its number of children.
+  const auto read_node = [&in](Node* node) {
+    node->n_ = Read<uint32_t>(in);
+    node->wl_ = Read<double>(in);
+    node->d_ = Read<float>(in);
+    node->m_ = Read<float>(in);
+    const uint8_t flags = Read<uint8_t>(in);
+    node->terminal_type_ =
+        static_cast<Node::Terminal>((flags >> kTerminalShift) & 3);
+    node->lower_bound_ =
+        static_cast<GameResult>((flags >> kLowerBoundShift) & 3);
+    node->upper_bound_ =
+        static_cast<GameResult>((flags >> kUpperBoundShift) & 3);
+    node->num_edges_ = Read<uint8_t>(in);
+    if (node->num_edges_ > 0) {
+      node->edges_ = std::make_unique<Edge[]>(node->num_edges_);
+      if (!in.read(reinterpret_cast<char*>(node->edges_.get()),
+                   node->num_edges_ * sizeof(Edge))) {
+        throw Exception("Tree snapshot is truncated.");
+      }
+    }
+    const int children = Read<uint8_t>(in);
+    if (children > node->num_edges_) {
+      throw Exception("Tree snapshot is corrupted.");
+    }
+    // Children go to a solid array if they were in one when saved.
+    if (children > 0 && (flags & kSolidChildrenFlag)) {
+      std::allocator<Node> alloc;
+      auto* array = alloc.allocate(node->num_edges_);
+      for (int i = 0; i < node->num_edges_; i++) {
+        new (&(array[i])) Node(node, i);
+      }
+      node->child_ = std::unique_ptr<Node>(array);
+      node->solid_children_ = true;
+    }
+    return children;
+  };
+
+  // The children of a node still to be read.
+  struct Pending {
+    Node* node;
+    int children;
+    // Where the next child goes, for non-solid children.
+    std::unique_ptr<Node>* tail;
+    // Children are saved in edge order, which a sibling list relies on.
+    int last_index = -1;
+  };
+  TrimTreeAtHead();
+  try {
+    Read<uint16_t>(in);
+    std::vector<Pending> stack;
+    if (int children = read_node(current_head_)) {
+      stack.push_back({current_head_, children, &current_head_->child_});
+    }
+    uint64_t nodes = 1;
+    while (!stack.empty()) {
+      Pending& parent = stack.back();
+      if (parent.children == 0) {
+        stack.pop_back();
+        continue;
+      }
+      --parent.children;
+      const uint16_t index = Read<uint16_t>(in);
+      if (index >= parent.node->num_edges_ || index <= parent.last_index) {
+        throw Exception("Tree snapshot is corrupted.");
+      }
+      parent.last_index = index;
+      Node* node;
+      if (parent.node->solid_children_) {
+        node = parent.node->child_.get() + index;
+      } else {
+        *parent.tail = std::make_unique<Node>(parent.node, index);
+        node = parent.tail->get();
+        parent.tail = &node->sibling_;
+      }
+      if (int children = read_node(node)) {
+        stack.push_back({node, children, &node->child_});
+      }
+      ++nodes;
+    }
+    char magic[sizeof(kSnapshotMagic)];
+    if (Read<uint64_t>(in) != nodes || !in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0) {
+      throw Exception("Tree snapshot is corrupted.");
+    }
+    LOGFILE << "Loaded " << nodes << " nodes from " << filename;
+  } catch (...) {
+    TrimTreeAtHead();
+    throw;
+  }
+}
+
 void NodeTree::DeallocateTree() {
   // Same as gamebegin_node_.reset(), but actual deallocation will happen in
   // GC thread.
@@ -30,6 +30,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <mutex>
 
@@ -54,6 +55,10 @@ namespace classic {
 //   solid_children_ is true. If the children have been 'solidified' their
 //   sibling links are unused and left empty. In this state there are no
 //   dangling edges, but the nodes may not have ever received any visits.
+//   Or, if indexed_children_ is true, they are stored individually but are
+//   owned by an array of pointers indexed like edges (nullptr for dangling
+//   edges), so that finding the child of an edge doesn't walk the list. Their
+//   sibling links are unused then too.
 //
 // Example:
 //                                Parent Node
@@ -138,7 +143,8 @@ class Node {
         terminal_type_(Terminal::NonTerminal),
         lower_bound_(GameResult::BLACK_WON),
         upper_bound_(GameResult::WHITE_WON),
-        solid_children_(false) {}
+        solid_children_(false),
+        indexed_children_(false) {}
 
   // We have a custom destructor, but its behavior does not need to be emulated
   // during move operations so default is fine.
@@ -150,7 +156,10 @@ class Node {
   Node* CreateSingleChildNode(Move m);
 
   // Creates edges from a movelist. There has to be no edges before that.
-  void CreateEdges(const MoveList& moves);
+  // With @index_children, children will be kept in an array indexed like the
+  // edges rather than in a list (8 bytes per edge of nodes which have
+  // children).
+  void CreateEdges(const MoveList& moves, bool index_children = false);
 
   // Gets parent node.
   Node* GetParent() const { return parent_; }
@@ -260,6 +269,7 @@ class Node {
   uint16_t Index() const { return index_; }
 
   ~Node() {
+    if (indexed_children_) UnindexChildren();
     if (solid_children_ && child_) {
       // As a hack, solid_children is actually storing an array in here, release
       // so we can correctly invoke the array delete.
@@ -275,6 +285,17 @@ class Node {
   // For each child, ensures that its parent pointer is pointing to this.
   void UpdateChildrenParents();
 
+  // Array of children indexed like edges, if indexed_children_. nullptr if no
+  // child has been spawned yet.
+  Node** child_index() const { return reinterpret_cast<Node**>(child_.get()); }
+  Node* GetIndexedChild(uint16_t index) const {
+    return child_ ? child_index()[index] : nullptr;
+  }
+  Node* GetOrSpawnIndexedChild(uint16_t index);
+  // Moves indexed children to the sibling list, which is what the code
+  // reshaping the tree works with.
+  void UnindexChildren();
+
   // To minimize the number of padding bytes and to avoid having unnecessary
   // padding when new fields are added, we arrange the fields by size, largest
   // to smallest.
@@ -293,7 +314,8 @@ class Node {
   // Pointer to a parent node. nullptr for the root.
   Node* parent_ = nullptr;
   // Pointer to a first child. nullptr for a leaf node.
-  // As a 'hack' actually a unique_ptr to Node[] if solid_children.
+  // As a 'hack' actually a unique_ptr to Node[] if solid_children, or to
+  // Node*[] if indexed_children.
   std::unique_ptr<Node> child_;
   // Pointer to a next sibling. nullptr if there are no further siblings.
   // Also null in the solid case.
@@ -328,6 +350,9 @@ class Node {
   GameResult upper_bound_ : 2;
   // Whether the child_ is actually an array of equal length to edges.
   bool solid_children_ : 1;
+  // Whether the child_ is actually an array of pointers to children, of equal
+  // length to edges.
+  bool indexed_children_ : 1;
 
   // TODO(mooskagh) Unfriend NodeTree.
   friend class NodeTree;
@@ -449,13 +474,18 @@ class Edge_Iterator : public EdgeAndNode {
   Edge_Iterator() {}
 
   // Creates "begin()" iterator. Also happens to be a range constructor.
-  // child_ptr will be nullptr if parent_node is solid children.
+  // child_ptr will be nullptr if parent_node is solid or indexed children.
   Edge_Iterator(const Node& parent_node, Ptr child_ptr)
       : EdgeAndNode(parent_node.edges_.get(), nullptr),
         node_ptr_(child_ptr),
+        indexed_parent_(parent_node.indexed_children_ ? &parent_node
+                                                      : nullptr),
         total_count_(parent_node.num_edges_) {
-    if (edge_ && child_ptr != nullptr) Actualize();
-    if (edge_ && child_ptr == nullptr) {
+    if (edge_ && indexed_parent_) {
+      node_ = indexed_parent_->GetIndexedChild(0);
+    } else if (edge_ && child_ptr != nullptr) {
+      Actualize();
+    } else if (edge_) {
       node_ = parent_node.child_.get();
     }
   }
@@ -472,7 +502,11 @@ class Edge_Iterator : public EdgeAndNode {
       edge_ = nullptr;
     } else {
       ++edge_;
-      if (node_ptr_ != nullptr) {
+      if (indexed_parent_) {
+        // The index is read again as the first child may have been spawned
+        // since.
+        node_ = indexed_parent_->GetIndexedChild(current_idx_);
+      } else if (node_ptr_ != nullptr) {
         Actualize();
       } else {
         ++node_;
@@ -484,6 +518,11 @@ class Edge_Iterator : public EdgeAndNode {
   // If there is node, return it. Otherwise spawn a new one and return it.
   Node* GetOrSpawnNode(Node* parent) {
     if (node_) return node_;  // If there is already a node, return it.
+    if (indexed_parent_) {
+      assert(indexed_parent_ == parent);
+      node_ = parent->GetOrSpawnIndexedChild(current_idx_);
+      return node_;
+    }
     // Should never reach here in solid mode.
     assert(node_ptr_ != nullptr);
     Actualize();              // But maybe other thread already did that.
@@ -536,6 +575,8 @@ class Edge_Iterator : public EdgeAndNode {
   // Pointer to a pointer to the next node. Has to be a pointer to pointer
   // as we'd like to update it when spawning a new node.
   Ptr node_ptr_;
+  // The parent node, if it keeps its children indexed.
+  const Node* indexed_parent_ = nullptr;
   uint16_t current_idx_ = 0;
   uint16_t total_count_ = 0;
 };
@@ -561,6 +602,14 @@ class VisitedNode_Iterator {
       : node_ptr_(child_ptr),
         total_count_(parent_node.num_edges_),
         solid_(parent_node.solid_children_) {
+    if (parent_node.indexed_children_) {
+      index_ = parent_node.child_index();
+      node_ptr_ = index_ ? index_[0] : nullptr;
+      if (index_ && (node_ptr_ == nullptr || node_ptr_->GetN() == 0)) {
+        operator++();
+      }
+      return;
+    }
     if (node_ptr_ != nullptr && node_ptr_->GetN() == 0) {
       operator++();
     }
@@ -580,7 +629,20 @@ class VisitedNode_Iterator {
   // Functions to support iterator interface.
   // Equality comparison operators are inherited from EdgeAndNode.
   void operator++() {
-    if (solid_) {
+    if (index_) {
+      // Same as the list case below, except that dangling edges are skipped.
+      node_ptr_ = nullptr;
+      while (++current_idx_ != total_count_) {
+        Node* node = index_[current_idx_];
+        if (node == nullptr) continue;
+        if (node->GetN() > 0) {
+          node_ptr_ = node;
+        } else if (node->GetNInFlight() > 0) {
+          continue;
+        }
+        break;
+      }
+    } else if (solid_) {
       while (++current_idx_ != total_count_ &&
              node_ptr_[current_idx_].GetN() == 0) {
         if (node_ptr_[current_idx_].GetNInFlight() == 0) {
@@ -621,6 +683,8 @@ class VisitedNode_Iterator {
  private:
   // Pointer to current node.
   Node* node_ptr_ = nullptr;
+  // Children of the parent, if it keeps them indexed.
+  Node* const* index_ = nullptr;
   uint16_t current_idx_ = 0;
   uint16_t total_count_ = 0;
   bool solid_ = false;
@@ -635,7 +699,10 @@ inline VisitedNode_Iterator<false> Node::VisitedNodes() {
 
 class NodeTree {
  public:
-  ~NodeTree() { DeallocateTree(); }
+  ~NodeTree() {
+    SetSubtreePoolSize(0);
+    DeallocateTree();
+  }
   // Adds a move to current_head_.
   void MakeMove(Move move);
   // Resets the current head to ensure it doesn't carry over details from a
@@ -657,13 +724,51 @@ class NodeTree {
   Node* GetGameBeginNode() const { return gamebegin_node_.get(); }
   const PositionHistory& GetPositionHistory() const { return history_; }
 
+  // Keeps the subtrees of up to @size positions which ResetToPosition() moved
+  // away from, to reattach them when it returns to the same position with the
+  // same history. 0 disables the pool.
+  void SetSubtreePoolSize(size_t size);
+  // Drops least recently used subtrees until the pool holds at most
+  // @max_nodes visits.
+  void ShrinkSubtreePool(uint64_t max_nodes);
+  // Number of visits in the pooled subtrees.
+  uint64_t GetPooledNodes() const { return pooled_nodes_; }
+
+  // Writes the tree from the current head to a file. No search may run.
+  void SaveSnapshot(const std::string& filename) const;
+  // Replaces the tree at the current head with one saved by SaveSnapshot()
+  // for the same position and history. Throws if the snapshot doesn't match.
+  void LoadSnapshot(const std::string& filename);
+
  private:
+  struct PooledSubtree {
+    uint64_t key;
+    std::unique_ptr<Node> node;
+  };
+
   void DeallocateTree();
+  // Returns whether current_head_ is on the path to @pos, i.e. whether
+  // ResetToPosition(pos) will reuse the tree.
+  bool IsOnPathToHead(const GameState& pos) const;
+  // Moves the subtree of current_head_ to the pool, leaving the head empty.
+  void PoolCurrentHead();
+  // Moves the pooled subtree of the current position, if any, to
+  // current_head_ unless that has more visits already.
+  bool ReattachPooledSubtree();
+  void DropOldestPooledSubtree();
+  uint64_t GetHistoryKey() const {
+    return history_.HashLast(history_.GetLength());
+  }
+
   // A node which to start search from.
   Node* current_head_ = nullptr;
   // Root node of a game tree.
   std::unique_ptr<Node> gamebegin_node_;
   PositionHistory history_;
+  // Detached subtrees, most recently used first.
+  std::list<PooledSubtree> subtree_pool_;
+  size_t subtree_pool_size_ = 0;
+  uint64_t pooled_nodes_ = 0;
 };
 
 }  // namespace classic
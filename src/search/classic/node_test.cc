@@ -0,0 +1,242 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "search/classic/node.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "chess/board.h"
+#include "utils/exception.h"
+
+namespace lczero {
+namespace classic {
+namespace {
+
+void AddVisit(Node* node, float v) {
+  ASSERT_TRUE(node->TryStartScoreUpdate());
+  node->FinalizeScoreUpdate(v, 0.0f, 1.0f, 1);
+}
+
+Node* SpawnChild(Node* node, int edge_index) {
+  for (auto& edge : node->Edges()) {
+    if (edge_index-- == 0) return edge.GetOrSpawnNode(node);
+  }
+  return nullptr;
+}
+
+// Returns the moves, visits and values of a subtree in preorder.
+std::string DumpTree(const Node* node) {
+  std::string result = std::to_string(node->GetN()) + ":" +
+                       std::to_string(node->GetWL()) + "(";
+  for (const auto& edge : node->Edges()) {
+    const Node* child = edge.node();
+    if (!child || child->GetN() == 0) continue;
+    result += edge.GetMove().ToString(false) + "=" + DumpTree(child) + " ";
+  }
+  return result + ")";
+}
+
+std::string ReadFile(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void WriteFile(const std::string& filename, const std::string& content) {
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  out << content;
+}
+
+class NodeTreeSnapshot : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    filename_ = ::testing::TempDir() + "lc0_node_test.tree";
+    tree_.ResetToPosition(ChessBoard::kStartposFen, {});
+    // Head with visits to edges 1 and 5, the latter with a visited child.
+    Node* head = tree_.GetCurrentHead();
+    ChessBoard board = tree_.HeadPosition().GetBoard();
+    head->CreateEdges(board.GenerateLegalMoves());
+    AddVisit(SpawnChild(head, 1), 0.25f);
+    Node* child = SpawnChild(head, 5);
+    ChessBoard child_board = board;
+    child_board.ApplyMove(head->GetEdgeToNode(child)->GetMove());
+    child_board.Mirror();
+    child->CreateEdges(child_board.GenerateLegalMoves());
+    AddVisit(SpawnChild(child, 0), 0.5f);
+    AddVisit(child, -0.5f);
+    for (int i = 0; i < 4; i++) AddVisit(head, 0.125f);
+    head_edges_ = head->GetNumEdges();
+  }
+
+  void TearDown() override { std::remove(filename_.c_str()); }
+
+  // Returns the file offset of the index of the head's @n-th saved child.
+  size_t ChildIndexOffset(int n) const {
+    constexpr size_t kHeaderSize = 8 + 4 + 8;
+    // Index, N, WL, D, M, flags, number of edges, edges, number of children.
+    constexpr size_t kNodeSize = 2 + 4 + 8 + 4 + 4 + 1 + 1 + 1;
+    const size_t head_size = kNodeSize + head_edges_ * sizeof(Edge);
+    // The first child is a leaf.
+    return kHeaderSize + head_size + n * kNodeSize;
+  }
+
+  // A bad header leaves the tree as it was, bad nodes leave the head empty.
+  void ExpectLoadFails(bool keeps_tree) {
+    EXPECT_THROW(tree_.LoadSnapshot(filename_), Exception);
+    EXPECT_EQ(tree_.GetCurrentHead()->GetN(), keeps_tree ? 4u : 0u);
+    EXPECT_EQ(tree_.GetCurrentHead()->HasChildren(), keeps_tree);
+  }
+
+  NodeTree tree_;
+  std::string filename_;
+  int head_edges_;
+};
+
+TEST_F(NodeTreeSnapshot, RoundTrip) {
+  const std::string expected = DumpTree(tree_.GetCurrentHead());
+  tree_.SaveSnapshot(filename_);
+
+  NodeTree loaded;
+  loaded.ResetToPosition(ChessBoard::kStartposFen, {});
+  loaded.LoadSnapshot(filename_);
+  EXPECT_EQ(DumpTree(loaded.GetCurrentHead()), expected);
+  EXPECT_EQ(loaded.GetCurrentHead()->GetNumEdges(), 20);
+}
+
+TEST_F(NodeTreeSnapshot, DifferentPosition) {
+  tree_.SaveSnapshot(filename_);
+  NodeTree other;
+  other.ResetToPosition(ChessBoard::kStartposFen, {"e2e4"});
+  EXPECT_THROW(other.LoadSnapshot(filename_), Exception);
+  EXPECT_FALSE(other.GetCurrentHead()->HasChildren());
+}
+
+TEST_F(NodeTreeSnapshot, NotASnapshot) {
+  WriteFile(filename_, "This is not a tree snapshot at all.");
+  ExpectLoadFails(true);
+}
+
+TEST_F(NodeTreeSnapshot, Truncated) {
+  tree_.SaveSnapshot(filename_);
+  const std::string content = ReadFile(filename_);
+  WriteFile(filename_, content.substr(0, 10));
+  ExpectLoadFails(true);
+  for (size_t size : {ChildIndexOffset(1), content.size() - 1}) {
+    WriteFile(filename_, content.substr(0, size));
+    ExpectLoadFails(false);
+  }
+}
+
+TEST_F(NodeTreeSnapshot, ChildrenOutOfOrder) {
+  tree_.SaveSnapshot(filename_);
+  std::string content = ReadFile(filename_);
+  const auto set_index = [&](int n, uint16_t index) {
+    std::memcpy(&content[ChildIndexOffset(n)], &index, sizeof(index));
+    WriteFile(filename_, content);
+  };
+  // Swaps the indices of the two children.
+  set_index(0, 5);
+  set_index(1, 1);
+  ExpectLoadFails(false);
+  // The same child twice.
+  set_index(1, 5);
+  ExpectLoadFails(false);
+  // Still loads in the original order.
+  set_index(0, 1);
+  tree_.LoadSnapshot(filename_);
+  EXPECT_EQ(tree_.GetCurrentHead()->GetN(), 4u);
+}
+
+// Gives the head of @tree @visits visits, one of them to its first child.
+void SearchHead(NodeTree* tree, int visits) {
+  Node* head = tree->GetCurrentHead();
+  if (!head->HasChildren()) {
+    head->CreateEdges(tree->HeadPosition().GetBoard().GenerateLegalMoves());
+  }
+  AddVisit(SpawnChild(head, 0), 0.0f);
+  for (int i = 0; i < visits; i++) AddVisit(head, 0.0f);
+}
+
+TEST(NodeTreeSubtreePool, ReattachesSubtree) {
+  NodeTree tree;
+  tree.SetSubtreePoolSize(2);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"e2e4"});
+  SearchHead(&tree, 10);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"d2d4"});
+  EXPECT_EQ(tree.GetPooledNodes(), 10u);
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 0u);
+
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"e2e4"});
+  EXPECT_EQ(tree.GetPooledNodes(), 0u);
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 10u);
+  ASSERT_TRUE(tree.GetCurrentHead()->HasChildren());
+  EXPECT_EQ(tree.GetCurrentHead()->Edges().begin().node()->GetParent(),
+            tree.GetCurrentHead());
+}
+
+TEST(NodeTreeSubtreePool, EvictsLeastRecentlyUsed) {
+  NodeTree tree;
+  tree.SetSubtreePoolSize(2);
+  for (const char* move : {"e2e4", "d2d4", "c2c4"}) {
+    tree.ResetToPosition(ChessBoard::kStartposFen, {move});
+    SearchHead(&tree, 10);
+  }
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"g1f3"});
+  // Only the two most recent of the three subtrees are kept.
+  EXPECT_EQ(tree.GetPooledNodes(), 20u);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"e2e4"});
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 0u);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"d2d4"});
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 10u);
+
+  // Shrinking drops the oldest subtrees first.
+  SearchHead(&tree, 5);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"g1f3"});
+  EXPECT_EQ(tree.GetPooledNodes(), 25u);
+  tree.ShrinkSubtreePool(20);
+  EXPECT_EQ(tree.GetPooledNodes(), 15u);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"c2c4"});
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 0u);
+  tree.ResetToPosition(ChessBoard::kStartposFen, {"d2d4"});
+  EXPECT_EQ(tree.GetCurrentHead()->GetN(), 15u);
+}
+
+}  // namespace
+}  // namespace classic
+}  // namespace lczero
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  lczero::InitializeMagicBitboards();
+  return RUN_ALL_TESTS();
+}
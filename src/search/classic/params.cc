@@ -535,6 +535,35 @@ const OptionId SearchParams::kSolidTreeThresholdId{
     "solid-tree-threshold", "SolidTreeThreshold",
     "Only nodes with at least this number of visits will be considered for "
     "solidification for improved cache locality."};
+const OptionId SearchParams::kChildIndexId{
+    "child-index", "ChildIndex",
+    "Keep the children of nodes which are not solid yet in an array indexed "
+    "like the moves rather than in a linked list, so that selection doesn't "
+    "chase a pointer per child. Takes 8 more bytes per move of every node "
+    "with children."};
+const OptionId SearchParams::kAdaptiveMinibatchId{
+    "adaptive-minibatch", "AdaptiveMinibatch",
+    "Tune the minibatch size, and the collision and out of order budgets with "
+    "it, while searching, measuring how long gathering, NN computation and "
+    "backup take. Starts from MinibatchSize and carries over to the next "
+    "move. The decisions are written to the log."};
+const OptionId SearchParams::kTargetBatchLatencyId{
+    "target-batch-latency", "TargetBatchLatency",
+    "With AdaptiveMinibatch, tune the minibatch size for search iterations to "
+    "take this many milliseconds rather than for the most nodes per second. "
+    "0 to maximize nodes per second."};
+const OptionId SearchParams::kDeterministicSearchId{
+    "deterministic-search", "DeterministicSearch",
+    "Make the search tree depend only on the settings and the NN evaluations, "
+    "not on thread timing, for reproducible benchmarks. Search threads then "
+    "run their iterations one at a time in a fixed order, random choices use "
+    "SearchSeed, and heuristics based on timing, including smart pruning, "
+    "are off. Searches limited by time rather than nodes still stop at "
+    "different points."};
+const OptionId SearchParams::kSearchSeedId{
+    "search-seed", "SearchSeed",
+    "With DeterministicSearch, the seed of the random numbers used for noise "
+    "and temperature."};
 
 void BaseSearchParams::Populate(OptionsParser* options) {
   // Here the uci optimized defaults" are set.
@@ -632,6 +661,11 @@ void SearchParams::Populate(OptionsParser* options) {
   BaseSearchParams::Populate(options);
   options->Add<IntOption>(kMaxPrefetchBatchId, 0, 1024) = DEFAULT_MAX_PREFETCH;
   options->Add<IntOption>(kSolidTreeThresholdId, 1, 2000000000) = 100;
+  options->Add<BoolOption>(kChildIndexId) = false;
+  options->Add<BoolOption>(kAdaptiveMinibatchId) = false;
+  options->Add<FloatOption>(kTargetBatchLatencyId, 0.0f, 10000.0f) = 0.0f;
+  options->Add<BoolOption>(kDeterministicSearchId) = false;
+  options->Add<IntOption>(kSearchSeedId, 0, 2000000000) = 0;
 }
 
 BaseSearchParams::BaseSearchParams(const OptionsDict& options)
@@ -723,6 +757,11 @@ BaseSearchParams::BaseSearchParams(const OptionsDict& options)
 
 SearchParams::SearchParams(const OptionsDict& options)
     : BaseSearchParams(options),
-      kSolidTreeThreshold(options.Get<int>(kSolidTreeThresholdId)) {}
+      kSolidTreeThreshold(options.Get<int>(kSolidTreeThresholdId)),
+      kChildIndex(options.Get<bool>(kChildIndexId)),
+      kAdaptiveMinibatch(options.Get<bool>(kAdaptiveMinibatchId)),
+      kTargetBatchLatency(options.Get<float>(kTargetBatchLatencyId)),
+      kDeterministicSearch(options.Get<bool>(kDeterministicSearchId)),
+      kSearchSeed(options.Get<int>(kSearchSeedId)) {}
 }  // namespace classic
 }  // namespace lczero
@@ -299,13 +299,28 @@ class SearchParams : public BaseSearchParams {
     return options_.Get<int>(kMaxPrefetchBatchId);
   }
   int GetSolidTreeThreshold() const { return kSolidTreeThreshold; }
+  bool GetChildIndex() const { return kChildIndex; }
+  bool GetAdaptiveMinibatch() const { return kAdaptiveMinibatch; }
+  float GetTargetBatchLatency() const { return kTargetBatchLatency; }
+  bool GetDeterministicSearch() const { return kDeterministicSearch; }
+  int GetSearchSeed() const { return kSearchSeed; }
 
   // Search parameter IDs.
   static const OptionId kMaxPrefetchBatchId;
   static const OptionId kSolidTreeThresholdId;
+  static const OptionId kChildIndexId;
+  static const OptionId kAdaptiveMinibatchId;
+  static const OptionId kTargetBatchLatencyId;
+  static const OptionId kDeterministicSearchId;
+  static const OptionId kSearchSeedId;
 
  private:
   const int kSolidTreeThreshold;
+  const bool kChildIndex;
+  const bool kAdaptiveMinibatch;
+  const float kTargetBatchLatency;
+  const bool kDeterministicSearch;
+  const int kSearchSeed;
 };
 }  // namespace classic
 }  // namespace lczero
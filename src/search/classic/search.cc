@@ -39,6 +39,7 @@
 
 #include "neural/encoder.h"
 #include "search/classic/node.h"
+#include "utils/cpu_features.h"
 #include "utils/fastmath.h"
 #include "utils/random.h"
 #include "utils/spinhelper.h"
@@ -49,6 +50,8 @@ namespace classic {
 namespace {
 // Maximum delay between outputting "uci info" when nothing interesting happens.
 const int kUciInfoMinimumFrequencyMs = 5000;
+// Maximum age of the PVs in the root snapshot while the best move is the same.
+const int kRootPvRefreshMs = 100;
 
 MoveList MakeRootMoveFilter(const MoveList& searchmoves,
                             SyzygyTablebase* syzygy_tb,
@@ -87,7 +90,8 @@ class MEvaluator {
         q_threshold_{0.0f},
         parent_m_{0.0f} {}
 
-  MEvaluator(const SearchParams& params, const Node* parent = nullptr)
+  template <typename NodeT = Node>
+  MEvaluator(const SearchParams& params, const NodeT* parent = nullptr)
       : enabled_{true},
         m_slope_{params.GetMovesLeftSlope()},
         m_cap_{params.GetMovesLeftMaxEffect()},
@@ -110,16 +114,7 @@ class MEvaluator {
   // Calculates the utility for favoring shorter wins and longer losses.
   float GetMUtility(Node* child, float q) const {
     if (!enabled_ || !parent_within_threshold_) return 0.0f;
-    const float child_m = child->GetM();
-    float m = std::clamp(m_slope_ * (child_m - parent_m_), -m_cap_, m_cap_);
-    m *= FastSign(-q);
-    if (q_threshold_ > 0.0f && q_threshold_ < 1.0f) {
-      // This allows a smooth M effect with higher q thresholds, which is
-      // necessary for using MLH together with contempt.
-      q = std::max(0.0f, (std::abs(q) - q_threshold_)) / (1.0f - q_threshold_);
-    }
-    m *= a_constant_ + a_linear_ * std::abs(q) + a_square_ * q * q;
-    return m;
+    return ComputeMUtility(child->GetM(), q);
   }
 
   float GetMUtility(const EdgeAndNode& child, float q) const {
@@ -128,11 +123,30 @@ class MEvaluator {
     return GetMUtility(child.node(), q);
   }
 
+  float GetMUtility(const EdgeStats& child, float q) const {
+    if (!enabled_ || !parent_within_threshold_) return 0.0f;
+    if (child.GetN() == 0) return GetDefaultMUtility();
+    return ComputeMUtility(child.m, q);
+  }
+
   // The M utility to use for unvisited nodes.
   float GetDefaultMUtility() const { return 0.0f; }
 
  private:
-  static bool WithinThreshold(const Node* parent, float q_threshold) {
+  float ComputeMUtility(float child_m, float q) const {
+    float m = std::clamp(m_slope_ * (child_m - parent_m_), -m_cap_, m_cap_);
+    m *= FastSign(-q);
+    if (q_threshold_ > 0.0f && q_threshold_ < 1.0f) {
+      // This allows a smooth M effect with higher q thresholds, which is
+      // necessary for using MLH together with contempt.
+      q = std::max(0.0f, (std::abs(q) - q_threshold_)) / (1.0f - q_threshold_);
+    }
+    m *= a_constant_ + a_linear_ * std::abs(q) + a_square_ * q * q;
+    return m;
+  }
+
+  template <typename NodeT>
+  static bool WithinThreshold(const NodeT* parent, float q_threshold) {
     return std::abs(parent->GetQ(0.0f)) > q_threshold;
   }
 
@@ -147,6 +161,65 @@ class MEvaluator {
   bool parent_within_threshold_ = false;
 };
 
+// Keeps GCC from fully unrolling the short lane loops below, which stops it
+// from vectorizing them.
+#if defined(__GNUC__)
+#define LCZERO_LANE_LOOP _Pragma("GCC unroll 1")
+#else
+#define LCZERO_LANE_LOOP
+#endif
+
+// Computes the PUCT score of @n children from their scratch arrays.
+LCZERO_CPU_DISPATCH
+void ComputePuctScores(const float* pol, const float* util, const int* nstarted,
+                       float puct_mult, int n, float* scores) {
+  for (int i = 0; i < n; ++i) {
+    scores[i] = pol[i] * puct_mult / (1 + nstarted[i]) + util[i];
+  }
+}
+
+// Returns the index of the first of the highest of @n (> 0) scores, and writes
+// the second highest score (which may equal the highest one) to @second, or
+// lowest() when n is 1. Keeps one running maximum per lane, so that the loops
+// vectorize without reassociating float comparisons.
+LCZERO_CPU_DISPATCH
+int SelectTopTwo(const float* scores, int n, float* second) {
+  constexpr int kLanes = 8;
+  constexpr float kLowest = std::numeric_limits<float>::lowest();
+  const int tail = n - n % kLanes;
+  float lanes[kLanes];
+  std::fill(std::begin(lanes), std::end(lanes), kLowest);
+  for (int i = 0; i < tail; i += kLanes) {
+    LCZERO_LANE_LOOP
+    for (int l = 0; l < kLanes; ++l) {
+      const float score = scores[i + l];
+      lanes[l] = score > lanes[l] ? score : lanes[l];
+    }
+  }
+  float best = kLowest;
+  for (int l = 0; l < kLanes; ++l) best = std::max(best, lanes[l]);
+  for (int i = tail; i < n; ++i) best = std::max(best, scores[i]);
+  const int best_idx = std::find(scores, scores + n, best) - scores;
+
+  std::fill(std::begin(lanes), std::end(lanes), kLowest);
+  for (int i = 0; i < tail; i += kLanes) {
+    LCZERO_LANE_LOOP
+    for (int l = 0; l < kLanes; ++l) {
+      const float score = scores[i + l];
+      const float masked = i + l == best_idx ? kLowest : score;
+      lanes[l] = masked > lanes[l] ? masked : lanes[l];
+    }
+  }
+  *second = kLowest;
+  for (int l = 0; l < kLanes; ++l) *second = std::max(*second, lanes[l]);
+  for (int i = tail; i < n; ++i) {
+    if (i != best_idx) *second = std::max(*second, scores[i]);
+  }
+  return best_idx;
+}
+
+#undef LCZERO_LANE_LOOP
+
 }  // namespace
 
 Search::Search(const NodeTree& tree, Backend* backend,
@@ -175,6 +248,9 @@ Search::Search(const NodeTree& tree, Backend* backend,
     pending_searchers_.store(params_.GetMaxConcurrentSearchers(),
                              std::memory_order_release);
   }
+  if (params_.GetDeterministicSearch()) {
+    seeded_random_ = std::make_unique<Random>(params_.GetSearchSeed());
+  }
   contempt_mode_ = params_.GetContemptMode();
   // Make sure the contempt mode is never "play" beyond this point.
   if (contempt_mode_ == ContemptMode::PLAY) {
@@ -196,15 +272,18 @@ Search::Search(const NodeTree& tree, Backend* backend,
                            : ContemptMode::WHITE;
     }
   }
+  SharedMutex::Lock lock(nodes_mutex_);
+  PublishRootSnapshot();
 }
 
 namespace {
-void ApplyDirichletNoise(Node* node, float eps, double alpha) {
+void ApplyDirichletNoise(Node* node, float eps, double alpha,
+                         Random* random) {
   float total = 0;
   std::vector<float> noise;
 
   for (int i = 0; i < node->GetNumEdges(); ++i) {
-    float eta = Random::Get().GetGamma(alpha, 1.0);
+    float eta = random->GetGamma(alpha, 1.0);
     noise.emplace_back(eta);
     total += eta;
   }
@@ -258,9 +337,15 @@ inline double WDLRescale(float& v, float& d, float wdl_rescale_ratio,
 }
 }  // namespace
 
-void Search::SendUciInfo() REQUIRES(nodes_mutex_) REQUIRES(counters_mutex_) {
+std::vector<ThinkingInfo> Search::GetUciInfo(const RootSnapshot& snapshot)
+    REQUIRES(counters_mutex_) {
   const auto max_pv = params_.GetMultiPv();
-  const auto edges = GetBestChildrenNoTemperature(root_node_, max_pv, 0);
+  const NodeStats& root = snapshot.root;
+  std::vector<const EdgeStats*> edges;
+  for (int idx : snapshot.best_edges) {
+    if (static_cast<int>(edges.size()) == max_pv) break;
+    edges.push_back(&root.edges[idx]);
+  }
   const auto score_type = params_.GetScoreType();
   const auto per_pv_counters = params_.GetPerPvCounters();
   const auto draw_score = GetDrawScore(false);
@@ -269,11 +354,13 @@ void Search::SendUciInfo() REQUIRES(nodes_mutex_) REQUIRES(counters_mutex_) {
 
   // Info common for all multipv variants.
   ThinkingInfo common_info;
-  common_info.depth = cum_depth_ / (total_playouts_ ? total_playouts_ : 1);
-  common_info.seldepth = max_depth_;
+  const int64_t total_playouts = snapshot.total_playouts;
+  common_info.depth =
+      snapshot.cum_depth / (total_playouts ? total_playouts : 1);
+  common_info.seldepth = snapshot.max_depth;
   common_info.time = GetTimeSinceStart();
   if (!per_pv_counters) {
-    common_info.nodes = total_playouts_ + initial_visits_;
+    common_info.nodes = total_playouts + snapshot.initial_visits;
   }
   if (nps_start_time_) {
     const auto time_since_first_batch_ms =
@@ -281,16 +368,17 @@ void Search::SendUciInfo() REQUIRES(nodes_mutex_) REQUIRES(counters_mutex_) {
             std::chrono::steady_clock::now() - *nps_start_time_)
             .count();
     if (time_since_first_batch_ms > 0) {
-      common_info.nps = total_playouts_ * 1000 / time_since_first_batch_ms;
+      common_info.nps = total_playouts * 1000 / time_since_first_batch_ms;
     }
   }
   common_info.tb_hits = tb_hits_.load(std::memory_order_acquire);
 
   int multipv = 0;
-  const auto default_q = -root_node_->GetQ(-draw_score);
-  const auto default_wl = -root_node_->GetWL();
-  const auto default_d = root_node_->GetD();
-  for (const auto& edge : edges) {
+  const auto default_q = -root.GetQ(-draw_score);
+  const auto default_wl = -root.GetWL();
+  const auto default_d = root.GetD();
+  for (const EdgeStats* edge_stats : edges) {
+    const EdgeStats& edge = *edge_stats;
     ++multipv;
     uci_infos.emplace_back(common_info);
     auto& uci_info = uci_infos.back();
@@ -357,51 +445,55 @@ void Search::SendUciInfo() REQUIRES(nodes_mutex_) REQUIRES(counters_mutex_) {
     uci_info.wdl = ThinkingInfo::WDL{wdl_w, wdl_d, wdl_l};
     if (backend_attributes_.has_mlh) {
       uci_info.moves_left = static_cast<int>(
-          (1.0f + edge.GetM(1.0f + root_node_->GetM())) / 2.0f);
+          (1.0f + edge.GetM(1.0f + root.GetM())) / 2.0f);
     }
     if (max_pv > 1) uci_info.multipv = multipv;
     if (per_pv_counters) uci_info.nodes = edge.GetN();
     bool flip = played_history_.IsBlackToMove();
-    int depth = 0;
-    for (auto iter = edge; iter;
-         iter = GetBestChildNoTemperature(iter.node(), depth), flip = !flip) {
-      uci_info.pv.push_back(iter.GetMove(flip));
-      if (!iter.node()) break;  // Last edge was dangling, cannot continue.
-      depth += 1;
+    for (Move move : edge.pv) {
+      if (flip) move.Flip();
+      uci_info.pv.push_back(move);
+      flip = !flip;
     }
   }
 
   if (!uci_infos.empty()) last_outputted_uci_info_ = uci_infos.front();
-  if (current_best_edge_ && !edges.empty()) {
-    last_outputted_info_edge_ = current_best_edge_.edge();
+  if (snapshot.best_edge && !edges.empty()) {
+    last_outputted_info_edge_ = snapshot.best_edge;
   }
-
-  uci_responder_->OutputThinkingInfo(&uci_infos);
+  return uci_infos;
 }
 
 // Decides whether anything important changed in stats and new info should be
 // shown to a user.
 void Search::MaybeOutputInfo() {
-  SharedMutex::Lock lock(nodes_mutex_);
   Mutex::Lock counters_lock(counters_mutex_);
-  if (!bestmove_is_sent_ && current_best_edge_ &&
-      (current_best_edge_.edge() != last_outputted_info_edge_ ||
-       last_outputted_uci_info_.depth !=
-           static_cast<int>(cum_depth_ /
-                            (total_playouts_ ? total_playouts_ : 1)) ||
-       last_outputted_uci_info_.seldepth != max_depth_ ||
-       last_outputted_uci_info_.time + kUciInfoMinimumFrequencyMs <
-           GetTimeSinceStart())) {
-    SendUciInfo();
-    if (params_.GetLogLiveStats()) {
-      SendMovesStats();
-    }
-    if (stop_.load(std::memory_order_acquire) && !ok_to_respond_bestmove_) {
-      std::vector<ThinkingInfo> info(1);
-      info.back().comment =
-          "WARNING: Search has reached limit and does not make any progress.";
-      uci_responder_->OutputThinkingInfo(&info);
+  if (bestmove_is_sent_) return;
+  std::vector<ThinkingInfo> uci_infos;
+  {
+    auto snapshot = root_snapshot_.Read();
+    const int64_t total_playouts = snapshot->total_playouts;
+    if (!snapshot->best_edge ||
+        (snapshot->best_edge == last_outputted_info_edge_ &&
+         last_outputted_uci_info_.depth ==
+             static_cast<int>(snapshot->cum_depth /
+                              (total_playouts ? total_playouts : 1)) &&
+         last_outputted_uci_info_.seldepth == snapshot->max_depth &&
+         last_outputted_uci_info_.time + kUciInfoMinimumFrequencyMs >=
+             GetTimeSinceStart())) {
+      return;
     }
+    uci_infos = GetUciInfo(*snapshot);
+  }
+  uci_responder_->OutputThinkingInfo(&uci_infos);
+  if (params_.GetLogLiveStats()) {
+    SendMovesStats();
+  }
+  if (stop_.load(std::memory_order_acquire) && !ok_to_respond_bestmove_) {
+    std::vector<ThinkingInfo> info(1);
+    info.back().comment =
+        "WARNING: Search has reached limit and does not make any progress.";
+    uci_responder_->OutputThinkingInfo(&info);
   }
 }
 
@@ -426,8 +518,9 @@ float Search::GetDrawScore(bool is_odd_depth) const {
 }
 
 namespace {
-inline float GetFpu(const SearchParams& params, Node* node, bool is_root_node,
-                    float draw_score) {
+template <typename NodeT>
+inline float GetFpu(const SearchParams& params, const NodeT* node,
+                    bool is_root_node, float draw_score) {
   const auto value = params.GetFpuValue(is_root_node);
   return params.GetFpuAbsolute(is_root_node)
              ? value
@@ -453,25 +546,63 @@ inline float ComputeCpuct(const SearchParams& params, uint32_t N,
 }
 }  // namespace
 
-std::vector<std::string> Search::GetVerboseStats(Node* node) const {
-  assert(node == root_node_ || node->GetParent() == root_node_);
-  const bool is_root = (node == root_node_);
+void NodeStats::CopyFrom(const Node* node) {
+  n = node->GetN();
+  n_in_flight = node->GetNInFlight();
+  wl = node->GetWL();
+  d = node->GetD();
+  m = node->GetM();
+  is_terminal = node->IsTerminal();
+  bounds = node->GetBounds();
+  // Even if edges are populated, it's a race condition to access them before
+  // the first visit finished.
+  if (n == 0 || !node->HasChildren()) {
+    visited_policy = 0.0f;
+    edges.clear();
+    return;
+  }
+  visited_policy = node->GetVisitedPolicy();
+  edges.resize(node->GetNumEdges());
+  auto stats = edges.begin();
+  for (const auto& edge : node->Edges()) {
+    stats->move = edge.GetMove();
+    stats->p = edge.GetP();
+    stats->has_node = edge.HasNode();
+    stats->n = edge.GetN();
+    stats->n_in_flight = edge.GetNInFlight();
+    stats->wl = stats->has_node ? edge.node()->GetWL() : 0.0f;
+    stats->d = stats->has_node ? edge.node()->GetD() : 0.0f;
+    stats->m = stats->has_node ? edge.node()->GetM() : 0.0f;
+    stats->is_terminal = edge.IsTerminal();
+    stats->is_tb_terminal = edge.IsTbTerminal();
+    stats->bounds = edge.GetBounds();
+    stats->pv.clear();
+    ++stats;
+  }
+}
+
+std::vector<std::string> Search::GetVerboseStats(
+    const NodeStats& node, bool is_root,
+    const PositionHistory& history) const {
   const bool is_odd_depth = !is_root;
   const bool is_black_to_move = (played_history_.IsBlackToMove() == is_root);
   const float draw_score = GetDrawScore(is_odd_depth);
-  const float fpu = GetFpu(params_, node, is_root, draw_score);
-  const float cpuct = ComputeCpuct(params_, node->GetN(), is_root);
+  const float fpu = GetFpu(params_, &node, is_root, draw_score);
+  const float cpuct = ComputeCpuct(params_, node.GetN(), is_root);
   const float U_coeff =
-      cpuct * std::sqrt(std::max(node->GetChildrenVisits(), 1u));
-  std::vector<EdgeAndNode> edges;
-  for (const auto& edge : node->Edges()) edges.push_back(edge);
+      cpuct * std::sqrt(std::max(node.GetChildrenVisits(), 1u));
+  std::vector<const EdgeStats*> edges;
+  for (const auto& edge : node.edges) edges.push_back(&edge);
 
   std::sort(edges.begin(), edges.end(),
-            [&fpu, &U_coeff, &draw_score](EdgeAndNode a, EdgeAndNode b) {
+            [&fpu, &U_coeff, &draw_score](const EdgeStats* a,
+                                          const EdgeStats* b) {
               return std::forward_as_tuple(
-                         a.GetN(), a.GetQ(fpu, draw_score) + a.GetU(U_coeff)) <
+                         a->GetN(),
+                         a->GetQ(fpu, draw_score) + a->GetU(U_coeff)) <
                      std::forward_as_tuple(
-                         b.GetN(), b.GetQ(fpu, draw_score) + b.GetU(U_coeff));
+                         b->GetN(),
+                         b->GetQ(fpu, draw_score) + b->GetU(U_coeff));
             });
 
   auto print = [](auto* oss, auto pre, auto v, auto post, auto w, int p = 0) {
@@ -486,11 +617,11 @@ std::vector<std::string> Search::GetVerboseStats(Node* node) const {
     print(oss, "(+", f, ") ", 2);
     print(oss, "(P: ", p * 100, "%) ", 5, p >= 0.99995f ? 1 : 2);
   };
-  auto print_stats = [&](auto* oss, const auto* n) {
-    const auto sign = n == node ? -1 : 1;
+  // @n is the node itself with @sign -1, or a child with a node with @sign 1.
+  auto print_stats = [&](auto* oss, const auto* n, int sign) {
     if (n) {
-      auto wl = sign * n->GetWL();
-      auto d = n->GetD();
+      auto wl = sign * n->wl;
+      auto d = n->d;
       auto is_perspective = ((contempt_mode_ == ContemptMode::BLACK) ==
                              played_history_.IsBlackToMove())
                                 ? 1.0f
@@ -503,22 +634,24 @@ std::vector<std::string> Search::GetVerboseStats(Node* node) const {
           is_perspective, true, params_.GetWDLMaxS());
       print(oss, "(WL: ", wl, ") ", 8, 5);
       print(oss, "(D: ", d, ") ", 5, 3);
-      print(oss, "(M: ", n->GetM(), ") ", 4, 1);
+      print(oss, "(M: ", n->m, ") ", 4, 1);
       print(oss, "(Q: ", wl + draw_score * d, ") ", 8, 5);
     } else {
       *oss << "(WL:  -.-----) (D: -.---) (M:  -.-) ";
       print(oss, "(Q: ", fpu, ") ", 8, 5);
     }
   };
-  auto print_tail = [&](auto* oss, const auto* n) {
-    const auto sign = n == node ? -1 : 1;
+  // @move leads from the node to the child, if it's the child.
+  auto print_tail = [&](auto* oss, const auto* n, int sign,
+                        std::optional<Move> move) {
     std::optional<float> v;
-    if (n && n->IsTerminal()) {
-      v = n->GetQ(sign * draw_score);
+    if (n && n->is_terminal) {
+      v = n->wl + sign * draw_score * n->d;
     } else if (n) {
-      auto history = GetPositionHistoryAtNode(n);
+      PositionHistory n_history(history);
+      if (move) n_history.Append(*move);
       std::optional<EvalResult> nneval = backend_->GetCachedEvaluation(
-          EvalPosition{history.GetPositions(), {}});
+          EvalPosition{n_history.GetPositions(), {}});
       if (nneval) v = -nneval->q;
     }
     if (v) {
@@ -528,7 +661,7 @@ std::vector<std::string> Search::GetVerboseStats(Node* node) const {
     }
 
     if (n) {
-      auto [lo, up] = n->GetBounds();
+      auto [lo, up] = n->bounds;
       if (sign == -1) {
         lo = -lo;
         up = -up;
@@ -543,35 +676,40 @@ std::vector<std::string> Search::GetVerboseStats(Node* node) const {
 
   std::vector<std::string> infos;
   const auto m_evaluator =
-      backend_attributes_.has_mlh ? MEvaluator(params_, node) : MEvaluator();
-  for (const auto& edge : edges) {
-    float Q = edge.GetQ(fpu, draw_score);
-    float M = m_evaluator.GetMUtility(edge, Q);
+      backend_attributes_.has_mlh ? MEvaluator(params_, &node) : MEvaluator();
+  for (const EdgeStats* edge : edges) {
+    float Q = edge->GetQ(fpu, draw_score);
+    float M = m_evaluator.GetMUtility(*edge, Q);
+    const EdgeStats* child = edge->has_node ? edge : nullptr;
     std::ostringstream oss;
     oss << std::left;
     // TODO: should this be displaying transformed index?
-    print_head(&oss, edge.GetMove(is_black_to_move).ToString(true),
-               MoveToNNIndex(edge.GetMove(), 0), edge.GetN(),
-               edge.GetNInFlight(), edge.GetP());
-    print_stats(&oss, edge.node());
-    print(&oss, "(U: ", edge.GetU(U_coeff), ") ", 6, 5);
-    print(&oss, "(S: ", Q + edge.GetU(U_coeff) + M, ") ", 8, 5);
-    print_tail(&oss, edge.node());
+    print_head(&oss, edge->GetMove(is_black_to_move).ToString(true),
+               MoveToNNIndex(edge->GetMove(), 0), edge->GetN(),
+               edge->GetNInFlight(), edge->GetP());
+    print_stats(&oss, child, 1);
+    print(&oss, "(U: ", edge->GetU(U_coeff), ") ", 6, 5);
+    print(&oss, "(S: ", Q + edge->GetU(U_coeff) + M, ") ", 8, 5);
+    print_tail(&oss, child, 1, edge->move);
     infos.emplace_back(oss.str());
   }
 
   // Include stats about the node in similar format to its children above.
   std::ostringstream oss;
-  print_head(&oss, "node ", node->GetNumEdges(), node->GetN(),
-             node->GetNInFlight(), node->GetVisitedPolicy());
-  print_stats(&oss, node);
-  print_tail(&oss, node);
+  print_head(&oss, "node ", node.edges.size(), node.GetN(),
+             node.GetNInFlight(), node.GetVisitedPolicy());
+  print_stats(&oss, &node, -1);
+  print_tail(&oss, &node, -1, std::nullopt);
   infos.emplace_back(oss.str());
   return infos;
 }
 
 void Search::SendMovesStats() const REQUIRES(counters_mutex_) {
-  auto move_stats = GetVerboseStats(root_node_);
+  std::vector<std::string> move_stats;
+  {
+    auto snapshot = root_snapshot_.Read();
+    move_stats = GetVerboseStats(snapshot->root, true, played_history_);
+  }
 
   if (params_.GetVerboseStats()) {
     std::vector<ThinkingInfo> infos;
@@ -586,29 +724,25 @@ void Search::SendMovesStats() const REQUIRES(counters_mutex_) {
     LOGFILE << "=== Move stats:";
     for (const auto& line : move_stats) LOGFILE << line;
   }
-  for (auto& edge : root_node_->Edges()) {
-    if (!(edge.GetMove(played_history_.IsBlackToMove()) == final_bestmove_)) {
-      continue;
-    }
-    if (edge.HasNode()) {
-      LOGFILE << "--- Opponent moves after: " << final_bestmove_.ToString(true);
-      for (const auto& line : GetVerboseStats(edge.node())) {
-        LOGFILE << line;
+  NodeStats reply_stats;
+  PositionHistory history(played_history_);
+  {
+    SharedMutex::SharedLock lock(nodes_mutex_);
+    for (auto& edge : root_node_->Edges()) {
+      if (!(edge.GetMove(played_history_.IsBlackToMove()) == final_bestmove_)) {
+        continue;
       }
+      if (!edge.HasNode()) return;
+      reply_stats.CopyFrom(edge.node());
+      history.Append(edge.GetMove());
+      break;
     }
   }
-}
-
-PositionHistory Search::GetPositionHistoryAtNode(const Node* node) const {
-  PositionHistory history(played_history_);
-  std::vector<Move> rmoves;
-  for (const Node* n = node; n != root_node_; n = n->GetParent()) {
-    rmoves.push_back(n->GetOwnEdge()->GetMove());
-  }
-  for (auto it = rmoves.rbegin(); it != rmoves.rend(); it++) {
-    history.Append(*it);
+  if (history.GetLength() == played_history_.GetLength()) return;
+  LOGFILE << "--- Opponent moves after: " << final_bestmove_.ToString(true);
+  for (const auto& line : GetVerboseStats(reply_stats, false, history)) {
+    LOGFILE << line;
   }
-  return history;
 }
 
 void Search::MaybeTriggerStop(const IterationStats& stats,
@@ -617,12 +751,11 @@ void Search::MaybeTriggerStop(const IterationStats& stats,
   if (params_.GetNpsLimit() > 0) {
     hints->UpdateEstimatedNps(params_.GetNpsLimit());
   }
-  SharedMutex::Lock nodes_lock(nodes_mutex_);
   Mutex::Lock lock(counters_mutex_);
   // Already responded bestmove, nothing to do here.
   if (bestmove_is_sent_) return;
   // Don't stop when the root node is not yet expanded.
-  if (total_playouts_ + initial_visits_ == 0) return;
+  if (stats.total_nodes == 0) return;
 
   if (!stop_.load(std::memory_order_acquire)) {
     if (stopper_->ShouldStop(stats, hints)) FireStopInternal();
@@ -631,14 +764,25 @@ void Search::MaybeTriggerStop(const IterationStats& stats,
   // If we are the first to see that stop is needed.
   if (stop_.load(std::memory_order_acquire) && ok_to_respond_bestmove_ &&
       !bestmove_is_sent_) {
-    SendUciInfo();
-    EnsureBestMoveKnown();
+    std::vector<ThinkingInfo> uci_infos;
+    {
+      // The PVs of the snapshot may lag behind, refresh them for the last
+      // info and the ponder move.
+      SharedMutex::Lock lock(nodes_mutex_);
+      PublishRootSnapshot(/* refresh_pv= */ true);
+    }
+    {
+      // Same snapshot for both, so that the bestmove starts the last pv.
+      auto snapshot = root_snapshot_.Read();
+      uci_infos = GetUciInfo(*snapshot);
+      EnsureBestMoveKnown(*snapshot);
+    }
+    uci_responder_->OutputThinkingInfo(&uci_infos);
     SendMovesStats();
     BestMoveInfo info(final_bestmove_, final_pondermove_);
     uci_responder_->OutputBestMove(&info);
     stopper_->OnSearchDone(stats);
     bestmove_is_sent_ = true;
-    current_best_edge_ = EdgeAndNode();
   }
 }
 
@@ -646,13 +790,13 @@ void Search::MaybeTriggerStop(const IterationStats& stats,
 // settings. This differs from GetBestMove, which does obey any temperature
 // settings. So, somethimes, they may return results of different moves.
 Eval Search::GetBestEval(Move* move, bool* is_terminal) const {
-  SharedMutex::SharedLock lock(nodes_mutex_);
-  Mutex::Lock counters_lock(counters_mutex_);
-  float parent_wl = -root_node_->GetWL();
-  float parent_d = root_node_->GetD();
-  float parent_m = root_node_->GetM();
-  if (!root_node_->HasChildren()) return {parent_wl, parent_d, parent_m};
-  EdgeAndNode best_edge = GetBestChildNoTemperature(root_node_, 0);
+  auto snapshot = root_snapshot_.Read();
+  const NodeStats& root = snapshot->root;
+  float parent_wl = -root.GetWL();
+  float parent_d = root.GetD();
+  float parent_m = root.GetM();
+  if (snapshot->best_edges.empty()) return {parent_wl, parent_d, parent_m};
+  const EdgeStats& best_edge = root.edges[snapshot->best_edges.front()];
   if (move) *move = best_edge.GetMove(played_history_.IsBlackToMove());
   if (is_terminal) *is_terminal = best_edge.IsTerminal();
   return {best_edge.GetWL(parent_wl), best_edge.GetD(parent_d),
@@ -660,33 +804,32 @@ Eval Search::GetBestEval(Move* move, bool* is_terminal) const {
 }
 
 std::pair<Move, Move> Search::GetBestMove() {
-  SharedMutex::Lock lock(nodes_mutex_);
   Mutex::Lock counters_lock(counters_mutex_);
-  EnsureBestMoveKnown();
+  EnsureBestMoveKnown(*root_snapshot_.Read());
   return {final_bestmove_, final_pondermove_};
 }
 
 std::int64_t Search::GetTotalPlayouts() const {
-  SharedMutex::SharedLock lock(nodes_mutex_);
-  return total_playouts_;
+  return root_snapshot_.Read()->total_playouts;
+}
+
+int Search::GetAdaptedMinibatchSize() const {
+  const int workers =
+      adapted_minibatch_workers_.load(std::memory_order_relaxed);
+  if (workers == 0) return 0;
+  return adapted_minibatch_size_sum_.load(std::memory_order_relaxed) /
+         workers;
 }
 
 void Search::ResetBestMove() {
-  SharedMutex::Lock nodes_lock(nodes_mutex_);
   Mutex::Lock lock(counters_mutex_);
   bool old_sent = bestmove_is_sent_;
   bestmove_is_sent_ = false;
-  EnsureBestMoveKnown();
+  EnsureBestMoveKnown(*root_snapshot_.Read());
   bestmove_is_sent_ = old_sent;
 }
 
-// Computes the best move, maybe with temperature (according to the settings).
-void Search::EnsureBestMoveKnown() REQUIRES(nodes_mutex_)
-    REQUIRES(counters_mutex_) {
-  if (bestmove_is_sent_) return;
-  if (root_node_->GetN() == 0) return;
-  if (!root_node_->HasChildren()) return;
-
+float Search::GetTemperature() const {
   float temperature = params_.GetTemperature();
   const int cutoff_move = params_.GetTemperatureCutoffMove();
   const int decay_delay_moves = params_.GetTempDecayDelayMoves();
@@ -708,18 +851,97 @@ void Search::EnsureBestMoveKnown() REQUIRES(nodes_mutex_)
       temperature = params_.GetTemperatureEndgame();
     }
   }
+  return temperature;
+}
 
-  auto bestmove_edge = temperature
-                           ? GetBestRootChildWithTemperature(temperature)
-                           : GetBestChildNoTemperature(root_node_, 0);
-  final_bestmove_ = bestmove_edge.GetMove(played_history_.IsBlackToMove());
+// Computes the best move, maybe with temperature (according to the settings).
+void Search::EnsureBestMoveKnown(const RootSnapshot& snapshot)
+    REQUIRES(counters_mutex_) {
+  if (bestmove_is_sent_) return;
+  if (snapshot.root.GetN() == 0) return;
+  if (!snapshot.root.HasChildren()) return;
+
+  const float temperature = GetTemperature();
+  const EdgeStats* bestmove_edge = nullptr;
+  if (temperature) {
+    bestmove_edge = GetBestRootChildWithTemperature(snapshot, temperature);
+  } else if (!snapshot.best_edges.empty()) {
+    bestmove_edge = &snapshot.root.edges[snapshot.best_edges.front()];
+  }
+  if (!bestmove_edge) {
+    final_bestmove_ = Move();
+    return;
+  }
+  final_bestmove_ = bestmove_edge->GetMove(played_history_.IsBlackToMove());
 
-  if (bestmove_edge.GetN() > 0 && bestmove_edge.node()->HasChildren()) {
-    final_pondermove_ = GetBestChildNoTemperature(bestmove_edge.node(), 1)
-                            .GetMove(!played_history_.IsBlackToMove());
+  if (bestmove_edge->GetN() > 0 && bestmove_edge->pv.size() > 1) {
+    final_pondermove_ = bestmove_edge->pv[1];
+    if (!played_history_.IsBlackToMove()) final_pondermove_.Flip();
   }
 }
 
+void Search::PublishRootSnapshot(bool refresh_pv) REQUIRES(nodes_mutex_) {
+  // Only this thread writes, so the front buffer can't change while it's read.
+  auto previous = root_snapshot_.Read();
+  RootSnapshot* snapshot = root_snapshot_.BeginWrite();
+  snapshot->root.CopyFrom(root_node_);
+  snapshot->best_edge = current_best_edge_.edge();
+  const auto now = std::chrono::steady_clock::now();
+  if (snapshot->best_edge != previous->best_edge || now >= next_pv_refresh_ ||
+      previous->root.edges.size() != snapshot->root.edges.size()) {
+    refresh_pv = true;
+  }
+  if (refresh_pv) {
+    next_pv_refresh_ = now + std::chrono::milliseconds(kRootPvRefreshMs);
+  }
+  snapshot->total_playouts = total_playouts_;
+  snapshot->total_batches = total_batches_;
+  snapshot->initial_visits = initial_visits_;
+  snapshot->max_depth = max_depth_;
+  snapshot->cum_depth = cum_depth_;
+  snapshot->best_edges.clear();
+  auto& edges = snapshot->root.edges;
+  if (!refresh_pv) {
+    for (size_t i = 0; i < edges.size(); i++) {
+      edges[i].pv = previous->root.edges[i].pv;
+    }
+  }
+  if (!edges.empty()) {
+    const auto best_children = GetBestChildrenNoTemperature(
+        root_node_, std::max(params_.GetMultiPv(), 1), 0);
+    for (const auto& child : best_children) {
+      int idx = 0;
+      for (const auto& edge : root_node_->Edges()) {
+        if (edge == child) break;
+        ++idx;
+      }
+      snapshot->best_edges.push_back(idx);
+      if (!refresh_pv && !edges[idx].pv.empty()) continue;
+      int depth = 0;
+      for (auto iter = child; iter;
+           iter = GetBestChildNoTemperature(iter.node(), depth)) {
+        edges[idx].pv.push_back(iter.GetMove());
+        if (!iter.node()) break;  // Last edge was dangling, cannot continue.
+        depth += 1;
+      }
+    }
+    // Any visited move may be played with temperature, so it needs its ponder
+    // move.
+    if (GetTemperature()) {
+      auto stats = edges.begin();
+      for (const auto& edge : root_node_->Edges()) {
+        if (stats->pv.empty() && edge.GetN() > 0) {
+          stats->pv.push_back(edge.GetMove());
+          const auto reply = GetBestChildNoTemperature(edge.node(), 1);
+          if (reply) stats->pv.push_back(reply.GetMove());
+        }
+        ++stats;
+      }
+    }
+  }
+  root_snapshot_.Publish();
+}
+
 // Returns @count children with most visits.
 std::vector<EdgeAndNode> Search::GetBestChildrenNoTemperature(Node* parent,
                                                               int count,
@@ -828,7 +1050,8 @@ EdgeAndNode Search::GetBestChildNoTemperature(Node* parent, int depth) const {
 
 // Returns a child of a root chosen according to weighted-by-temperature visit
 // count.
-EdgeAndNode Search::GetBestRootChildWithTemperature(float temperature) const {
+const EdgeStats* Search::GetBestRootChildWithTemperature(
+    const RootSnapshot& snapshot, float temperature) const {
   // Root is at even depth.
   const float draw_score = GetDrawScore(/* is_odd_depth= */ false);
 
@@ -838,9 +1061,9 @@ EdgeAndNode Search::GetBestRootChildWithTemperature(float temperature) const {
   const float offset = params_.GetTemperatureVisitOffset();
   float max_eval = -1.0f;
   const float fpu =
-      GetFpu(params_, root_node_, /* is_root= */ true, draw_score);
+      GetFpu(params_, &snapshot.root, /* is_root= */ true, draw_score);
 
-  for (auto& edge : root_node_->Edges()) {
+  for (const auto& edge : snapshot.root.edges) {
     if (!root_move_filter_.empty() &&
         std::find(root_move_filter_.begin(), root_move_filter_.end(),
                   edge.GetMove()) == root_move_filter_.end()) {
@@ -855,7 +1078,7 @@ EdgeAndNode Search::GetBestRootChildWithTemperature(float temperature) const {
   // TODO(crem) Simplify this code when samplers.h is merged.
   const float min_eval =
       max_eval - params_.GetTemperatureWinpctCutoff() / 50.0f;
-  for (auto& edge : root_node_->Edges()) {
+  for (const auto& edge : snapshot.root.edges) {
     if (!root_move_filter_.empty() &&
         std::find(root_move_filter_.begin(), root_move_filter_.end(),
                   edge.GetMove()) == root_move_filter_.end()) {
@@ -872,22 +1095,22 @@ EdgeAndNode Search::GetBestRootChildWithTemperature(float temperature) const {
   }
   assert(sum);
 
-  const float toss = Random::Get().GetFloat(cumulative_sums.back());
+  const float toss = GetRandom().GetFloat(cumulative_sums.back());
   int idx =
       std::lower_bound(cumulative_sums.begin(), cumulative_sums.end(), toss) -
       cumulative_sums.begin();
 
-  for (auto& edge : root_node_->Edges()) {
+  for (const auto& edge : snapshot.root.edges) {
     if (!root_move_filter_.empty() &&
         std::find(root_move_filter_.begin(), root_move_filter_.end(),
                   edge.GetMove()) == root_move_filter_.end()) {
       continue;
     }
     if (edge.GetQ(fpu, draw_score) < min_eval) continue;
-    if (idx-- == 0) return edge;
+    if (idx-- == 0) return &edge;
   }
   assert(false);
-  return {};
+  return nullptr;
 }
 
 void Search::StartThreads(size_t how_many) {
@@ -924,21 +1147,46 @@ bool Search::IsSearchActive() const {
   return !stop_.load(std::memory_order_acquire);
 }
 
-void Search::PopulateCommonIterationStats(IterationStats* stats) {
-  stats->time_since_movestart = GetTimeSinceStart();
+bool Search::WaitForTurn(int worker_index) {
+  // Like in ExecuteOneIteration(), at least one iteration has to run.
+  auto stopped = [this]() {
+    return stop_.load(std::memory_order_acquire) &&
+           GetTotalPlayouts() + initial_visits_ > 0;
+  };
+  Mutex::Lock lock(turn_mutex_);
+  turn_cv_.wait(lock.get_raw(), [&]() {
+    return turn_ == worker_index || stopped();
+  });
+  if (!stopped()) return true;
+  // Whoever has the turn may be gone, so wake up the others to see the stop.
+  turn_cv_.notify_all();
+  return false;
+}
 
-  SharedMutex::SharedLock nodes_lock(nodes_mutex_);
+void Search::PassTurn() {
   {
-    Mutex::Lock counters_lock(counters_mutex_);
-    stats->time_since_first_batch = GetTimeSinceFirstBatch();
-    if (!nps_start_time_ && total_playouts_ > 0) {
-      nps_start_time_ = std::chrono::steady_clock::now();
-    }
+    Mutex::Lock lock(turn_mutex_);
+    turn_ = (turn_ + 1) % thread_count_.load(std::memory_order_acquire);
   }
-  stats->total_nodes = total_playouts_ + initial_visits_;
-  stats->nodes_since_movestart = total_playouts_;
-  stats->batches_since_movestart = total_batches_;
-  stats->average_depth = cum_depth_ / (total_playouts_ ? total_playouts_ : 1);
+  turn_cv_.notify_all();
+}
+
+void Search::PopulateCommonIterationStats(IterationStats* stats) {
+  stats->time_since_movestart = GetTimeSinceStart();
+
+  // No locks may be taken while holding the snapshot.
+  Mutex::Lock counters_lock(counters_mutex_);
+  auto snapshot = root_snapshot_.Read();
+  const int64_t total_playouts = snapshot->total_playouts;
+  stats->time_since_first_batch = GetTimeSinceFirstBatch();
+  if (!nps_start_time_ && total_playouts > 0) {
+    nps_start_time_ = std::chrono::steady_clock::now();
+  }
+  stats->total_nodes = total_playouts + snapshot->initial_visits;
+  stats->nodes_since_movestart = total_playouts;
+  stats->batches_since_movestart = snapshot->total_batches;
+  stats->average_depth =
+      snapshot->cum_depth / (total_playouts ? total_playouts : 1);
   stats->edge_n.clear();
   stats->win_found = false;
   stats->may_resign = true;
@@ -946,18 +1194,19 @@ void Search::PopulateCommonIterationStats(IterationStats* stats) {
   stats->time_usage_hint_ = IterationStats::TimeUsageHint::kNormal;
   stats->mate_depth = std::numeric_limits<int>::max();
 
-  // If root node hasn't finished first visit, none of this code is safe.
-  if (root_node_->GetN() > 0) {
+  // The snapshot only has edges once the root finished its first visit.
+  const NodeStats& root = snapshot->root;
+  if (root.GetN() > 0) {
     const auto draw_score = GetDrawScore(true);
     const float fpu =
-        GetFpu(params_, root_node_, /* is_root_node */ true, draw_score);
+        GetFpu(params_, &root, /* is_root_node */ true, draw_score);
     float max_q_plus_m = -1000;
     uint64_t max_n = 0;
     bool max_n_has_max_q_plus_m = true;
     const auto m_evaluator = backend_attributes_.has_mlh
-                                 ? MEvaluator(params_, root_node_)
+                                 ? MEvaluator(params_, &root)
                                  : MEvaluator();
-    for (const auto& edge : root_node_->Edges()) {
+    for (const auto& edge : root.edges) {
       const auto n = edge.GetN();
       const auto q = edge.GetQ(fpu, draw_score);
       const auto m = m_evaluator.GetMUtility(edge, q);
@@ -1078,6 +1327,19 @@ Search::~Search() {
     SharedMutex::Lock lock(nodes_mutex_);
     CancelSharedCollisions();
   }
+  if (const int64_t queued = prefetch_queued_.load()) {
+    const int64_t hits = prefetch_hits_.load();
+    LOGFILE << "Prefetched " << queued << " positions, " << hits << " ("
+            << 100 * hits / queued << "%) were used by the search.";
+  }
+  if (const int64_t redirected = root_redirected_visits_.load()) {
+    LOGFILE << "Root move pruning: " << redirected << " of "
+            << root_picked_visits_.load()
+            << " visits picked at the root (including collisions) came "
+               "while some root moves couldn't catch up with the best one. "
+            << root_pruned_moves_.load()
+            << " root moves were pruned at the end.";
+  }
   LOGFILE << "Search destroyed.";
 }
 
@@ -1158,6 +1420,13 @@ void SearchWorker::RunTasks(int tid) {
   }
 }
 
+void SearchWorker::SetMinibatchSize(int size) {
+  target_minibatch_size_ = size;
+  max_out_of_order_ =
+      std::max(1, static_cast<int>(params_.GetMaxOutOfOrderEvalsFactor() *
+                                   target_minibatch_size_));
+}
+
 void SearchWorker::ExecuteOneIteration() {
   // 1. Initialize internal structures.
   InitializeIteration(search_->backend_->CreateComputation());
@@ -1199,6 +1468,7 @@ void SearchWorker::ExecuteOneIteration() {
   }
 
   // 2. Gather minibatch.
+  const auto gather_start = std::chrono::steady_clock::now();
   GatherMinibatch();
   task_count_.store(-1, std::memory_order_release);
   search_->backend_waiting_counter_.fetch_add(1, std::memory_order_relaxed);
@@ -1214,8 +1484,11 @@ void SearchWorker::ExecuteOneIteration() {
   }
 
   // 4. Run NN computation.
+  const int nn_batch_size = computation_->UsedBatchSize();
+  const auto nn_start = std::chrono::steady_clock::now();
   RunNNComputation();
   search_->backend_waiting_counter_.fetch_add(-1, std::memory_order_relaxed);
+  const auto nn_end = std::chrono::steady_clock::now();
 
   // 5. Retrieve NN computations (and terminal values) into nodes.
   FetchMinibatchResults();
@@ -1223,6 +1496,20 @@ void SearchWorker::ExecuteOneIteration() {
   // 6. Propagate the new nodes' information to all their parents in the tree.
   DoBackupUpdate();
 
+  if (minibatch_controller_) {
+    using Ms = std::chrono::duration<float, std::milli>;
+    int nodes = number_out_of_order_;
+    for (const auto& node_to_process : minibatch_) {
+      if (!node_to_process.IsCollision()) nodes += node_to_process.multivisit;
+    }
+    if (minibatch_controller_->AddIteration(
+            nodes, nn_batch_size, Ms(nn_start - gather_start).count(),
+            Ms(nn_end - nn_start).count(),
+            Ms(std::chrono::steady_clock::now() - nn_end).count())) {
+      SetMinibatchSize(minibatch_controller_->GetSize());
+    }
+  }
+
   // 7. Update the Search's status and progress information.
   UpdateCounters();
 
@@ -1295,6 +1582,13 @@ void SearchWorker::GatherMinibatch() {
       latest_time_manager_hints_.GetEstimatedRemainingPlayouts();
   int collisions_left = CalculateCollisionsLeft(
       std::min(static_cast<int64_t>(cur_n), remaining_n), params_);
+  // The collision budget is tuned for the configured minibatch size, so it
+  // follows the adapted one.
+  if (target_minibatch_size_ != base_minibatch_size_) {
+    collisions_left = std::max(
+        1, static_cast<int>(static_cast<int64_t>(collisions_left) *
+                            target_minibatch_size_ / base_minibatch_size_));
+  }
 
   // Number of nodes processed out of order.
   number_out_of_order_ = 0;
@@ -1314,8 +1608,9 @@ void SearchWorker::GatherMinibatch() {
     // Only do this fancy work if there are multiple threads as otherwise we
     // early exit from every batch since there is never another search thread to
     // be keeping the backend busy. Which would mean that threads=1 has a
-    // massive nps drop.
-    if (thread_count > 1 && minibatch_size > 0 &&
+    // massive nps drop. Deterministic search doesn't depend on timing.
+    if (thread_count > 1 && !params_.GetDeterministicSearch() &&
+        minibatch_size > 0 &&
         static_cast<int>(computation_->UsedBatchSize()) >
             params_.GetIdlingMinimumWork() &&
         thread_count - search_->backend_waiting_counter_.load(
@@ -1463,6 +1758,18 @@ void SearchWorker::ProcessPickedTask(int start_idx, int end_idx,
                                        },
                                        picked_node.eval->AsPtr()) ==
                                    BackendComputation::FETCHED_IMMEDIATELY;
+        if (search_->prefetch_queued_.load(std::memory_order_relaxed) > 0) {
+          uint64_t hash = history.Last().Hash();
+          auto& slot = search_->prefetched_positions_[hash %
+                                                      Search::kPrefetchSlots];
+          // Clearing the slot makes sure that a position is counted once.
+          if (hash != 0 &&
+              slot.compare_exchange_strong(hash, 0,
+                                           std::memory_order_relaxed) &&
+              picked_node.is_cache_hit) {
+            search_->prefetch_hits_.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
       }
     }
     if (params_.GetOutOfOrderEval() && picked_node.CanEvalOutOfOrder()) {
@@ -1519,6 +1826,17 @@ void SearchWorker::PickNodesToExtend(int collision_limit) {
   }
 }
 
+bool SearchWorker::IsRootMovePruned(const EdgeAndNode& edge,
+                                    int64_t best_n) const {
+  // If there's no chance to catch up to the current best node with remaining
+  // playouts, don't consider it.
+  // best_move_node_ could have changed since best_n was retrieved. To ensure
+  // we have at least one node to expand, always include current best node.
+  return edge != search_->current_best_edge_ &&
+         latest_time_manager_hints_.GetEstimatedRemainingPlayouts() <
+             best_n - edge.GetN();
+}
+
 void SearchWorker::EnsureNodeTwoFoldCorrectForDepth(Node* child_node,
                                                     int depth) {
   // Check whether first repetition was before root. If yes, remove
@@ -1584,16 +1902,18 @@ void SearchWorker::PickNodesToExtendTask(
   }
 
   // These 2 are 'filled pre-emptively'.
-  std::array<float, 256> current_pol;
-  std::array<float, 256> current_util;
+  auto& current_pol = workspace->pol;
+  auto& current_util = workspace->util;
 
   // These 3 are 'filled on demand'.
-  std::array<float, 256> current_score;
-  std::array<int, 256> current_nstarted;
+  auto& current_nstarted = workspace->nstarted;
+  auto& excluded = workspace->excluded;
   auto& cur_iters = workspace->cur_iters;
 
+  // Recomputed from the above for every pick.
+  auto& current_score = workspace->score;
+
   Node::Iterator best_edge;
-  Node::Iterator second_best_edge;
   // Fetch the current best root node visits for possible smart pruning.
   const int64_t best_node_n = search_->current_best_edge_.GetN();
 
@@ -1601,6 +1921,11 @@ void SearchWorker::PickNodesToExtendTask(
   int completed_visits = 0;
 
   bool is_root_node = node == search_->root_node_;
+  // Root moves which can't catch up with the best move, all visits picked at
+  // the root and the ones of them picked while some moves were pruned.
+  int pruned_root_moves = 0;
+  int root_visits = 0;
+  int redirected_root_visits = 0;
   const float even_draw_score = search_->GetDrawScore(false);
   const float odd_draw_score = search_->GetDrawScore(true);
   const auto& root_move_filter = search_->root_move_filter_;
@@ -1708,14 +2033,20 @@ void SearchWorker::PickNodesToExtendTask(
       const float puct_mult =
           cpuct * std::sqrt(std::max(node->GetChildrenVisits(), 1u));
       int cache_filled_idx = -1;
+      if (is_root_node && count_pruned_root_moves_) {
+        // Counted over all root moves, the scan below may stop earlier.
+        for (const auto& edge : node->Edges()) {
+          if (IsRootMovePruned(edge, best_node_n)) ++pruned_root_moves;
+        }
+      }
       while (cur_limit > 0) {
-        // Perform UCT for current node.
-        float best = std::numeric_limits<float>::lowest();
-        int best_idx = -1;
-        float best_without_u = std::numeric_limits<float>::lowest();
-        float second_best = std::numeric_limits<float>::lowest();
+        // Perform UCT for current node. First gather the children into the
+        // scratch arrays, up to one past the first child without visits
+        // started: edges are sorted in policy decreasing order, so that is
+        // sufficient to ensure second best is correct.
+        int scan_end = 0;
+        int considered = 0;
         bool can_exit = false;
-        best_edge.Reset();
         for (int idx = 0; idx < max_needed; ++idx) {
           if (idx > cache_filled_idx) {
             if (idx == 0) {
@@ -1725,55 +2056,43 @@ void SearchWorker::PickNodesToExtendTask(
               ++cur_iters[idx];
             }
             current_nstarted[idx] = cur_iters[idx].GetNStarted();
-          }
-          int nstarted = current_nstarted[idx];
-          const float util = current_util[idx];
-          if (idx > cache_filled_idx) {
-            current_score[idx] =
-                current_pol[idx] * puct_mult / (1 + nstarted) + util;
-            cache_filled_idx++;
-          }
-          if (is_root_node) {
-            // If there's no chance to catch up to the current best node with
-            // remaining playouts, don't consider it.
-            // best_move_node_ could have changed since best_node_n was
-            // retrieved. To ensure we have at least one node to expand, always
-            // include current best node.
-            if (cur_iters[idx] != search_->current_best_edge_ &&
-                latest_time_manager_hints_.GetEstimatedRemainingPlayouts() <
-                    best_node_n - cur_iters[idx].GetN()) {
-              continue;
+            excluded[idx] = false;
+            if (is_root_node) {
+              // If root move filter exists, make sure move is in the list.
+              excluded[idx] =
+                  IsRootMovePruned(cur_iters[idx], best_node_n) ||
+                  (!root_move_filter.empty() &&
+                   std::find(root_move_filter.begin(), root_move_filter.end(),
+                             cur_iters[idx].GetMove()) ==
+                       root_move_filter.end());
             }
-            // If root move filter exists, make sure move is in the list.
-            if (!root_move_filter.empty() &&
-                std::find(root_move_filter.begin(), root_move_filter.end(),
-                          cur_iters[idx].GetMove()) == root_move_filter.end()) {
-              continue;
-            }
-          }
-
-          float score = current_score[idx];
-          if (score > best) {
-            second_best = best;
-            second_best_edge = best_edge;
-            best = score;
-            best_idx = idx;
-            best_without_u = util;
-            best_edge = cur_iters[idx];
-          } else if (score > second_best) {
-            second_best = score;
-            second_best_edge = cur_iters[idx];
+            cache_filled_idx++;
           }
+          if (excluded[idx]) continue;
+          scan_end = idx + 1;
+          ++considered;
           if (can_exit) break;
-          if (nstarted == 0) {
-            // One more loop will get 2 unvisited nodes, which is sufficient to
-            // ensure second best is correct. This relies upon the fact that
-            // edges are sorted in policy decreasing order.
-            can_exit = true;
+          if (current_nstarted[idx] == 0) can_exit = true;
+        }
+        // Then score them and pick the best and second best, excluded children
+        // scoring lowest.
+        ComputePuctScores(current_pol.data(), current_util.data(),
+                          current_nstarted.data(), puct_mult, scan_end,
+                          current_score.data());
+        if (is_root_node) {
+          for (int idx = 0; idx < scan_end; ++idx) {
+            if (excluded[idx]) {
+              current_score[idx] = std::numeric_limits<float>::lowest();
+            }
           }
         }
+        float second_best;
+        const int best_idx =
+            SelectTopTwo(current_score.data(), scan_end, &second_best);
+        const float best_without_u = current_util[best_idx];
+        best_edge = cur_iters[best_idx];
         int new_visits = 0;
-        if (second_best_edge) {
+        if (considered > 1) {
           int estimated_visits_to_change_best = std::numeric_limits<int>::max();
           if (best_without_u < second_best) {
             const auto n1 = current_nstarted[best_idx] + 1;
@@ -1783,7 +2102,6 @@ void SearchWorker::PickNodesToExtendTask(
                                             n1 + 1,
                                         1e9f)));
           }
-          second_best_edge.Reset();
           max_limit = std::min(max_limit, estimated_visits_to_change_best);
           new_visits = std::min(cur_limit, estimated_visits_to_change_best);
         } else {
@@ -1797,6 +2115,8 @@ void SearchWorker::PickNodesToExtendTask(
         }
         (*visits_to_perform.back())[best_idx] += new_visits;
         cur_limit -= new_visits;
+        if (is_root_node) root_visits += new_visits;
+        if (pruned_root_moves > 0) redirected_root_visits += new_visits;
         Node* child_node = best_edge.GetOrSpawnNode(/* parent */ node);
 
         // Probably best place to check for two-fold draws consistently.
@@ -1813,9 +2133,6 @@ void SearchWorker::PickNodesToExtendTask(
             child_node->IncrementNInFlight(new_visits);
             current_nstarted[best_idx] += new_visits;
           }
-          current_score[best_idx] = current_pol[best_idx] * puct_mult /
-                                        (1 + current_nstarted[best_idx]) +
-                                    current_util[best_idx];
         }
         if ((decremented &&
              (child_node->GetN() == 0 || child_node->IsTerminal()))) {
@@ -1835,6 +2152,16 @@ void SearchWorker::PickNodesToExtendTask(
           vtp_last_filled.back() = best_idx;
         }
       }
+      if (is_root_node) {
+        search_->root_pruned_moves_.store(pruned_root_moves,
+                                          std::memory_order_relaxed);
+        search_->root_picked_visits_.fetch_add(root_visits,
+                                               std::memory_order_relaxed);
+        if (redirected_root_visits > 0) {
+          search_->root_redirected_visits_.fetch_add(
+              redirected_root_visits, std::memory_order_relaxed);
+        }
+      }
       is_root_node = false;
       // Actively do any splits now rather than waiting for potentially long
       // tree walk to get there.
@@ -2001,7 +2328,7 @@ void SearchWorker::ExtendNode(Node* node, int depth,
   }
 
   // Add legal moves as edges of this node.
-  node->CreateEdges(legal_moves);
+  node->CreateEdges(legal_moves, params_.GetChildIndex());
 }
 
 // Returns whether node was already in cache.
@@ -2034,107 +2361,106 @@ void SearchWorker::CollectCollisions() {
 // ~~~~~~~~~~~~~~~~~~~~~~~
 void SearchWorker::MaybePrefetchIntoCache() {
   // TODO(mooskagh) Remove prefetch into cache if node collisions work well.
-  // If there are requests to NN, but the batch is not full, try to prefetch
-  // nodes which are likely useful in future.
+  // If there are requests to NN, but the batch is smaller than the backend
+  // would like, try to prefetch nodes which are likely useful in future.
   if (search_->stop_.load(std::memory_order_acquire)) return;
+  const int recommended = search_->backend_attributes_.recommended_batch_size;
+  const int target = recommended > 0
+                         ? std::min(params_.GetMaxPrefetchBatch(), recommended)
+                         : params_.GetMaxPrefetchBatch();
   if (computation_->UsedBatchSize() > 0 &&
-      static_cast<int>(computation_->UsedBatchSize()) <
-          params_.GetMaxPrefetchBatch()) {
+      static_cast<int>(computation_->UsedBatchSize()) < target) {
     history_.Trim(search_->played_history_.GetLength());
     SharedMutex::SharedLock lock(search_->nodes_mutex_);
-    PrefetchIntoCache(
-        search_->root_node_,
-        params_.GetMaxPrefetchBatch() - computation_->UsedBatchSize(), false);
+    PrefetchIntoCache(target - computation_->UsedBatchSize());
   }
 }
 
-// Prefetches up to @budget nodes into cache. Returns number of nodes
-// prefetched.
-int SearchWorker::PrefetchIntoCache(Node* node, int budget, bool is_odd_depth) {
-  const float draw_score = search_->GetDrawScore(is_odd_depth);
-  if (budget <= 0) return 0;
-
-  // We are in a leaf, which is not yet being processed.
-  if (!node || node->GetNStarted() == 0) {
-    if (AddNodeToComputation(node)) {
-      // Make it return 0 to make it not use the slot, so that the function
-      // tries hard to find something to cache even among unpopular moves.
-      // In practice that slows things down a lot though, as it's not always
-      // easy to find what to cache.
-      return 1;
-    }
-    return 1;
-  }
-
-  assert(node);
-  // n = 0 and n_in_flight_ > 0, that means the node is being extended.
-  if (node->GetN() == 0) return 0;
-  // The node is terminal; don't prefetch it.
-  if (node->IsTerminal()) return 0;
+// Prefetches up to @budget nodes into cache by simulating the next playouts
+// of the search: each one descends from the root by PUCT score, counting the
+// playouts simulated before it as virtual visits, and queues the leaf it
+// reaches. The results only go to the cache, where the search finds them once
+// it gets to these leaves. Returns number of nodes prefetched.
+int SearchWorker::PrefetchIntoCache(int budget) {
+  // Bounds the number of playouts that end in terminals, cached positions or
+  // nodes being extended.
+  constexpr int kMaxPlayoutsPerPrefetch = 4;
+  prefetch_nodes_.clear();
+  const auto get_prefetch_node = [&](Node* node,
+                                     bool is_odd_depth) -> PrefetchNode& {
+    auto [iter, inserted] = prefetch_nodes_.try_emplace(node);
+    PrefetchNode& state = iter->second;
+    if (!inserted) return state;
+    const bool is_root = node == search_->root_node_;
+    const int64_t best_n = search_->current_best_edge_.GetN();
+    const auto& root_move_filter = search_->root_move_filter_;
+    state.draw_score = search_->GetDrawScore(is_odd_depth);
+    state.puct_mult = ComputeCpuct(params_, node->GetN(), is_root) *
+                      std::sqrt(std::max(node->GetChildrenVisits(), 1u));
+    state.fpu = GetFpu(params_, node, is_root, state.draw_score);
+    for (auto& edge : node->Edges()) {
+      if (edge.GetP() == 0.0f) continue;
+      // Skip the root moves the search won't pick.
+      if (is_root &&
+          (IsRootMovePruned(edge, best_n) ||
+           (!root_move_filter.empty() &&
+            std::find(root_move_filter.begin(), root_move_filter.end(),
+                      edge.GetMove()) == root_move_filter.end()))) {
+        continue;
+      }
+      // TODO: should this use logit_q if set??
+      state.scores.emplace_back(
+          edge.GetU(state.puct_mult) + edge.GetQ(state.fpu, state.draw_score),
+          state.edges.size());
+      state.edges.push_back(edge);
+    }
+    state.virtual_visits.resize(state.edges.size());
+    std::make_heap(state.scores.begin(), state.scores.end());
+    return state;
+  };
 
-  // Populate all subnodes and their scores.
-  typedef std::pair<float, EdgeAndNode> ScoredEdge;
-  std::vector<ScoredEdge> scores;
-  const float cpuct =
-      ComputeCpuct(params_, node->GetN(), node == search_->root_node_);
-  const float puct_mult =
-      cpuct * std::sqrt(std::max(node->GetChildrenVisits(), 1u));
-  const float fpu =
-      GetFpu(params_, node, node == search_->root_node_, draw_score);
-  for (auto& edge : node->Edges()) {
-    if (edge.GetP() == 0.0f) continue;
-    // Flip the sign of a score to be able to easily sort.
-    // TODO: should this use logit_q if set??
-    scores.emplace_back(-edge.GetU(puct_mult) - edge.GetQ(fpu, draw_score),
-                        edge);
-  }
-
-  size_t first_unsorted_index = 0;
-  int total_budget_spent = 0;
-  int budget_to_spend = budget;  // Initialize for the case where there's only
-                                 // one child.
-  for (size_t i = 0; i < scores.size(); ++i) {
+  int queued = 0;
+  for (int playout = 0;
+       queued < budget && playout < budget * kMaxPlayoutsPerPrefetch;
+       ++playout) {
     if (search_->stop_.load(std::memory_order_acquire)) break;
-    if (budget <= 0) break;
-
-    // Sort next chunk of a vector. 3 at a time. Most of the time it's fine.
-    if (first_unsorted_index != scores.size() &&
-        i + 2 >= first_unsorted_index) {
-      const int new_unsorted_index =
-          std::min(scores.size(), budget < 2 ? first_unsorted_index + 2
-                                             : first_unsorted_index + 3);
-      std::partial_sort(scores.begin() + first_unsorted_index,
-                        scores.begin() + new_unsorted_index, scores.end(),
-                        [](const ScoredEdge& a, const ScoredEdge& b) {
-                          return a.first < b.first;
-                        });
-      first_unsorted_index = new_unsorted_index;
-    }
-
-    auto edge = scores[i].second;
-    // Last node gets the same budget as prev-to-last node.
-    if (i != scores.size() - 1) {
-      // Sign of the score was flipped for sorting, so flip it back.
-      const float next_score = -scores[i + 1].first;
-      // TODO: As above - should this use logit_q if set?
-      const float q = edge.GetQ(-fpu, draw_score);
-      if (next_score > q) {
-        budget_to_spend =
-            std::min(budget, int(edge.GetP() * puct_mult / (next_score - q) -
-                                 edge.GetNStarted()) +
-                                 1);
-      } else {
-        budget_to_spend = budget;
+    Node* node = search_->root_node_;
+    bool is_odd_depth = false;
+    while (true) {
+      PrefetchNode& state = get_prefetch_node(node, is_odd_depth);
+      if (state.scores.empty()) break;
+      // Take the best child and put it back with one more virtual visit.
+      std::pop_heap(state.scores.begin(), state.scores.end());
+      const int idx = state.scores.back().second;
+      const auto& edge = state.edges[idx];
+      const int visits = ++state.virtual_visits[idx];
+      state.scores.back().first =
+          edge.GetP() * state.puct_mult / (1 + edge.GetNStarted() + visits) +
+          edge.GetQ(state.fpu, state.draw_score);
+      std::push_heap(state.scores.begin(), state.scores.end());
+
+      Node* child = edge.node();
+      history_.Append(edge.GetMove());
+      // We are in a leaf, which is not yet being processed.
+      if (!child || child->GetNStarted() == 0) {
+        if (visits == 1 && !AddNodeToComputation(child)) {
+          ++queued;
+          const uint64_t hash = history_.Last().Hash();
+          search_->prefetched_positions_[hash % Search::kPrefetchSlots].store(
+              hash, std::memory_order_relaxed);
+        }
+        break;
       }
+      // n = 0 and n_in_flight_ > 0, that means the node is being extended.
+      // The node is terminal; don't prefetch it.
+      if (child->GetN() == 0 || child->IsTerminal()) break;
+      node = child;
+      is_odd_depth = !is_odd_depth;
     }
-    history_.Append(edge.GetMove());
-    const int budget_spent =
-        PrefetchIntoCache(edge.node(), budget_to_spend, !is_odd_depth);
-    history_.Pop();
-    budget -= budget_spent;
-    total_budget_spent += budget_spent;
+    history_.Trim(search_->played_history_.GetLength());
   }
-  return total_budget_spent;
+  search_->prefetch_queued_.fetch_add(queued, std::memory_order_relaxed);
+  return queued;
 }
 
 // 4. Run NN computation.
@@ -2186,7 +2512,7 @@ void SearchWorker::FetchSingleNodeResult(NodeToProcess* node_to_process) {
   // Add Dirichlet noise if enabled and at root.
   if (params_.GetNoiseEpsilon() && node == search_->root_node_) {
     ApplyDirichletNoise(node, params_.GetNoiseEpsilon(),
-                        params_.GetNoiseAlpha());
+                        params_.GetNoiseAlpha(), &search_->GetRandom());
   }
   node->SortEdges();
 }
@@ -2207,6 +2533,7 @@ void SearchWorker::DoBackupUpdate() {
   if (!work_done) return;
   search_->CancelSharedCollisions();
   search_->total_batches_ += 1;
+  search_->PublishRootSnapshot();
 }
 
 void SearchWorker::DoBackupUpdateSingleNode(
@@ -33,20 +33,110 @@
 #include <optional>
 #include <shared_mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "chess/callbacks.h"
 #include "chess/uciloop.h"
 #include "neural/backend.h"
+#include "search/classic/batch_controller.h"
 #include "search/classic/node.h"
 #include "search/classic/params.h"
 #include "search/classic/stoppers/timemgr.h"
 #include "syzygy/syzygy.h"
+#include "utils/double_buffer.h"
 #include "utils/logging.h"
 #include "utils/mutex.h"
+#include "utils/random.h"
 
 namespace lczero {
 namespace classic {
 
+// Stats of an edge and its node, copied out of the tree. Getters behave like
+// the ones of EdgeAndNode.
+struct EdgeStats {
+  Move move;
+  float p = 0.0f;
+  bool has_node = false;
+  uint32_t n = 0;
+  uint32_t n_in_flight = 0;
+  float wl = 0.0f;
+  float d = 0.0f;
+  float m = 0.0f;
+  bool is_terminal = false;
+  bool is_tb_terminal = false;
+  Node::Bounds bounds{GameResult::BLACK_WON, GameResult::WHITE_WON};
+  // Principal variation starting with this move. Only filled for the moves
+  // reported in uci info, and for all visited moves with temperature (then
+  // only the move and the ponder move).
+  std::vector<Move> pv;
+
+  float GetQ(float default_q, float draw_score) const {
+    return n > 0 ? wl + draw_score * d : default_q;
+  }
+  float GetWL(float default_wl) const { return n > 0 ? wl : default_wl; }
+  float GetD(float default_d) const { return n > 0 ? d : default_d; }
+  float GetM(float default_m) const { return n > 0 ? m : default_m; }
+  uint32_t GetN() const { return n; }
+  int GetNStarted() const { return n + n_in_flight; }
+  uint32_t GetNInFlight() const { return n_in_flight; }
+  bool IsTerminal() const { return is_terminal; }
+  bool IsTbTerminal() const { return is_tb_terminal; }
+  float GetP() const { return p; }
+  Move GetMove(bool flip = false) const {
+    Move result = move;
+    if (flip) result.Flip();
+    return result;
+  }
+  float GetU(float numerator) const {
+    return numerator * GetP() / (1 + GetNStarted());
+  }
+};
+
+// Stats of a node and all its edges, copied out of the tree so that they can
+// be looked at without holding the nodes mutex.
+struct NodeStats {
+  uint32_t n = 0;
+  uint32_t n_in_flight = 0;
+  float wl = 0.0f;
+  float d = 0.0f;
+  float m = 0.0f;
+  float visited_policy = 0.0f;
+  bool is_terminal = false;
+  Node::Bounds bounds{GameResult::BLACK_WON, GameResult::WHITE_WON};
+  // Only filled once the node has a visit.
+  std::vector<EdgeStats> edges;
+
+  // Copies the stats from @node, reusing the memory of earlier copies.
+  void CopyFrom(const Node* node);
+
+  uint32_t GetN() const { return n; }
+  uint32_t GetNInFlight() const { return n_in_flight; }
+  uint32_t GetChildrenVisits() const { return n > 0 ? n - 1 : 0; }
+  float GetQ(float draw_score) const { return wl + draw_score * d; }
+  float GetWL() const { return wl; }
+  float GetD() const { return d; }
+  float GetM() const { return m; }
+  float GetVisitedPolicy() const { return visited_policy; }
+  bool IsTerminal() const { return is_terminal; }
+  bool HasChildren() const { return !edges.empty(); }
+};
+
+// What uci info, bestmove and stoppers need to know about the search. Search
+// workers publish a new one after each backup.
+struct RootSnapshot {
+  NodeStats root;
+  // Indices into root.edges of the best children without temperature, best
+  // first, as many as MultiPV asks for.
+  std::vector<int> best_edges;
+  // Identifies the current best edge, only to tell when it changes.
+  const Edge* best_edge = nullptr;
+  int64_t total_playouts = 0;
+  int64_t total_batches = 0;
+  int64_t initial_visits = 0;
+  uint16_t max_depth = 0;
+  uint64_t cum_depth = 0;
+};
+
 class Search {
  public:
   Search(const NodeTree& tree, Backend* network,
@@ -89,6 +179,12 @@ class Search {
   std::int64_t GetTotalPlayouts() const;
   // Returns the search parameters.
   const SearchParams& GetParams() const { return params_; }
+  // With adaptive minibatch, the size workers start from. Must be called before
+  // StartThreads().
+  void SetInitialMinibatchSize(int size) { initial_minibatch_size_ = size; }
+  // With adaptive minibatch, the average size the workers ended the search
+  // with, or 0 if unknown. Valid after Wait().
+  int GetAdaptedMinibatchSize() const;
 
   // If called after GetBestMove, another call to GetBestMove will have results
   // from temperature having been applied again.
@@ -96,7 +192,9 @@ class Search {
 
  private:
   // Computes the best move, maybe with temperature (according to the settings).
-  void EnsureBestMoveKnown();
+  void EnsureBestMoveKnown(const RootSnapshot& snapshot);
+  // Returns the temperature to pick the best move with at this game ply.
+  float GetTemperature() const;
 
   // Returns a child with most visits, with or without temperature.
   // NoTemperature is safe to use on non-extended nodes, while WithTemperature
@@ -104,13 +202,30 @@ class Search {
   EdgeAndNode GetBestChildNoTemperature(Node* parent, int depth) const;
   std::vector<EdgeAndNode> GetBestChildrenNoTemperature(Node* parent, int count,
                                                         int depth) const;
-  EdgeAndNode GetBestRootChildWithTemperature(float temperature) const;
+  const EdgeStats* GetBestRootChildWithTemperature(
+      const RootSnapshot& snapshot, float temperature) const;
+
+  // Returns the generator for the random choices of this search.
+  Random& GetRandom() const {
+    return seeded_random_ ? *seeded_random_ : Random::Get();
+  }
+  // With deterministic search, blocks until it's the turn of the worker
+  // @worker_index to run an iteration. Returns false if the search stopped.
+  bool WaitForTurn(int worker_index);
+  // Gives the turn to the next worker.
+  void PassTurn();
 
   int64_t GetTimeSinceStart() const;
   int64_t GetTimeSinceFirstBatch() const;
   void MaybeTriggerStop(const IterationStats& stats, StoppersHints* hints);
   void MaybeOutputInfo();
-  void SendUciInfo();  // Requires nodes_mutex_ to be held.
+  // Builds uci info from @snapshot and remembers it as the last one sent.
+  std::vector<ThinkingInfo> GetUciInfo(const RootSnapshot& snapshot);
+  // Copies the root stats into a new snapshot for the readers above. The PVs
+  // are only walked again when the best move changed, kRootPvRefreshMs passed
+  // or @refresh_pv is set, otherwise they are carried over from the previous
+  // snapshot.
+  void PublishRootSnapshot(bool refresh_pv = false);
   // Sets stop to true and notifies watchdog thread.
   void FireStopInternal();
 
@@ -125,8 +240,10 @@ class Search {
   void PopulateCommonIterationStats(IterationStats* stats);
 
   // Returns verbose information about given node, as vector of strings.
-  // Node can only be root or ponder (depth 1).
-  std::vector<std::string> GetVerboseStats(Node* node) const;
+  // Node can only be root or ponder (depth 1), @history leads to the node.
+  std::vector<std::string> GetVerboseStats(
+      const NodeStats& node, bool is_root,
+      const PositionHistory& history) const;
 
   // Returns the draw score at the root of the search. At odd depth pass true to
   // the value of @is_odd_depth to change the sign of the draw score.
@@ -136,9 +253,7 @@ class Search {
   // Ensure that all shared collisions are cancelled and clear them out.
   void CancelSharedCollisions();
 
-  PositionHistory GetPositionHistoryAtNode(const Node* node) const;
-
-  mutable Mutex counters_mutex_ ACQUIRED_AFTER(nodes_mutex_);
+  mutable Mutex counters_mutex_;
   // Tells all threads to stop.
   std::atomic<bool> stop_{false};
   // Condition variable used to watch stop_ variable.
@@ -176,16 +291,19 @@ class Search {
   std::atomic<int> tb_hits_{0};
   const MoveList root_move_filter_;
 
-  mutable SharedMutex nodes_mutex_;
+  mutable SharedMutex nodes_mutex_ ACQUIRED_AFTER(counters_mutex_);
   EdgeAndNode current_best_edge_ GUARDED_BY(nodes_mutex_);
-  Edge* last_outputted_info_edge_ GUARDED_BY(nodes_mutex_) = nullptr;
-  ThinkingInfo last_outputted_uci_info_ GUARDED_BY(nodes_mutex_);
+  const Edge* last_outputted_info_edge_ GUARDED_BY(counters_mutex_) = nullptr;
+  ThinkingInfo last_outputted_uci_info_ GUARDED_BY(counters_mutex_);
   int64_t total_playouts_ GUARDED_BY(nodes_mutex_) = 0;
   int64_t total_batches_ GUARDED_BY(nodes_mutex_) = 0;
   // Maximum search depth = length of longest path taken in PickNodetoExtend.
   uint16_t max_depth_ GUARDED_BY(nodes_mutex_) = 0;
   // Cumulative depth of all paths taken in PickNodetoExtend.
   uint64_t cum_depth_ GUARDED_BY(nodes_mutex_) = 0;
+  // When the PVs of the root snapshot are walked again at the latest.
+  std::chrono::steady_clock::time_point next_pv_refresh_
+      GUARDED_BY(nodes_mutex_);
 
   std::optional<std::chrono::steady_clock::time_point> nps_start_time_
       GUARDED_BY(counters_mutex_);
@@ -197,6 +315,38 @@ class Search {
   std::vector<std::pair<Node*, int>> shared_collisions_
       GUARDED_BY(nodes_mutex_);
 
+  // Written with nodes_mutex_ held exclusively, so readers must not wait for
+  // nodes_mutex_ while they hold a snapshot.
+  DoubleBuffer<RootSnapshot> root_snapshot_;
+
+  // Hashes of the positions queued by prefetch which the search didn't reach
+  // yet, to count how many prefetched positions are used. Indexed by the low
+  // bits of the hash, a newer position overwrites an older one in the same
+  // slot, so the hit count is a lower bound. 0 is an empty slot.
+  static constexpr size_t kPrefetchSlots = 1 << 14;
+  std::array<std::atomic<uint64_t>, kPrefetchSlots> prefetched_positions_{};
+  std::atomic<int64_t> prefetch_queued_{0};
+  std::atomic<int64_t> prefetch_hits_{0};
+
+  // Visits picked at the root while some root moves were pruned because they
+  // couldn't catch up with the best move, out of all visits picked at the
+  // root, and how many moves that was last. Only counted with verbose stats.
+  std::atomic<int64_t> root_redirected_visits_{0};
+  std::atomic<int64_t> root_picked_visits_{0};
+  std::atomic<int> root_pruned_moves_{0};
+
+  int initial_minibatch_size_ = 0;
+  std::atomic<int64_t> adapted_minibatch_size_sum_{0};
+  std::atomic<int> adapted_minibatch_workers_{0};
+
+  // With deterministic search, random choices use a seeded generator, and
+  // workers run their iterations one at a time, in the order of their indices.
+  std::unique_ptr<Random> seeded_random_;
+  std::atomic<int> next_worker_index_{0};
+  Mutex turn_mutex_;
+  std::condition_variable turn_cv_;
+  int turn_ GUARDED_BY(turn_mutex_) = 0;
+
   std::unique_ptr<UciResponder> uci_responder_;
   ContemptMode contempt_mode_;
   friend class SearchWorker;
@@ -211,7 +361,8 @@ class SearchWorker {
       : search_(search),
         history_(search_->played_history_),
         params_(params),
-        moves_left_support_(search_->backend_attributes_.has_mlh) {
+        moves_left_support_(search_->backend_attributes_.has_mlh),
+        count_pruned_root_moves_(params.GetVerboseStats()) {
     task_workers_ = params.GetTaskWorkersPerSearchWorker();
     if (task_workers_ < 0) {
       if (search_->backend_attributes_.runs_on_cpu) {
@@ -227,14 +378,24 @@ class SearchWorker {
       task_workspaces_.emplace_back();
       task_threads_.emplace_back([this, i]() { this->RunTasks(i); });
     }
-    target_minibatch_size_ = params_.GetMiniBatchSize();
-    if (target_minibatch_size_ == 0) {
-      target_minibatch_size_ =
+    base_minibatch_size_ = params_.GetMiniBatchSize();
+    if (base_minibatch_size_ == 0) {
+      base_minibatch_size_ =
           search_->backend_attributes_.recommended_batch_size;
     }
-    max_out_of_order_ =
-        std::max(1, static_cast<int>(params_.GetMaxOutOfOrderEvalsFactor() *
-                                     target_minibatch_size_));
+    SetMinibatchSize(base_minibatch_size_);
+    if (params_.GetDeterministicSearch()) {
+      worker_index_ = search_->next_worker_index_.fetch_add(1);
+    } else if (params_.GetAdaptiveMinibatch()) {
+      const int max_batch = search_->backend_attributes_.maximum_batch_size;
+      minibatch_controller_.emplace(
+          search_->initial_minibatch_size_ > 0
+              ? search_->initial_minibatch_size_
+              : base_minibatch_size_,
+          1, max_batch > 0 ? max_batch : kMaxAdaptiveMinibatchSize,
+          params_.GetTargetBatchLatency());
+      SetMinibatchSize(minibatch_controller_->GetSize());
+    }
   }
 
   ~SearchWorker() {
@@ -256,8 +417,24 @@ class SearchWorker {
       // A very early stop may arrive before this point, so the test is at the
       // end to ensure at least one iteration runs before exiting.
       do {
-        ExecuteOneIteration();
+        if (!params_.GetDeterministicSearch()) {
+          ExecuteOneIteration();
+        } else if (search_->WaitForTurn(worker_index_)) {
+          ExecuteOneIteration();
+          search_->PassTurn();
+        } else {
+          break;
+        }
       } while (search_->IsSearchActive());
+      if (minibatch_controller_) {
+        for (const auto& line : minibatch_controller_->GetReport()) {
+          LOGFILE << line;
+        }
+        search_->adapted_minibatch_size_sum_.fetch_add(
+            target_minibatch_size_, std::memory_order_relaxed);
+        search_->adapted_minibatch_workers_.fetch_add(
+            1, std::memory_order_relaxed);
+      }
     } catch (std::exception& e) {
       std::cerr << "Unhandled exception in worker thread: " << e.what()
                 << std::endl;
@@ -353,6 +530,13 @@ class SearchWorker {
   // Holds per task worker scratch data
   struct TaskWorkspace {
     std::array<Node::Iterator, 256> cur_iters;
+    // Per child scratch arrays for PUCT selection.
+    alignas(64) std::array<float, 256> pol;
+    alignas(64) std::array<float, 256> util;
+    alignas(64) std::array<float, 256> score;
+    alignas(64) std::array<int, 256> nstarted;
+    // Children at root which can't be selected (smart pruning, searchmoves).
+    std::array<bool, 256> excluded;
     std::vector<std::unique_ptr<std::array<int, 256>>> vtp_buffer;
     std::vector<std::unique_ptr<std::array<int, 256>>> visits_to_perform;
     std::vector<int> vtp_last_filled;
@@ -399,7 +583,7 @@ class SearchWorker {
 
   NodeToProcess PickNodeToExtend(int collision_limit);
   bool AddNodeToComputation(Node* node);
-  int PrefetchIntoCache(Node* node, int budget, bool is_odd_depth);
+  int PrefetchIntoCache(int budget);
   void DoBackupUpdateSingleNode(const NodeToProcess& node_to_process);
   // Returns whether a node's bounds were set based on its children.
   bool MaybeSetBounds(Node* p, float m, int* n_to_fix, float* v_delta,
@@ -420,20 +604,48 @@ class SearchWorker {
   void ResetTasks();
   // Returns how many tasks there were.
   int WaitForTasks();
+  // Sets the minibatch size and the limits derived from it.
+  void SetMinibatchSize(int size);
+  // Returns whether the root move @edge can't catch up with the @best_n visits
+  // of the best move with the playouts left, so it's not worth visiting.
+  bool IsRootMovePruned(const EdgeAndNode& edge, int64_t best_n) const;
 
   Search* const search_;
   // List of nodes to process.
   std::vector<NodeToProcess> minibatch_;
   std::unique_ptr<BackendComputation> computation_;
   int task_workers_;
+  // Bound of the adaptive minibatch size for backends without a maximum.
+  static constexpr int kMaxAdaptiveMinibatchSize = 1024;
+  // The configured minibatch size, and the one in use, which differs from it
+  // with adaptive minibatch.
+  int base_minibatch_size_;
   int target_minibatch_size_;
   int max_out_of_order_;
+  std::optional<MinibatchController> minibatch_controller_;
+  // The turn of this worker with deterministic search.
+  int worker_index_ = 0;
   // History is reset and extended by PickNodeToExtend().
   PositionHistory history_;
   int number_out_of_order_ = 0;
   const SearchParams& params_;
   std::unique_ptr<Node> precached_node_;
+  // Children of a node visited by prefetch, ordered by PUCT score with the
+  // visits prefetch added so far.
+  struct PrefetchNode {
+    std::vector<EdgeAndNode> edges;
+    std::vector<int> virtual_visits;
+    // Max-heap of (score, index in edges).
+    std::vector<std::pair<float, int>> scores;
+    float puct_mult;
+    float fpu;
+    float draw_score;
+  };
+  std::unordered_map<const Node*, PrefetchNode> prefetch_nodes_;
   const bool moves_left_support_;
+  // Counting pruned root moves takes a scan of all root moves on every pick
+  // at the root, so it's only done for verbose stats.
+  const bool count_pruned_root_moves_;
   IterationStats iteration_stats_;
   StoppersHints latest_time_manager_hints_;
 
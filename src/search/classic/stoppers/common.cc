@@ -28,6 +28,7 @@
 #include "search/classic/stoppers/common.h"
 
 #include "neural/shared_params.h"
+#include "search/classic/params.h"
 
 namespace lczero {
 namespace classic {
@@ -95,6 +96,10 @@ void PopulateCommonStopperOptions(RunType for_what, OptionsParser* options) {
   options->Add<IntOption>(kRamLimitMbId, 0, 100000000) = 0;
 }
 
+int GetRamLimitMb(const OptionsDict& options) {
+  return options.Get<int>(kRamLimitMbId);
+}
+
 // Parameters needed for selfplay and uci, but not benchmark nor infinite mode.
 void PopulateIntrinsicStoppers(ChainedSearchStopper* stopper,
                                const OptionsDict& options) {
@@ -105,9 +110,12 @@ void PopulateIntrinsicStoppers(ChainedSearchStopper* stopper,
         min_kld_gain, options.Get<int>(kKLDGainAverageIntervalId)));
   }
 
-  // Should be last in the chain.
+  // Should be last in the chain. It waits for some time to measure nps before
+  // pruning, so deterministic search goes without it.
   const auto smart_pruning_factor = options.Get<float>(kSmartPruningFactorId);
-  if (smart_pruning_factor > 0.0f) {
+  if (smart_pruning_factor > 0.0f &&
+      !options.GetOrDefault<bool>(SearchParams::kDeterministicSearchId,
+                                  false)) {
     stopper->AddStopper(std::make_unique<SmartPruningStopper>(
         smart_pruning_factor, options.Get<int>(kMinimumSmartPruningBatchesId)));
   }
@@ -37,6 +37,9 @@ namespace classic {
 enum class RunType { kUci, kSelfplay };
 void PopulateCommonStopperOptions(RunType for_what, OptionsParser* options);
 
+// Returns the RAM limit in megabytes, 0 if there is none.
+int GetRamLimitMb(const OptionsDict& options);
+
 // Populates KLDGain and SmartPruning stoppers.
 void PopulateIntrinsicStoppers(ChainedSearchStopper* stopper,
                                const OptionsDict& options);
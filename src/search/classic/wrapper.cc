@@ -27,6 +27,7 @@
 
 #include "chess/gamestate.h"
 #include "search/classic/search.h"
+#include "search/classic/stoppers/common.h"
 #include "search/classic/stoppers/factory.h"
 #include "search/register.h"
 #include "search/search.h"
@@ -48,6 +49,15 @@ const OptionId kClearTree{
      .uci_option = "ClearTree",
      .help_text = "Clear the tree before the next search.",
      .visibility = OptionId::kProOnly}};
+const OptionId kSubtreePoolSizeId{
+    {.long_flag = "subtree-pool-size",
+     .uci_option = "SubtreePoolSize",
+     .help_text =
+         "Number of search trees of recently left positions to keep, so that "
+         "analysis returning to one of them (with the same history) continues "
+         "from it. They count towards RamLimitMb, and the least recently used "
+         "ones are dropped to keep them under half of it.",
+     .visibility = OptionId::kProOnly}};
 
 class ClassicSearch : public SearchBase {
  public:
@@ -70,12 +80,16 @@ class ClassicSearch : public SearchBase {
   void AbortSearch() override {
     if (search_) search_->Abort();
   }
+  void SaveTree(const std::string& filename) override;
+  void LoadTree(const std::string& filename) override;
 
   const OptionsDict* options_;
   std::unique_ptr<TimeManager> time_manager_;
   std::unique_ptr<Search> search_;
   std::unique_ptr<NodeTree> tree_;
   std::optional<std::chrono::steady_clock::time_point> move_start_time_;
+  // Minibatch size adapted by the previous search, to start the next from.
+  int adapted_minibatch_size_ = 0;
 };
 
 MoveList StringsToMovelist(const std::vector<std::string>& moves,
@@ -99,15 +113,40 @@ MoveList StringsToMovelist(const std::vector<std::string>& moves,
 void ClassicSearch::NewGame() {
   search_.reset();
   tree_.reset();
+  adapted_minibatch_size_ = 0;
   time_manager_ = MakeTimeManager(*options_);
 }
 
 void ClassicSearch::SetPosition(const GameState& pos) {
   if (!tree_) tree_ = std::make_unique<NodeTree>();
+  tree_->SetSubtreePoolSize(options_->Get<int>(kSubtreePoolSizeId));
   const bool is_same_game = tree_->ResetToPosition(pos);
   if (!is_same_game) time_manager_ = MakeTimeManager(*options_);
 }
 
+void ClassicSearch::SaveTree(const std::string& filename) {
+  if (!tree_) throw Exception("No search tree to save.");
+  const auto start = std::chrono::steady_clock::now();
+  tree_->SaveSnapshot(filename);
+  CERR << "Saved tree of " << tree_->GetCurrentHead()->GetN()
+       << " visits to " << filename << " in "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count()
+       << "ms.";
+}
+
+void ClassicSearch::LoadTree(const std::string& filename) {
+  const auto start = std::chrono::steady_clock::now();
+  tree_->LoadSnapshot(filename);
+  CERR << "Loaded tree of " << tree_->GetCurrentHead()->GetN()
+       << " visits from " << filename << " in "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count()
+       << "ms.";
+}
+
 void ClassicSearch::StartSearch(const GoParams& params) {
   auto forwarder =
       std::make_unique<NonOwningUciRespondForwarder>(uci_responder_);
@@ -115,16 +154,30 @@ void ClassicSearch::StartSearch(const GoParams& params) {
 
   const auto cache_size =
       options_->Get<int>(SharedBackendParams::kNNCacheSizeId);
+  // With the child index, nodes with children also take a pointer per move.
+  // Counted for every node, which overestimates a bit.
   const size_t kAvgNodeSize =
-      sizeof(Node) + MemoryWatchingStopper::kAvgMovesPerPosition * sizeof(Edge);
+      sizeof(Node) +
+      MemoryWatchingStopper::kAvgMovesPerPosition *
+          (sizeof(Edge) + (options_->Get<bool>(SearchParams::kChildIndexId)
+                               ? sizeof(Node*)
+                               : 0));
   const size_t kAvgCacheItemSize =
       3 * sizeof(float) + sizeof(std::unique_ptr<float[]>) +
       sizeof(float[MemoryWatchingStopper::kAvgMovesPerPosition]);
   size_t total_memory = tree_.get()->GetCurrentHead()->GetN() * kAvgNodeSize +
                         cache_size * kAvgCacheItemSize;
+  // Pooled subtrees may take up to half of the RAM limit.
+  if (const int ram_limit_mb = GetRamLimitMb(*options_)) {
+    tree_->ShrinkSubtreePool(ram_limit_mb * 1000000LL / 2 / kAvgNodeSize);
+  }
+  total_memory += tree_->GetPooledNodes() * kAvgNodeSize;
   auto stopper = time_manager_->GetStopper(
       params, tree_.get()->HeadPosition(), total_memory, kAvgNodeSize,
       tree_.get()->GetCurrentHead()->GetN());
+  if (search_ && search_->GetAdaptedMinibatchSize() > 0) {
+    adapted_minibatch_size_ = search_->GetAdaptedMinibatchSize();
+  }
   search_ = std::make_unique<Search>(
       *tree_, backend_, std::move(forwarder),
       StringsToMovelist(params.searchmoves, tree_->HeadPosition().GetBoard()),
@@ -133,6 +186,7 @@ void ClassicSearch::StartSearch(const GoParams& params) {
 
   LOGFILE << "Timer started at "
           << FormatTime(SteadyClockToSystemClock(*move_start_time_));
+  search_->SetInitialMinibatchSize(adapted_minibatch_size_);
   search_->StartThreads(options_->Get<int>(kThreadsOptionId));
 }
 
@@ -149,6 +203,7 @@ class ClassicSearchFactory : public SearchFactory {
     PopulateTimeManagementOptions(RunType::kUci, parser);
 
     parser->Add<ButtonOption>(kClearTree);
+    parser->Add<IntOption>(kSubtreePoolSizeId, 0, 100) = 0;
   }
 };
 
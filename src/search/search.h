@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <span>
+#include <string>
 
 #include "search/artifacts.h"
 #include "utils/exception.h"
@@ -79,6 +80,18 @@ class SearchBase {
     throw Exception(
         "Training data generation is not supported for this search algorithm.");
   }
+  // Saves the search tree of the current position to a file. Only called while
+  // the search is stopped.
+  virtual void SaveTree(const std::string& /* filename */) {
+    throw Exception(
+        "Saving the tree is not supported for this search algorithm.");
+  }
+  // Restores the tree saved by SaveTree() for the current position. Only
+  // called while the search is stopped.
+  virtual void LoadTree(const std::string& /* filename */) {
+    throw Exception(
+        "Loading the tree is not supported for this search algorithm.");
+  }
 
  protected:
   UciResponder* uci_responder_ = nullptr;
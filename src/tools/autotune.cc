@@ -0,0 +1,261 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "tools/autotune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include "chess/board.h"
+#include "chess/position.h"
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/commandline.h"
+#include "utils/exception.h"
+#include "utils/optionsparser.h"
+#include "utils/string.h"
+
+namespace lczero {
+namespace {
+
+const OptionId kBackendsId{
+    "backends", "",
+    "Comma-separated list of candidate backends. Backends which are not built "
+    "in are skipped. The backend-opts are passed to every candidate."};
+const OptionId kBatchSizesId{"batch-sizes", "",
+                             "Comma-separated list of batch sizes to measure."};
+const OptionId kThreadCountsId{
+    "thread-counts", "",
+    "Comma-separated list of numbers of search threads to measure, i.e. of "
+    "batches computed concurrently."};
+const OptionId kTargetId{
+    "target", "",
+    "What to optimize for. \"nps\" maximizes positions evaluated per second, "
+    "\"latency\" does the same among the settings whose p99 batch latency "
+    "is within --max-latency-ms."};
+const OptionId kMaxLatencyId{"max-latency-ms", "",
+                             "Batch latency budget for --target=latency."};
+const OptionId kSecondsId{"seconds-per-point", "",
+                          "How long to measure every setting."};
+const OptionId kOutputId{
+    "output", "",
+    "Config file to write the backend settings to. Other settings already in "
+    "the file are kept. By default, the lc0.config next to the binary, which "
+    "is the first config file the engine looks for. The threads and minibatch "
+    "size only apply to the classic search, so they are added commented out."};
+
+// Flags that the autotuner owns in the config file. Only backend flags, which
+// every engine mode reading the config file accepts.
+const std::vector<std::string> kTunedFlags = {"backend", "backend-opts"};
+
+struct Measurement {
+  std::string backend;
+  int threads;
+  int batch;
+  double nps;
+  double mean_ms;
+  double p99_ms;
+};
+
+Measurement Measure(Backend* backend, const EvalPosition& position,
+                    int threads, int batch, double seconds) {
+  using Clock = std::chrono::steady_clock;
+  const std::vector<EvalPosition> positions(batch, position);
+  // Warm up, some backends allocate buffers for the batch size on first use.
+  backend->EvaluateBatch(positions);
+
+  std::vector<std::vector<double>> latencies(threads);
+  const auto start = Clock::now();
+  const auto deadline =
+      start + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(seconds));
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i]() {
+      do {
+        const auto batch_start = Clock::now();
+        backend->EvaluateBatch(positions);
+        latencies[i].push_back(
+            std::chrono::duration<double, std::milli>(Clock::now() -
+                                                      batch_start)
+                .count());
+      } while (Clock::now() < deadline);
+    });
+  }
+  for (auto& worker : workers) worker.join();
+  const double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> all;
+  for (const auto& thread_latencies : latencies) {
+    all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+  }
+  std::sort(all.begin(), all.end());
+  double sum = 0.0;
+  for (double x : all) sum += x;
+  return {.backend = "",
+          .threads = threads,
+          .batch = batch,
+          .nps = all.size() * batch / elapsed,
+          .mean_ms = sum / all.size(),
+          .p99_ms = all[std::min(all.size() - 1, all.size() * 99 / 100)]};
+}
+
+void WriteConfig(const std::string& filename, const Measurement& best,
+                 const std::string& backend_options,
+                 const std::string& summary) {
+  std::vector<std::string> kept;
+  {
+    std::ifstream input(filename);
+    for (std::string line; std::getline(input, line);) {
+      const std::string trimmed = Trim(line);
+      if (trimmed.rfind("# autotune", 0) == 0) continue;
+      std::string flag = trimmed;
+      if (flag.rfind("--", 0) == 0) flag = flag.substr(2);
+      flag = flag.substr(0, flag.find('='));
+      if (std::find(kTunedFlags.begin(), kTunedFlags.end(), flag) !=
+          kTunedFlags.end()) {
+        continue;
+      }
+      kept.push_back(line);
+    }
+  }
+  std::ofstream output(filename);
+  if (!output) throw Exception("Cannot write config file " + filename);
+  for (const auto& line : kept) output << line << "\n";
+  output << "# autotune: " << summary << "\n";
+  output << "--backend=" << best.backend << "\n";
+  if (!backend_options.empty()) {
+    output << "--backend-opts=" << backend_options << "\n";
+  }
+  // Other searches don't know these flags, and the engine stops on unknown
+  // flags in the config file.
+  output << "# autotune: For the classic search, also remove \"# autotune: \" "
+            "from the lines below.\n";
+  output << "# autotune: --threads=" << best.threads << "\n";
+  output << "# autotune: --minibatch-size=" << best.batch << "\n";
+}
+
+}  // namespace
+
+void RunAutotune() {
+  OptionsParser options;
+  SharedBackendParams::Populate(&options);
+  options.Add<StringOption>(kBackendsId) = "blas,eigen,onednn,onnx-cpu";
+  options.Add<StringOption>(kBatchSizesId) = "1,2,4,8,16,32,64,128,256";
+  options.Add<StringOption>(kThreadCountsId) = "1,2,3,4";
+  options.Add<ChoiceOption>(kTargetId,
+                            std::vector<std::string>{"nps", "latency"}) =
+      "nps";
+  options.Add<FloatOption>(kMaxLatencyId, 0.1f, 100000.0f) = 50.0f;
+  options.Add<FloatOption>(kSecondsId, 0.01f, 3600.0f) = 1.0f;
+  options.Add<StringOption>(kOutputId) =
+      CommandLine::BinaryDirectory() + "/lc0.config";
+  if (!options.ProcessAllFlags()) return;
+  const OptionsDict& dict = options.GetOptionsDict();
+
+  const auto batch_sizes = ParseIntList(dict.Get<std::string>(kBatchSizesId));
+  const auto thread_counts =
+      ParseIntList(dict.Get<std::string>(kThreadCountsId));
+  const double seconds = dict.Get<float>(kSecondsId);
+  const bool latency_target = dict.Get<std::string>(kTargetId) == "latency";
+  const double max_latency = dict.Get<float>(kMaxLatencyId);
+
+  PositionHistory history;
+  history.Reset(Position::FromFen(ChessBoard::kStartposFen));
+  const auto moves = history.Last().GetBoard().GenerateLegalMoves();
+  const EvalPosition position{history.GetPositions(), moves};
+
+  std::vector<Measurement> measurements;
+  for (const auto& name : StrSplit(dict.Get<std::string>(kBackendsId), ",")) {
+    if (!BackendManager::Get()->GetFactoryByName(name)) {
+      COUT << "Skipping " << name << ", not built in.";
+      continue;
+    }
+    std::unique_ptr<Backend> backend;
+    try {
+      backend = BackendManager::Get()->CreateFromName(name, dict);
+    } catch (const Exception& e) {
+      COUT << "Skipping " << name << ": " << e.what();
+      continue;
+    }
+    if (!backend->GetAttributes().runs_on_cpu) {
+      COUT << "Skipping " << name << ", doesn't run on CPU.";
+      continue;
+    }
+    const int max_batch = backend->GetAttributes().maximum_batch_size;
+    for (int threads : thread_counts) {
+      for (int batch : batch_sizes) {
+        if (threads < 1 || batch < 1 || batch > max_batch) continue;
+        auto m = Measure(backend.get(), position, threads, batch, seconds);
+        m.backend = name;
+        COUT << name << " threads " << threads << " batch " << batch << ": "
+             << static_cast<int>(m.nps) << " nps, mean " << m.mean_ms
+             << "ms, p99 " << m.p99_ms << "ms";
+        measurements.push_back(m);
+      }
+    }
+  }
+  if (measurements.empty()) throw Exception("Nothing could be measured.");
+
+  // With a latency target, settings over the budget only count if nothing is
+  // within it, and then the one with the lowest latency wins.
+  const auto better = [&](const Measurement& a, const Measurement& b) {
+    if (latency_target) {
+      const bool a_fits = a.p99_ms <= max_latency;
+      const bool b_fits = b.p99_ms <= max_latency;
+      if (a_fits != b_fits) return a_fits;
+      if (!a_fits) return a.p99_ms < b.p99_ms;
+    }
+    return a.nps > b.nps;
+  };
+  const Measurement best =
+      *std::min_element(measurements.begin(), measurements.end(), better);
+  if (latency_target && best.p99_ms > max_latency) {
+    COUT << "No setting meets the latency budget of " << max_latency << "ms.";
+  }
+
+  const std::string summary =
+      best.backend + " threads " + std::to_string(best.threads) + " batch " +
+      std::to_string(best.batch) + ", " +
+      std::to_string(static_cast<int>(best.nps)) + " nps, p99 " +
+      std::to_string(best.p99_ms) + "ms, target " +
+      dict.Get<std::string>(kTargetId);
+  const std::string filename = dict.Get<std::string>(kOutputId);
+  WriteConfig(filename, best,
+              dict.Get<std::string>(SharedBackendParams::kBackendOptionsId),
+              summary);
+  COUT << "Best: " << summary;
+  COUT << "Backend settings written to " << filename << ". For the classic "
+       << "search, also use --threads=" << best.threads
+       << " --minibatch-size=" << best.batch << ".";
+}
+
+}  // namespace lczero
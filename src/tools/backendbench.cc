@@ -31,6 +31,7 @@
 #include "neural/factory.h"
 #include "neural/shared_params.h"
 #include "search/classic/node.h"
+#include "utils/cpu_features.h"
 #include "utils/optionsparser.h"
 
 namespace lczero {
@@ -50,6 +51,9 @@ const OptionId kBatchStepId{"batch-step", "",
 const OptionId kFenId{"fen", "", "Benchmark initial position FEN."};
 
 const OptionId kClippyId{"clippy", "", "Enable helpful assistant."};
+const OptionId kShowKernelsId{
+    "show-kernels", "",
+    "Show the instruction set the CPU SIMD kernels were selected for."};
 
 void Clippy(std::string title, std::string msg3, std::string best3,
             std::string msg2, std::string best2, std::string msg,
@@ -86,6 +90,7 @@ void BackendBenchmark::Run() {
   options.Add<IntOption>(kBatchStepId, 1, 256) = 1;
   options.Add<StringOption>(kFenId) = ChessBoard::kStartposFen;
   options.Add<BoolOption>(kClippyId) = false;
+  options.Add<BoolOption>(kShowKernelsId) = false;
 
   if (!options.ProcessAllFlags()) return;
 
@@ -94,6 +99,12 @@ void BackendBenchmark::Run() {
 
     auto network = NetworkFactory::LoadNetwork(option_dict);
 
+    if (option_dict.Get<bool>(kShowKernelsId)) {
+      for (const auto& [kernels, target] : DescribeKernelTargets()) {
+        std::cout << kernels << ": " << target << std::endl;
+      }
+    }
+
     classic::NodeTree tree;
     tree.ResetToPosition(option_dict.Get<std::string>(kFenId), {});
 
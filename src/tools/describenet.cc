@@ -29,6 +29,7 @@
 
 #include "neural/loader.h"
 #include "neural/onnx/onnx.pb.h"
+#include "utils/cpu_features.h"
 #include "utils/optionsparser.h"
 
 namespace lczero {
@@ -36,9 +37,13 @@ namespace {
 
 const OptionId kWeightsFilenameId{"weights", "WeightsFile",
                                   "Path of the input Lc0 weights file.", 'w'};
+const OptionId kShowKernelsId{
+    "show-kernels", "",
+    "Also show the instruction set the CPU SIMD kernels were selected for."};
 
 bool ProcessParameters(OptionsParser* options) {
   options->Add<StringOption>(kWeightsFilenameId);
+  options->Add<BoolOption>(kShowKernelsId) = false;
   if (!options->ProcessAllFlags()) return false;
   const OptionsDict& dict = options->GetOptionsDict();
   dict.EnsureExists<std::string>(kWeightsFilenameId);
@@ -299,6 +304,14 @@ void ShowAllNetworkInfo(const pblczero::Net& weights) {
   ShowNetworkOnnxInfo(weights, true);
 }
 
+void ShowKernelTargets() {
+  COUT << "\nKernels";
+  COUT << "~~~~~~~";
+  for (const auto& [kernels, target] : DescribeKernelTargets()) {
+    COUT << Justify(kernels) << target;
+  }
+}
+
 void DescribeNetworkCmd() {
   OptionsParser options_parser;
   if (!ProcessParameters(&options_parser)) return;
@@ -307,5 +320,6 @@ void DescribeNetworkCmd() {
   auto weights_file =
       LoadWeightsFromFile(dict.Get<std::string>(kWeightsFilenameId));
   ShowAllNetworkInfo(weights_file);
+  if (dict.Get<bool>(kShowKernelsId)) ShowKernelTargets();
 }
 }  // namespace lczero
@@ -39,5 +39,6 @@ void ShowNetworkWeightsInfo(const pblczero::Net& weights);
 void ShowNetworkOnnxInfo(const pblczero::Net& weights,
                          bool show_onnx_internals);
 void ShowAllNetworkInfo(const pblczero::Net& weights);
+void ShowKernelTargets();
 
 }  // namespace lczero
\ No newline at end of file
@@ -78,6 +78,11 @@ const OptionId kOutputMlh{"mlh-head-name", "MlhHeadName",
 const OptionId kOnnxToPytorch{
     "onnx2pytorch", "",
     "Only use layer definitions supported by onnx2pytorch."};
+const OptionId kOnnxFusedOps{
+    "onnx-fused-ops", "",
+    "Use fused operators in the ONNX model (Gemm, and SkipLayerNormalization, "
+    "MultiHeadAttention and QuickGelu from the com.microsoft domain). The "
+    "result only runs with ONNX Runtime. Only float32 models are fused."};
 const OptionId kValueHead{
     "value-head", "",
     "Value head to be used in the generated model. Typical values are "
@@ -105,6 +110,7 @@ bool ProcessParameters(OptionsParser* options) {
   options->Add<StringOption>(kOutputValue) = "/output/value";
   options->Add<StringOption>(kOutputMlh) = "/output/mlh";
   options->Add<BoolOption>(kOnnxToPytorch) = false;
+  options->Add<BoolOption>(kOnnxFusedOps) = false;
   options->Add<StringOption>(kValueHead) = "winner";
   options->Add<StringOption>(kPolicyHead) = "vanilla";
   if (!options->ProcessAllFlags()) return false;
@@ -149,6 +155,7 @@ void ConvertLeelaToOnnx() {
     // onnx2pytorch only needs an alternate layernorm-implementation, so it's
     // currently only enables that. Might need to be extended in the future.
     onnx_options.alt_layernorm = dict.Get<bool>(kOnnxToPytorch);
+    onnx_options.fused_ops = dict.Get<bool>(kOnnxFusedOps);
     onnx_options.value_head = dict.Get<std::string>(kValueHead);
     onnx_options.policy_head = dict.Get<std::string>(kPolicyHead);
     weights_file = ConvertWeightsToOnnx(weights_file, onnx_options);
@@ -0,0 +1,62 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "tools/prebuildcache.h"
+
+#include <chrono>
+
+#include "neural/register.h"
+#include "neural/shared_params.h"
+#include "utils/exception.h"
+#include "utils/optionsparser.h"
+
+namespace lczero {
+
+void PrebuildWeightsCacheCmd() {
+  OptionsParser options;
+  SharedBackendParams::Populate(&options);
+  if (!options.ProcessAllFlags()) return;
+  const OptionsDict& dict = options.GetOptionsDict();
+  if (dict.Get<std::string>(SharedBackendParams::kWeightsCacheDirId)
+          .empty()) {
+    throw Exception("The --weights-cache-dir option is required.");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  // Creating the backend converts the weights and publishes them to the cache
+  // if there is no entry for them yet.
+  auto backend = BackendManager::Get()->CreateFromParams(dict);
+  COUT << "Weights cache for backend "
+       << dict.Get<std::string>(SharedBackendParams::kBackendId)
+       << " prepared in "
+       << std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count()
+       << "ms.";
+}
+
+}  // namespace lczero
@@ -0,0 +1,152 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2024 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "utils/cpu_features.h"
+
+#include <initializer_list>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace lczero {
+namespace {
+
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  features.sse4_2 = __builtin_cpu_supports("sse4.2");
+  features.avx = __builtin_cpu_supports("avx");
+  features.avx2 = __builtin_cpu_supports("avx2");
+  features.fma = __builtin_cpu_supports("fma");
+  features.avx512f = __builtin_cpu_supports("avx512f");
+  features.avx512bw = __builtin_cpu_supports("avx512bw");
+  features.avx512vl = __builtin_cpu_supports("avx512vl");
+  // No __builtin_cpu_supports("f16c") in older compilers, it comes with AVX2
+  // on every CPU that matters here.
+  features.f16c = features.avx2;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+  __cpuid(info, 1);
+  const bool osxsave = info[2] & (1 << 27);
+  // The OS has to save the AVX (and AVX-512) registers too.
+  const auto xcr0 = osxsave ? _xgetbv(0) : 0;
+  const bool os_avx = (xcr0 & 0x6) == 0x6;
+  const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+  features.sse4_2 = info[2] & (1 << 20);
+  features.fma = os_avx && (info[2] & (1 << 12));
+  features.avx = os_avx && (info[2] & (1 << 28));
+  features.f16c = os_avx && (info[2] & (1 << 29));
+  if (max_leaf >= 7) {
+    __cpuidex(info, 7, 0);
+    features.avx2 = os_avx && (info[1] & (1 << 5));
+    features.avx512f = os_avx512 && (info[1] & (1 << 16));
+    features.avx512bw = os_avx512 && (info[1] & (1 << 30));
+    features.avx512vl = os_avx512 && (info[1] & (1u << 31));
+  }
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+  features.neon = true;
+#endif
+  return features;
+}
+
+std::vector<std::pair<std::string, std::function<std::string()>>>&
+KernelTargets() {
+  static std::vector<std::pair<std::string, std::function<std::string()>>>
+      targets;
+  return targets;
+}
+
+}  // namespace
+
+const CpuFeatures& GetCpuFeatures() {
+  static const CpuFeatures features = DetectCpuFeatures();
+  return features;
+}
+
+std::string GetCpuDispatchTarget() {
+#if defined(LCZERO_HAS_CPU_DISPATCH) && defined(__clang__)
+  const auto& features = GetCpuFeatures();
+  if (features.avx512f) return "avx512f (run time)";
+  if (features.avx2) return "avx2 (run time)";
+  return "x86-64 (run time)";
+#elif defined(LCZERO_HAS_CPU_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("x86-64-v4")) return "x86-64-v4 (run time)";
+  if (__builtin_cpu_supports("x86-64-v3")) return "x86-64-v3 (run time)";
+  return "x86-64 (run time)";
+#elif defined(__AVX512F__)
+  return "avx512f (build time)";
+#elif defined(__AVX2__)
+  return "avx2 (build time)";
+#elif defined(__AVX__)
+  return "avx (build time)";
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+  return "neon (build time)";
+#else
+  return "baseline (build time)";
+#endif
+}
+
+RegisterKernelTarget::RegisterKernelTarget(
+    const std::string& kernels, std::function<std::string()> target) {
+  KernelTargets().emplace_back(kernels, std::move(target));
+}
+
+std::vector<std::pair<std::string, std::string>> DescribeKernelTargets() {
+  const auto& features = GetCpuFeatures();
+  std::string cpu;
+  for (const auto& [name, supported] :
+       std::initializer_list<std::pair<const char*, bool>>{
+           {"sse4.2", features.sse4_2},
+           {"avx", features.avx},
+           {"avx2", features.avx2},
+           {"fma", features.fma},
+           {"f16c", features.f16c},
+           {"avx512f", features.avx512f},
+           {"avx512bw", features.avx512bw},
+           {"avx512vl", features.avx512vl},
+           {"neon", features.neon}}) {
+    if (!supported) continue;
+    if (!cpu.empty()) cpu += ' ';
+    cpu += name;
+  }
+  std::vector<std::pair<std::string, std::string>> result;
+  result.emplace_back("CPU features", cpu.empty() ? "none" : cpu);
+  result.emplace_back("C++ kernels", GetCpuDispatchTarget());
+  for (const auto& [kernels, target] : KernelTargets()) {
+    result.emplace_back(kernels, target());
+  }
+  return result;
+}
+
+}  // namespace lczero
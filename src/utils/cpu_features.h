@@ -0,0 +1,91 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2024 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compiles a function for several x86-64 microarchitecture levels, the dynamic
+// loader then picks the best one the CPU supports. This is only done for
+// portable builds, a build for the native architecture (or with a compiler
+// lacking target_clones) gets a single version.
+#if defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__) && \
+    defined(__has_attribute)
+#if __has_attribute(target_clones)
+#if defined(__clang__)
+#define LCZERO_CPU_DISPATCH \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#elif __GNUC__ >= 12
+#define LCZERO_CPU_DISPATCH                                       \
+  __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", \
+                               "default")))
+#endif
+#endif
+#endif
+
+#ifdef LCZERO_CPU_DISPATCH
+#define LCZERO_HAS_CPU_DISPATCH
+#else
+#define LCZERO_CPU_DISPATCH
+#endif
+
+namespace lczero {
+
+// Instruction set extensions supported by the CPU running the binary.
+struct CpuFeatures {
+  bool sse4_2 = false;
+  bool avx = false;
+  bool avx2 = false;
+  bool fma = false;
+  bool f16c = false;
+  bool avx512f = false;
+  bool avx512bw = false;
+  bool avx512vl = false;
+  bool neon = false;
+};
+
+const CpuFeatures& GetCpuFeatures();
+
+// Instruction set the LCZERO_CPU_DISPATCH functions run with.
+std::string GetCpuDispatchTarget();
+
+// Registers a group of SIMD kernels with its own dispatch (e.g. ISPC ones), and
+// a function returning the instruction set it runs with.
+class RegisterKernelTarget {
+ public:
+  RegisterKernelTarget(const std::string& kernels,
+                       std::function<std::string()> target);
+};
+
+// The CPU features and the instruction set every group of kernels runs with,
+// as (name, description) pairs.
+std::vector<std::pair<std::string, std::string>> DescribeKernelTargets();
+
+}  // namespace lczero
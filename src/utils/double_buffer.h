@@ -0,0 +1,103 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include "utils/mutex.h"
+
+namespace lczero {
+
+// Two copies of a value: the writer fills the back one and then publishes it
+// as the front one, readers look at the front one. Readers never block, and
+// neither blocks the other on a mutex. Only one writer may run at a time.
+// The writer waits only for readers which still look at the back buffer, i.e.
+// which started reading before the previous Publish(), so readers must not
+// wait for anything the writer may hold while reading.
+template <typename T>
+class DoubleBuffer {
+ public:
+  DoubleBuffer() = default;
+  DoubleBuffer(const DoubleBuffer&) = delete;
+  DoubleBuffer& operator=(const DoubleBuffer&) = delete;
+
+  // Pins the front buffer for as long as it is alive.
+  class Reader {
+   public:
+    explicit Reader(const DoubleBuffer& buffer) {
+      while (true) {
+        index_ = buffer.front_.load();
+        readers_ = &buffer.readers_[index_];
+        readers_->fetch_add(1);
+        // Retry if the writer may have started to overwrite it meanwhile.
+        if (buffer.front_.load() == index_) break;
+        readers_->fetch_sub(1, std::memory_order_release);
+      }
+      value_ = &buffer.buffers_[index_];
+    }
+    ~Reader() { readers_->fetch_sub(1, std::memory_order_release); }
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const T& operator*() const { return *value_; }
+    const T* operator->() const { return value_; }
+
+   private:
+    int index_;
+    std::atomic<int>* readers_;
+    const T* value_;
+  };
+
+  Reader Read() const { return Reader(*this); }
+
+  // Returns the back buffer, which still holds the value published before the
+  // last one, after the readers left it.
+  T* BeginWrite() {
+    const int back = 1 - front_.load(std::memory_order_relaxed);
+    for (int spins = 1; readers_[back].load() != 0; ++spins) {
+      if (spins % 512 == 0) {
+        std::this_thread::yield();
+      } else {
+        SpinloopPause();
+      }
+    }
+    return &buffers_[back];
+  }
+
+  // Makes the buffer returned by BeginWrite() the front one.
+  void Publish() { front_.store(1 - front_.load(std::memory_order_relaxed)); }
+
+ private:
+  std::array<T, 2> buffers_{};
+  std::atomic<int> front_{0};
+  mutable std::array<std::atomic<int>, 2> readers_{};
+};
+
+}  // namespace lczero
@@ -0,0 +1,95 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "utils/double_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace lczero {
+
+TEST(DoubleBuffer, PublishedValueIsRead) {
+  DoubleBuffer<int> buffer;
+  EXPECT_EQ(*buffer.Read(), 0);
+  *buffer.BeginWrite() = 1;
+  // Not visible before it's published.
+  EXPECT_EQ(*buffer.Read(), 0);
+  buffer.Publish();
+  EXPECT_EQ(*buffer.Read(), 1);
+  // The back buffer still holds the value published before the last one.
+  int* back = buffer.BeginWrite();
+  EXPECT_EQ(*back, 0);
+  *back = 2;
+  buffer.Publish();
+  EXPECT_EQ(*buffer.Read(), 2);
+}
+
+TEST(DoubleBuffer, ReadersSeeConsistentValues) {
+  constexpr int kReaders = 3;
+  constexpr int kVersions = 20000;
+  DoubleBuffer<std::vector<int>> buffer;
+  std::atomic<bool> done = false;
+  std::vector<std::thread> readers;
+  std::atomic<int> torn_reads = 0;
+  for (int r = 0; r < kReaders; ++r) {
+    readers.emplace_back([&]() {
+      int last_version = 0;
+      while (!done.load()) {
+        auto value = buffer.Read();
+        if (value->empty()) continue;
+        // All elements are written with the same version, and versions never
+        // go backwards.
+        const int version = value->front();
+        for (int x : *value) {
+          if (x != version) ++torn_reads;
+        }
+        if (version < last_version) ++torn_reads;
+        last_version = version;
+      }
+    });
+  }
+  for (int version = 1; version <= kVersions; ++version) {
+    std::vector<int>* value = buffer.BeginWrite();
+    value->assign(64, 0);
+    for (int& x : *value) x = version;
+    buffer.Publish();
+  }
+  done.store(true);
+  for (auto& t : readers) t.join();
+  EXPECT_EQ(torn_reads.load(), 0);
+  EXPECT_EQ(buffer.Read()->front(), kVersions);
+}
+
+}  // namespace lczero
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
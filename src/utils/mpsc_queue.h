@@ -0,0 +1,102 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#pragma once
+
+#include <atomic>
+
+#include "utils/mutex.h"
+
+namespace lczero {
+
+// Base class for elements of MpscQueue.
+struct MpscNode {
+  std::atomic<MpscNode*> mpsc_next{nullptr};
+};
+
+// Intrusive unbounded lock-free multi-producer single-consumer queue (Vyukov's
+// algorithm). Push() is wait-free and can be called from any thread. Pop() must
+// only be called by one thread at a time. T must derive from MpscNode, and an
+// element may be in at most one queue at a time. The queue doesn't own the
+// elements.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(&stub_), tail_(&stub_) {}
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void Push(T* item) { PushNode(item); }
+
+  // Returns the oldest element, or nullptr if the queue is empty. May also
+  // return nullptr while a producer is in the middle of Push(); callers that
+  // know an element is there (e.g. from a separate counter) should retry.
+  T* Pop() {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->mpsc_next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->mpsc_next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+    // Last element, put stub back so that it can be detached.
+    PushNode(&stub_);
+    next = tail->mpsc_next.load(std::memory_order_acquire);
+    if (next == nullptr) return nullptr;
+    tail_ = next;
+    return static_cast<T*>(tail);
+  }
+
+  // Pops an element which is known to be in the queue, spinning through
+  // concurrent Push() of it.
+  T* PopWait() {
+    while (true) {
+      if (T* item = Pop()) return item;
+      SpinloopPause();
+    }
+  }
+
+ private:
+  void PushNode(MpscNode* node) {
+    node->mpsc_next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->mpsc_next.store(node, std::memory_order_release);
+  }
+
+  // Producers append to head_, consumer takes from tail_.
+  alignas(64) std::atomic<MpscNode*> head_;
+  alignas(64) MpscNode* tail_;
+  MpscNode stub_;
+};
+
+}  // namespace lczero
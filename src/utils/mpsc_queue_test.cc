@@ -0,0 +1,98 @@
+/*
+  This file is part of Leela Chess Zero.
+  Copyright (C) 2025 The LCZero Authors
+
+  Leela Chess is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Leela Chess is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Leela Chess.  If not, see <http://www.gnu.org/licenses/>.
+
+  Additional permission under GNU GPL version 3 section 7
+
+  If you modify this Program, or any covered work, by linking or
+  combining it with NVIDIA Corporation's libraries from the NVIDIA CUDA
+  Toolkit and the NVIDIA CUDA Deep Neural Network library (or a
+  modified version of those libraries), containing parts covered by the
+  terms of the respective license agreement, the licensors of this
+  Program grant you additional permission to convey the resulting work.
+*/
+
+#include "utils/mpsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace lczero {
+namespace {
+
+struct Item : MpscNode {
+  int producer = 0;
+  int seq = 0;
+};
+
+}  // namespace
+
+TEST(MpscQueue, Fifo) {
+  MpscQueue<Item> queue;
+  EXPECT_EQ(queue.Pop(), nullptr);
+  std::vector<Item> items(10);
+  for (int i = 0; i < 10; ++i) {
+    items[i].seq = i;
+    queue.Push(&items[i]);
+  }
+  for (int i = 0; i < 5; ++i) EXPECT_EQ(queue.Pop(), &items[i]);
+  // Elements can be pushed again after they were popped.
+  for (int i = 0; i < 5; ++i) queue.Push(&items[i]);
+  for (int i = 5; i < 10; ++i) EXPECT_EQ(queue.Pop(), &items[i]);
+  for (int i = 0; i < 5; ++i) EXPECT_EQ(queue.Pop(), &items[i]);
+  EXPECT_EQ(queue.Pop(), nullptr);
+}
+
+TEST(MpscQueue, MultipleProducers) {
+  constexpr int kProducers = 4;
+  constexpr int kItems = 20000;
+  MpscQueue<Item> queue;
+  std::vector<Item> items(kProducers * kItems);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p]() {
+      for (int i = 0; i < kItems; ++i) {
+        Item* item = &items[p * kItems + i];
+        item->producer = p;
+        item->seq = i;
+        queue.Push(item);
+      }
+    });
+  }
+  // Every producer's items have to come out in order.
+  std::vector<int> next_seq(kProducers, 0);
+  for (int received = 0; received < kProducers * kItems;) {
+    Item* item = queue.Pop();
+    if (!item) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(item->seq, next_seq[item->producer]);
+    ++next_seq[item->producer];
+    ++received;
+  }
+  for (auto& t : producers) t.join();
+  EXPECT_EQ(queue.Pop(), nullptr);
+}
+
+}  // namespace lczero
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -32,6 +32,8 @@ namespace lczero {
 
 Random::Random() : gen_(std::random_device()()) {}
 
+Random::Random(uint64_t seed) : gen_(seed) {}
+
 Random& Random::Get() {
   static Random rand;
   return rand;
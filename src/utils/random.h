@@ -28,6 +28,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <random>
 #include <string>
 #include "utils/mutex.h"
@@ -37,6 +38,9 @@ namespace lczero {
 class Random {
  public:
   static Random& Get();
+  // A generator separate from the global one, for reproducible sequences.
+  explicit Random(uint64_t seed);
+
   double GetDouble(double max_val);
   float GetFloat(float max_val);
   double GetGamma(double alpha, double beta);
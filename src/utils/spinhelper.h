@@ -27,8 +27,10 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <random>
+#include <thread>
 
 #include "utils/mutex.h"
 
@@ -79,4 +81,50 @@ class ExponentialBackoffSpinHelper : public SpinHelper {
   size_t spin_to_sleep_iters_;
 };
 
+// Waits for a condition by spinning with exponential backoff first and then
+// parking the thread on an atomic word (futex on Linux). The notifying side
+// must change the word after making the condition true and then call
+// notify_one() or notify_all() on it. The word should be owned by an object
+// that outlives the waiters, so the notifier never touches freed memory.
+//
+// The spin budget adapts: it grows when spinning succeeds and shrinks when the
+// thread had to park anyway. On single core machines it never spins.
+class AdaptiveSpinParkWaiter {
+ public:
+  template <typename Pred>
+  void Wait(const std::atomic<int>& word, Pred&& pred) {
+    if (pred()) return;
+    const int budget = spin_rounds_.load(std::memory_order_relaxed);
+    if (budget > 0) {
+      ExponentialBackoffSpinHelper spinner;
+      for (int i = 0; i < budget; ++i) {
+        spinner.Backoff();
+        if (pred()) {
+          if (budget < kMaxSpinRounds) {
+            spin_rounds_.store(budget + 1, std::memory_order_relaxed);
+          }
+          return;
+        }
+      }
+      spin_rounds_.store(budget / 2, std::memory_order_relaxed);
+    } else if (kMaxSpinRounds > 0 && ++parks_since_spin_ % 64 == 0) {
+      // Probe spinning again once in a while.
+      spin_rounds_.store(1, std::memory_order_relaxed);
+    }
+    while (true) {
+      const int value = word.load(std::memory_order_acquire);
+      if (pred()) return;
+      word.wait(value, std::memory_order_acquire);
+    }
+  }
+
+ private:
+  static inline const int kMaxSpinRounds =
+      std::thread::hardware_concurrency() > 1 ? 6 : 0;
+
+  std::atomic<int> spin_rounds_{kMaxSpinRounds};
+  // Only used as a heuristic, races are benign.
+  std::atomic<unsigned> parks_since_spin_{0};
+};
+
 }  // namespace lczero
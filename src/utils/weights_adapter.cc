@@ -27,6 +27,9 @@
 
 #include "src/utils/weights_adapter.h"
 
+#include <algorithm>
+#include <thread>
+
 namespace lczero {
 float LayerAdapter::Iterator::ExtractValue(const uint16_t* ptr,
                                            const LayerAdapter* adapter) {
@@ -40,7 +43,30 @@ LayerAdapter::LayerAdapter(const pblczero::Weights::Layer& layer)
       range_(layer.max_val() - min_) {}
 
 std::vector<float> LayerAdapter::as_vector() const {
-  return std::vector<float>(begin(), end());
+  std::vector<float> result(size_);
+  const auto convert = [this, &result](size_t from, size_t to) {
+    for (size_t i = from; i < to; ++i) {
+      result[i] = data_[i] / static_cast<float>(0xffff) * range_ + min_;
+    }
+  };
+  // Big layers are converted in chunks on several threads, this dominates
+  // network initialization otherwise.
+  constexpr size_t kChunkSize = 1 << 20;
+  const size_t threads = std::min<size_t>(
+      std::thread::hardware_concurrency(), size_ / kChunkSize);
+  if (threads < 2) {
+    convert(0, size_);
+    return result;
+  }
+  std::vector<std::thread> workers;
+  const size_t per_thread = (size_ + threads - 1) / threads;
+  for (size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(convert, i * per_thread,
+                         std::min(size_, (i + 1) * per_thread));
+  }
+  convert(0, per_thread);
+  for (auto& worker : workers) worker.join();
+  return result;
 }
 float LayerAdapter::Iterator::operator*() const {
   return ExtractValue(data_, adapter_);